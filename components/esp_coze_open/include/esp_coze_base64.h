@@ -0,0 +1,63 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 11:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 11:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\include\esp_coze_base64.h
+ * @Description: 查表式base64编解码
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief base64解码后的最大字节数
+ */
+#define ESP_COZE_BASE64_DECODED_MAX(len) ((((len) + 3) / 4) * 3)
+
+/**
+ * @brief base64编码后的字节数（含'='填充，不含结尾'\0'）
+ */
+#define ESP_COZE_BASE64_ENCODED_LEN(len) ((((len) + 2) / 3) * 4)
+
+/**
+ * @brief base64解码（标准字母表，末尾'='填充可省略）
+ *
+ * 每4个字符查4张预先移位好的表，按位或得到3个字节，非法字符在循环结束后统一检查，
+ * 循环内没有分支。支持原地解码：dst 可以等于 src，或位于 src 之前（输出总比输入短）。
+ *
+ * @param src base64数据（不要求以'\0'结尾）
+ * @param src_len base64数据长度
+ * @param dst 输出缓冲区，可以与src重叠，但不能位于src之后
+ * @param dst_len 输出缓冲区大小
+ * @param out_len 输出：解码得到的字节数
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ *         - ESP_ERR_INVALID_SIZE: 输出缓冲区不足
+ *         - ESP_FAIL: 含有非法字符或长度不合法
+ */
+esp_err_t esp_coze_base64_decode(const char *src, size_t src_len, uint8_t *dst, size_t dst_len, size_t *out_len);
+
+/**
+ * @brief base64编码（标准字母表，带'='填充）
+ *
+ * 每个输出字节只写一次，不写结尾'\0'，可以直接编码进消息缓冲区的中间位置。
+ *
+ * @param src 原始数据
+ * @param src_len 原始数据长度
+ * @param dst 输出缓冲区，至少 ESP_COZE_BASE64_ENCODED_LEN(src_len) 字节，不能与src重叠
+ * @return size_t 写入的字节数
+ */
+size_t esp_coze_base64_encode(const uint8_t *src, size_t src_len, char *dst);
+
+#ifdef __cplusplus
+}
+#endif
@@ -26,6 +26,10 @@
 #include "esp_check.h"
 #include "esp_timer.h"
 #include "cJSON.h"
+#include "esp_coze_ring_buffer.h"
+#include "esp_coze_dispatch.h"
+#include "esp_coze_sender.h"
+#include "esp_coze_chat_config.h"
 
 // 默认配置参数宏定义
 #define ESP_COZE_DEFAULT_WS_BASE_URL "wss://ws.coze.cn/v1/chat"                                        // 默认扣子WebSocket服务器地址
@@ -70,6 +74,10 @@ typedef struct {
     char *bot_id;          ///< 机器人 ID
     char *device_id;       ///< 设备ID
     char *conversation_id; ///< 会话 ID (可选，传NULL使用默认值)
+    esp_coze_ring_buffer_policy_t downlink_policy; ///< 下行缓冲区满时的背压策略（可选，默认覆盖最老的消息）
+    uint32_t downlink_block_timeout_ms; ///< 阻塞策略下每条消息最长等待时间（可选，0使用默认值）
+    esp_coze_sender_policy_t uplink_policy; ///< 上行音频队列满时的丢弃策略（可选，默认丢弃最老的音频）
+    const esp_coze_downlink_format_t *downlink_format; ///< 下行音频格式（可选，NULL使用 ESP_COZE_DOWNLINK_FORMAT_DEFAULT），见 esp_coze_negotiate_downlink_format
 } esp_coze_chat_config_t;
 
 /**
@@ -123,64 +131,59 @@ esp_err_t esp_coze_chat_disconnect();
 /**
  * @brief 通过WebSocket发送文本消息
  *
+ * 异步发送：数据拷贝进上行发送队列后立即返回，由发送任务按提交顺序发出。
+ *
  * @param data 要发送的文本数据
  * @return esp_err_t
- *         - ESP_OK: 成功
+ *         - ESP_OK: 已入队
  *         - ESP_ERR_INVALID_STATE: WebSocket未初始化
  *         - ESP_ERR_INVALID_ARG: 参数无效
- *         - ESP_FAIL: 发送失败
+ *         - ESP_FAIL: 发送队列已满
  */
 esp_err_t esp_coze_websocket_send_text(const char *data);
 
 /**
- * @brief 通过WebSocket发送二进制消息
+ * @brief 通过WebSocket发送指定长度的文本消息（异步，同 esp_coze_websocket_send_text）
  *
- * @param data 要发送的二进制数据
+ * @param data 要发送的文本数据（不要求以'\0'结尾）
  * @param len 数据长度
  * @return esp_err_t
- *         - ESP_OK: 成功
+ *         - ESP_OK: 已入队
  *         - ESP_ERR_INVALID_STATE: WebSocket未初始化
  *         - ESP_ERR_INVALID_ARG: 参数无效
- *         - ESP_FAIL: 发送失败
- */
-esp_err_t esp_coze_websocket_send_binary(const uint8_t *data, size_t len);
-
-/**
- * @brief 解码到PCM后的音频回调（弱符号）。
- *
- * 组件在收到 `conversation.audio.delta` 后，会将Base64解码得到的16位单声道PCM数据
- * 通过该回调抛给应用层。应用层可在任意模块中实现同名函数以接收PCM并播放。
- * 若应用层未实现，则使用组件内部的空实现。
- *
- * @param pcm 16-bit PCM 样本指针（单声道，采样率取决于会话配置，默认16kHz）
- * @param sample_count 样本数量
+ *         - ESP_FAIL: 发送队列已满
  */
-void esp_coze_on_pcm_audio(const int16_t *pcm, size_t sample_count);
+esp_err_t esp_coze_websocket_send_text_len(const char *data, size_t len);
 
 /**
- * @brief Opus音频数据回调（弱符号）。
+ * @brief 通过WebSocket发送二进制消息
  *
- * 组件在收到 `conversation.audio.delta` 后，如果音频格式为Opus，
- * 会将Base64解码得到的Opus数据通过该回调抛给应用层。
- * 应用层可在任意模块中实现同名函数以接收Opus数据并解码播放。
- * 若应用层未实现，则使用组件内部的空实现。
+ * 异步发送：数据拷贝进上行发送队列后立即返回，与文本消息一起按提交顺序发出。
  *
- * @param opus_data Opus编码的音频数据
- * @param opus_len Opus数据长度
+ * @param data 要发送的二进制数据
+ * @param len 数据长度
+ * @return esp_err_t
+ *         - ESP_OK: 已入队
+ *         - ESP_ERR_INVALID_STATE: WebSocket未初始化
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_FAIL: 发送队列已满
  */
-void esp_coze_on_opus_audio(const uint8_t *opus_data, size_t opus_len);
+esp_err_t esp_coze_websocket_send_binary(const uint8_t *data, size_t len);
 
 /**
- * @brief 字幕文本回调（弱符号）。
+ * @brief 获取下行消息统计信息
  *
- * 组件在收到 `conversation.audio.sentence_start` 事件后，会提取其中的字幕文本
- * 通过该回调抛给应用层。应用层可在任意模块中实现同名函数以接收字幕文本并处理。
- * 若应用层未实现，则使用组件内部的空实现。
+ * 包括入队/覆盖/丢弃的消息数、最大消息长度和消息长度直方图，可据此调整
+ * RING_BUFFER_SIZE 等内存配置。
  *
- * @param subtitle_text 字幕文本字符串
- * @param event_id 事件ID，可用于跟踪和去重
+ * @param stats 输出统计信息
+ * @param linear_buffer_size 输出回绕消息拼接缓冲区的当前大小（即回绕消息的最大长度），可为NULL
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_ERR_INVALID_STATE: 客户端未初始化
  */
-void esp_coze_on_subtitle_text(const char *subtitle_text, const char *event_id);
+esp_err_t esp_coze_chat_get_downlink_stats(esp_coze_ring_buffer_msg_stats_t *stats, size_t *linear_buffer_size);
 
 #ifdef __cplusplus
 }
@@ -225,6 +225,66 @@ typedef struct {
     esp_coze_session_config_t *data;            ///< 事件数据
 } esp_coze_chat_update_event_t;
 
+/**
+ * @brief 下行音频格式，chat.update的output_audio、Opus解码器和播放采样率都以它为准
+ */
+typedef struct {
+    esp_coze_audio_codec_t codec;   ///< 编码，只支持PCM和Opus
+    uint32_t sample_rate;           ///< 采样率（Hz），也是Opus解码输出的采样率
+    uint16_t frame_ms;              ///< 每包时长（ms）
+    uint32_t bitrate;               ///< Opus码率（bps），PCM时为原始码率
+    bool native;                    ///< 播放端能直接以该采样率播放，不需要重采样
+} esp_coze_downlink_format_t;
+
+/**
+ * @brief 不做协商时的下行音频格式：Opus 24kHz 20ms 64kbps
+ */
+#define ESP_COZE_DOWNLINK_FORMAT_DEFAULT() {    \
+    .codec = ESP_COZE_AUDIO_CODEC_OPUS,         \
+    .sample_rate = 24000,                       \
+    .frame_ms = 20,                             \
+    .bitrate = 64000,                           \
+    .native = false,                            \
+}
+
+/**
+ * @brief 播放端能力，由音频HAL提供
+ */
+typedef struct {
+    const uint32_t *native_rates;   ///< 扬声器能直接播放的采样率
+    size_t native_rate_count;       ///< native_rates个数
+    uint32_t default_rate;          ///< 扬声器默认采样率，没有可直接播放的采样率时重采样到它
+} esp_coze_playback_caps_t;
+
+/**
+ * @brief 设备对下行音频的要求
+ */
+typedef struct {
+    esp_coze_audio_codec_t codec;   ///< 编码，只支持PCM和Opus
+    uint32_t max_sample_rate;       ///< 采样率上限（Hz），0表示不限；小喇叭听不出高频时调低可以省带宽和解码
+    uint32_t bitrate;               ///< Opus码率上限（bps），0表示按采样率取上限
+    uint16_t frame_ms;              ///< Opus帧长（10/20/40/60），0使用20
+} esp_coze_downlink_profile_t;
+
+/**
+ * @brief 根据播放端能力和设备要求协商下行音频格式
+ *
+ * 采样率取服务端支持、不超过上限、扬声器又能直接播放的最高采样率；都不满足时取不超过上限、
+ * 不低于扬声器默认采样率的最低采样率，由播放端重采样。Opus码率按采样率封顶（更高的码率
+ * 对该带宽没有意义），帧长取Opus合法值。
+ *
+ * @param caps 播放端能力
+ * @param profile 设备要求
+ * @param out 协商结果
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_ERR_NOT_SUPPORTED: 不支持的编码
+ */
+esp_err_t esp_coze_negotiate_downlink_format(const esp_coze_playback_caps_t *caps,
+                                             const esp_coze_downlink_profile_t *profile,
+                                             esp_coze_downlink_format_t *out);
+
 /**
  * @brief 创建会话配置JSON对象
  *
@@ -0,0 +1,123 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 14:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 14:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\include\esp_coze_dispatch.h
+ * @Description: 扣子下行事件分发与处理函数注册
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "cJSON.h"
+#include "esp_coze_json_scan.h"
+#include "esp_coze_downlink_event_ids.h" // 构建时由 esp_coze_downlink_events.json 生成
+#include "esp_coze_downlink_types.h"     // 同上，data字段的结构体和解码函数
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_COZE_DL_MAX_HANDLERS 4 // 每个事件最多注册的处理函数数量
+
+/**
+ * @brief 一条下行事件
+ *
+ * 所有指针只在处理函数执行期间有效，需要保留的数据请自行拷贝。
+ */
+typedef struct {
+    esp_coze_dl_event_id_t id;      ///< 事件ID，不在事件列表中的事件为ESP_COZE_DL_EVENT_UNKNOWN
+    const char *type;               ///< event_type字符串（指向原始消息，不以'\0'结尾）
+    size_t type_len;                ///< event_type长度
+    const char *json;               ///< 整条原始消息（不以'\0'结尾），音频delta为NULL
+    size_t json_len;                ///< 原始消息长度，音频delta为0
+    esp_coze_json_span_t event_id;  ///< 顶层id字段（服务端事件ID）的值区间
+    esp_coze_json_span_t data;      ///< 顶层data字段的值区间，交给 esp_coze_dl_decode_* 解码为结构体；音频delta为ESP_COZE_JSON_NONE
+
+    // 仅 conversation.audio.delta 有效。base64在原始消息中原地解码，原始JSON随之失效，
+    // 因此音频delta只有 id/type/event_id 和以下字段可用，esp_coze_dl_event_get_json 返回NULL
+    const uint8_t *audio;           ///< base64解码后的音频数据（Opus或PCM，取决于会话配置）
+    size_t audio_len;               ///< 音频数据长度
+    const int16_t *pcm;             ///< PCM样本（Opus已由组件解码），无法得到PCM时为NULL
+    size_t pcm_samples;             ///< PCM样本数
+    uint32_t pcm_sample_rate;       ///< PCM采样率（Hz），同一段回复内不变
+
+    cJSON *root;                    ///< 内部使用：按需解析的cJSON树，请通过 esp_coze_dl_event_get_json 获取
+} esp_coze_dl_event_t;
+
+/**
+ * @brief 下行事件处理函数，在解析任务中调用，不要长时间阻塞
+ *
+ * @param event 事件
+ * @param user_ctx 注册时传入的用户参数
+ */
+typedef void (*esp_coze_dl_event_handler_t)(esp_coze_dl_event_t *event, void *user_ctx);
+
+/**
+ * @brief 注册下行事件处理函数
+ *
+ * 可在任意时刻、任意任务中调用，不要求聊天客户端已初始化。同一个处理函数重复注册时只更新user_ctx。
+ * 注册到 ESP_COZE_DL_EVENT_UNKNOWN 的处理函数接收所有不在事件列表中的事件。
+ *
+ * @param id 事件ID
+ * @param handler 处理函数
+ * @param user_ctx 用户参数，调用处理函数时原样传回
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ *         - ESP_ERR_NO_MEM: 该事件的处理函数已满（ESP_COZE_DL_MAX_HANDLERS）
+ */
+esp_err_t esp_coze_register_event_handler(esp_coze_dl_event_id_t id, esp_coze_dl_event_handler_t handler,
+                                          void *user_ctx);
+
+/**
+ * @brief 注销下行事件处理函数
+ *
+ * @param id 事件ID
+ * @param handler 处理函数
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ *         - ESP_ERR_NOT_FOUND: 没有注册过该处理函数
+ */
+esp_err_t esp_coze_unregister_event_handler(esp_coze_dl_event_id_t id, esp_coze_dl_event_handler_t handler);
+
+/**
+ * @brief 查询事件是否注册了处理函数
+ *
+ * @param id 事件ID
+ * @return true 至少有一个处理函数
+ */
+bool esp_coze_has_event_handler(esp_coze_dl_event_id_t id);
+
+/**
+ * @brief 获取事件的cJSON树
+ *
+ * 第一次调用时才解析，同一事件的多个处理函数共享同一棵树，分发结束后自动释放。
+ * 事件列表中定义了data结构的事件优先用 esp_coze_dl_decode_*，不需要构建整棵树。
+ *
+ * @param event 事件
+ * @return cJSON* 解析结果，失败或音频delta（原始消息已被原地解码覆盖）返回NULL
+ */
+cJSON *esp_coze_dl_event_get_json(esp_coze_dl_event_t *event);
+
+/**
+ * @brief 把事件分发给已注册的处理函数（组件内部由解析任务调用）
+ *
+ * 处理函数全部返回后释放按需解析的cJSON树。
+ *
+ * @param event 事件
+ * @return esp_err_t
+ *         - ESP_OK: 至少一个处理函数处理了该事件
+ *         - ESP_ERR_NOT_FOUND: 没有注册处理函数
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_dispatch_event(esp_coze_dl_event_t *event);
+
+#ifdef __cplusplus
+}
+#endif
@@ -135,25 +135,108 @@ esp_err_t esp_coze_send_conversation_cancel_event(const char *event_id);
 /**
  * @brief 发送input_audio_buffer.append事件
  *
+ * 按预编译模板直接写入音频通道的发送槽，不构建cJSON树，每次发送不分配内存。
+ * 消息入队后立即返回，由发送任务发出。
+ *
  * @param event_id 事件ID，如果为NULL则自动生成
- * @param audio_data base64编码的音频数据
+ * @param audio_data base64编码的音频数据（不要求以'\0'结尾）
  * @param data_len 数据长度
  * @return esp_err_t
- *         - ESP_OK: 发送成功
+ *         - ESP_OK: 已入队
  *         - ESP_ERR_INVALID_ARG: 参数错误
- *         - ESP_ERR_NO_MEM: 内存不足
- *         - 其他: WebSocket发送错误
+ *         - ESP_ERR_NO_MEM: 音频通道已满
+ *         - ESP_ERR_INVALID_SIZE: 消息超过发送槽大小
  */
 esp_err_t esp_coze_send_input_audio_buffer_append_event(const char *event_id, const uint8_t *audio_data, size_t data_len);
 
+/**
+ * @brief 发送input_audio_buffer.append事件（直接传入原始音频）
+ *
+ * 原始音频（PCM或Opus包）直接base64编码进发送槽中预先拼好的消息正文位置，
+ * 每个输出字节只写一次，调用方不需要自己分配base64缓冲区。
+ *
+ * @param event_id 事件ID，如果为NULL则自动生成
+ * @param audio 原始音频数据
+ * @param audio_len 音频数据字节数
+ * @return esp_err_t
+ *         - ESP_OK: 已入队
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ *         - ESP_ERR_NO_MEM: 音频通道已满
+ *         - ESP_ERR_INVALID_SIZE: 消息超过发送槽大小
+ */
+esp_err_t esp_coze_send_input_audio_buffer_append_raw_event(const char *event_id, const void *audio, size_t audio_len);
+
+#define ESP_COZE_AUDIO_BATCH_MIN_MS 60  // 麦克风音频批大小下限（毫秒），网络跟得上时逐步降到这里
+#define ESP_COZE_AUDIO_BATCH_MAX_MS 120 // 麦克风音频批大小上限（毫秒），即批量带来的最大额外延迟
+
+/**
+ * @brief 麦克风音频批量发送统计
+ */
+typedef struct {
+    uint32_t messages;       ///< 已提交的append消息数
+    uint32_t dropped;        ///< 音频通道满未能提交的批数
+    uint64_t audio_bytes;    ///< 已提交的原始音频字节数
+    uint64_t wire_bytes;     ///< 已提交的消息总字节数（含JSON）
+    uint32_t batch_ms;       ///< 当前批大小（毫秒）
+    uint32_t send_rate;      ///< 最近测得的音频通道发送吞吐（字节/秒）
+} esp_coze_audio_batch_stats_t;
+
+/**
+ * @brief 开始批量发送一段麦克风音频
+ *
+ * 之后写入的音频按批大小合并成较少的input_audio_buffer.append消息，边写入边base64编码进发送槽。
+ * 批大小在 ESP_COZE_AUDIO_BATCH_MIN_MS ~ ESP_COZE_AUDIO_BATCH_MAX_MS 之间，
+ * 根据发送任务实测的吞吐和排队情况自适应调整。同一时刻只支持一路音频。
+ *
+ * @param event_id 事件ID，如果为NULL则自动生成
+ * @param bytes_per_sec 音频码率（字节/秒），例如16kHz单声道16位PCM为32000
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_audio_batch_begin(const char *event_id, uint32_t bytes_per_sec);
+
+/**
+ * @brief 写入一段音频，凑够一批时提交
+ *
+ * @param audio 原始音频数据
+ * @param len 字节数
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 没有调用 esp_coze_audio_batch_begin
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ *         - ESP_ERR_NO_MEM: 音频通道已满，本批数据被丢弃
+ */
+esp_err_t esp_coze_audio_batch_write(const void *audio, size_t len);
+
+/**
+ * @brief 提交剩余音频并结束本段，之后再发送input_audio_buffer.complete
+ *
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 没有调用 esp_coze_audio_batch_begin
+ */
+esp_err_t esp_coze_audio_batch_end(void);
+
+/**
+ * @brief 获取麦克风音频批量发送统计
+ *
+ * @param stats 输出统计
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_audio_batch_get_stats(esp_coze_audio_batch_stats_t *stats);
+
 /**
  * @brief 发送input_audio_buffer.complete事件
  *
+ * 排在之前提交的所有音频片段之后发送。
+ *
  * @param event_id 事件ID，如果为NULL则自动生成
  * @return esp_err_t
- *         - ESP_OK: 发送成功
- *         - ESP_ERR_NO_MEM: 内存不足
- *         - 其他: WebSocket发送错误
+ *         - ESP_OK: 已入队
+ *         - ESP_ERR_NO_MEM: 控制通道已满
  */
 esp_err_t esp_coze_send_input_audio_buffer_complete_event(const char *event_id);
 
@@ -0,0 +1,118 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 10:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 10:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\include\esp_coze_json_scan.h
+ * @Description: 零分配JSON字段扫描器
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief JSON值类型
+ */
+typedef enum {
+    ESP_COZE_JSON_NONE = 0,   ///< 未找到该字段
+    ESP_COZE_JSON_STRING,     ///< 字符串
+    ESP_COZE_JSON_OBJECT,     ///< 对象
+    ESP_COZE_JSON_ARRAY,      ///< 数组
+    ESP_COZE_JSON_PRIMITIVE,  ///< 数字、true/false/null
+} esp_coze_json_type_t;
+
+/**
+ * @brief 指向原始JSON数据内部的值区间
+ *
+ * 字符串的区间不含两侧引号，内容保持转义前的原样；对象/数组的区间包含两侧括号，
+ * 可以再次交给 esp_coze_json_scan_object 扫描。
+ */
+typedef struct {
+    const char *ptr;           ///< 值起始位置
+    size_t len;                ///< 值长度
+    esp_coze_json_type_t type; ///< 值类型
+    bool escaped;              ///< 字符串中是否含有转义符'\\'（需要反转义才能使用）
+} esp_coze_json_span_t;
+
+/**
+ * @brief 单遍扫描一个JSON对象的顶层字段
+ *
+ * 不分配内存、不拷贝数据，只记录指定字段的值在原始数据中的位置。
+ * 嵌套的对象/数组和未关心的字段整体跳过；所有字段都找到后立即停止扫描。
+ * 同名字段出现多次时以第一次为准。
+ *
+ * @param json JSON数据（不要求以'\0'结尾）
+ * @param len JSON数据长度
+ * @param keys 需要查找的字段名
+ * @param key_count 字段名数量
+ * @param values 输出各字段的值区间，与keys一一对应，未找到的字段type为ESP_COZE_JSON_NONE
+ * @return esp_err_t
+ *         - ESP_OK: 扫描成功（字段可能部分未找到）
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ *         - ESP_FAIL: 数据不是合法的JSON对象
+ */
+esp_err_t esp_coze_json_scan_object(const char *json, size_t len, const char *const *keys, size_t key_count,
+                                    esp_coze_json_span_t *values);
+
+/**
+ * @brief 判断字符串值是否等于给定字符串
+ *
+ * @param span 值区间
+ * @param str 比较的字符串
+ * @return true 类型为字符串、没有转义且内容相同
+ */
+bool esp_coze_json_span_equals(const esp_coze_json_span_t *span, const char *str);
+
+/**
+ * @brief 把字符串值反转义后拷贝到缓冲区
+ *
+ * 支持全部JSON转义（含\uXXXX和代理对，转换为UTF-8）。缓冲区不足时截断，
+ * 截断位置不会落在UTF-8多字节字符中间，结果总是以'\0'结尾。
+ *
+ * @param span 值区间
+ * @param buf 输出缓冲区
+ * @param size 缓冲区大小（含结尾'\0'）
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误或值不是字符串
+ *         - ESP_ERR_INVALID_SIZE: 缓冲区不足，结果被截断
+ *         - ESP_FAIL: 含有非法转义
+ */
+esp_err_t esp_coze_json_span_to_str(const esp_coze_json_span_t *span, char *buf, size_t size);
+
+/**
+ * @brief 把数字值转换为整数
+ *
+ * 带小数部分的数字只取整数部分。
+ *
+ * @param span 值区间
+ * @param out 输出整数
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误或值不是数字
+ *         - ESP_ERR_INVALID_SIZE: 超出int64_t范围
+ */
+esp_err_t esp_coze_json_span_to_int(const esp_coze_json_span_t *span, int64_t *out);
+
+/**
+ * @brief 把true/false转换为布尔值
+ *
+ * @param span 值区间
+ * @param out 输出布尔值
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误或值不是true/false
+ */
+esp_err_t esp_coze_json_span_to_bool(const esp_coze_json_span_t *span, bool *out);
+
+#ifdef __cplusplus
+}
+#endif
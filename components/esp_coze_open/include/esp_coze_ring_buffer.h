@@ -19,44 +19,166 @@
 extern "C" {
 #endif
 
-#define RING_BUFFER_SIZE 2*1024*1024  // 128KB环形缓冲区
+#define RING_BUFFER_SIZE 2*1024*1024  // 2MB环形缓冲区（必须为2的幂）
+
+#define ESP_COZE_RB_MSG_SIZE_BUCKETS 6   // 消息长度直方图桶数
+#define ESP_COZE_RB_MSG_SIZE_BUCKET0 256 // 第0个桶的上限，之后每个桶上限乘4（256/1K/4K/16K/64K/更大）
+
+#define ESP_COZE_RB_DEFAULT_BLOCK_TIMEOUT_MS 100 // 阻塞策略默认等待时间
+
+/**
+ * @brief 缓冲区满时的背压策略
+ *
+ * 消息模式下三种策略都以整条消息为单位，不会产生半截JSON；
+ * 字节流模式下丢弃/阻塞针对整次 write 调用。
+ */
+typedef enum {
+    ESP_COZE_RB_POLICY_OVERWRITE_OLDEST = 0, ///< 覆盖最老的未读消息（默认），计入 overwritten
+    ESP_COZE_RB_POLICY_DROP_NEWEST,          ///< 丢弃新到的消息，保留已排队的消息，计入 dropped
+    ESP_COZE_RB_POLICY_BLOCK,                ///< 阻塞生产者等待消费者腾出空间，超时后丢弃新消息，计入 blocked/block_timeouts
+} esp_coze_ring_buffer_policy_t;
 
 /**
  * @brief 环形缓冲区结构体
+ *
+ * 单生产者/单消费者（SPSC）无锁实现：
+ * - write_pos 只由生产者（WebSocket任务）推进，read_pos 正常由消费者（解析任务）推进；
+ * - write_pos/read_pos 为自由递增的31位计数器，下标通过 `pos & mask` 得到，
+ *   因此已用字节数恒为 `(write_pos - read_pos) & 0x7FFFFFFF`，不需要牺牲一个字节区分空/满；
+ * - read_pos 的最高位是占用标记：消费者 peek 一条消息后置位，期间生产者不会覆盖这条消息，
+ *   commit 时清除；
+ * - 空间不足时生产者用CAS把 read_pos 向前推，实现“覆盖最老数据”，
+ *   消费者拷贝完成后同样用CAS提交 read_pos，若失败说明拷贝期间数据被覆盖，重新读取。
+ *
+ * 同一个缓冲区只能按一种方式使用：
+ * - 字节流模式：esp_coze_ring_buffer_write/read/read_json_object；
+ * - 消息模式：生产者用 msg_begin/msg_append/msg_end 按WebSocket帧边界写入完整消息，
+ *   每条消息在缓冲区中存为“4字节长度头 + 消息体”的记录，消费者用 read_message 整条拷贝取出，
+ *   或用 peek_message/commit_message 在缓冲区内原地读取。
+ *   消息模式下覆盖总是以整条消息为单位，不会把JSON截成两半。
+ *
+ * 空间不足时的处理方式由 policy 决定，见 esp_coze_ring_buffer_policy_t。
  */
 typedef struct {
     uint8_t *buffer;           ///< 缓冲区数据
-    size_t size;               ///< 缓冲区总大小
-    volatile size_t write_pos; ///< 写入位置
-    volatile size_t read_pos;  ///< 读取位置
-    SemaphoreHandle_t mutex;   ///< 互斥锁
+    size_t size;               ///< 缓冲区总大小（2的幂）
+    size_t mask;               ///< 下标掩码（size - 1）
+    volatile uint32_t write_pos; ///< 写入计数（自由递增，仅生产者修改）
+    volatile uint32_t read_pos;  ///< 读取计数（自由递增，消费者提交/生产者覆盖时CAS修改）
     SemaphoreHandle_t data_sem; ///< 数据信号量
-    uint32_t total_overwrites;      ///< 总覆盖次数
-    uint32_t total_overwritten_bytes; ///< 总覆盖字节数
+    SemaphoreHandle_t space_sem; ///< 空间信号量（阻塞策略下消费者释放空间后通知生产者）
+    volatile bool space_waiting; ///< 生产者是否正在等待空间
+    esp_coze_ring_buffer_policy_t policy; ///< 缓冲区满时的背压策略（仅生产者读取）
+    uint32_t block_timeout_ms; ///< 阻塞策略下每条消息最长等待时间
+    volatile uint32_t total_overwrites;      ///< 总覆盖次数
+    volatile uint32_t total_overwritten_bytes; ///< 总覆盖字节数
+
+    // JSON分帧扫描状态（仅消费者访问），跨调用保留，保证每个字节只扫描一次
+    uint32_t scan_start;       ///< 当前扫描对应的对象起始读取位置
+    uint32_t scan_pos;         ///< 下一个待扫描字节的位置
+    int scan_depth;            ///< 当前花括号深度
+    bool scan_found_start;     ///< 是否已遇到对象起始'{'
+    bool scan_in_string;       ///< 是否处于字符串内部
+    bool scan_escape;          ///< 上一个字符是否为转义符'\\'
+
+    // 消息模式生产者状态（仅生产者访问），未完成的消息位于 write_pos 之后，结束时才发布
+    bool msg_active;           ///< 是否有正在写入的消息
+    esp_err_t msg_drop_reason; ///< 当前消息被丢弃的原因，ESP_OK表示正常写入
+    size_t msg_len;            ///< 当前消息已写入的消息体长度
+    bool msg_tagged;           ///< 当前消息是否带标记
+
+    // 消息模式统计（生产者累加，任意任务读取）
+    volatile uint32_t msg_committed;   ///< 成功入队的消息数
+    volatile uint32_t msg_overwritten; ///< 为腾出空间被整条覆盖的旧消息数
+    volatile uint32_t msg_truncated;   ///< 未收完就被丢弃的不完整消息数（新消息开始或连接断开）
+    volatile uint32_t msg_oversize;    ///< 超过缓冲区容量而被丢弃的消息数
+    volatile uint32_t msg_dropped;     ///< 空间不足时被丢弃的新消息数（字节流模式下为被拒绝的写入次数）
+    volatile uint32_t msg_tagged_lost; ///< 以上四种丢失中带标记的消息数
+    volatile uint32_t blocked;         ///< 阻塞策略下生产者等待空间的次数
+    volatile uint32_t block_timeouts;  ///< 阻塞策略下等待超时的次数（新消息随之被丢弃）
+    volatile uint32_t blocked_ms;      ///< 阻塞策略下生产者累计等待时间（毫秒）
+    volatile uint32_t msg_max_len;     ///< 入队消息的最大长度
+    volatile uint32_t msg_size_hist[ESP_COZE_RB_MSG_SIZE_BUCKETS]; ///< 入队消息长度直方图
 } esp_coze_ring_buffer_t;
 
+/**
+ * @brief 消息模式统计信息
+ */
+typedef struct {
+    uint32_t committed;        ///< 成功入队的消息数
+    uint32_t overwritten;      ///< 为腾出空间被整条覆盖的旧消息数（已完整接收，但消费者来不及处理）
+    uint32_t truncated;        ///< 未收完就被丢弃的不完整消息数（分片未到齐，从未对消费者可见）
+    uint32_t oversize;         ///< 超过缓冲区容量而被丢弃的消息数
+    uint32_t dropped;          ///< 空间不足时被丢弃的新消息数（丢弃策略、阻塞超时，或最老消息正被原地解析而无法覆盖）
+    uint32_t tagged_lost;      ///< overwritten/truncated/oversize/dropped 中用 msg_tag 标记过的消息数
+    uint32_t blocked;          ///< 阻塞策略下生产者等待空间的次数
+    uint32_t block_timeouts;   ///< 阻塞策略下等待超时的次数
+    uint32_t blocked_ms;       ///< 阻塞策略下生产者累计等待时间（毫秒）
+    uint32_t max_len;          ///< 入队消息的最大长度
+    uint32_t size_hist[ESP_COZE_RB_MSG_SIZE_BUCKETS]; ///< 入队消息长度直方图，桶i统计长度小于 256<<(2*i) 的消息，最后一个桶统计更大的消息
+} esp_coze_ring_buffer_msg_stats_t;
+
+/**
+ * @brief 消息原地视图
+ *
+ * 指向缓冲区内部的消息数据，消息跨越缓冲区末尾时分为两段。
+ * 视图在 commit_message 之前一直有效，期间生产者不会覆盖该消息，
+ * 消费者可以原地改写消息内容（例如原地base64解码）。
+ */
+typedef struct {
+    const uint8_t *seg[2];     ///< 消息数据分段，未回绕时 seg[1] 为NULL
+    size_t seg_len[2];         ///< 各分段长度，未回绕时 seg_len[1] 为0
+    size_t len;                ///< 消息总长度
+    uint32_t next_pos;         ///< 内部使用：提交后的读取位置
+} esp_coze_ring_buffer_msg_view_t;
+
 /**
  * @brief 初始化环形缓冲区
  *
  * @param rb 环形缓冲区指针
- * @param size 缓冲区大小
+ * @param size 缓冲区大小，必须为2的幂
  * @return esp_err_t
  */
 esp_err_t esp_coze_ring_buffer_init(esp_coze_ring_buffer_t *rb, size_t size);
 
+/**
+ * @brief 设置缓冲区满时的背压策略
+ *
+ * 策略只由生产者读取，应在生产者开始写入前设置。
+ *
+ * @param rb 环形缓冲区指针
+ * @param policy 背压策略
+ * @param block_timeout_ms 阻塞策略下每条消息最长等待时间，0表示使用默认值
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_ring_buffer_set_policy(esp_coze_ring_buffer_t *rb, esp_coze_ring_buffer_policy_t policy,
+                                          uint32_t block_timeout_ms);
+
 /**
  * @brief 向环形缓冲区写入数据
  *
+ * 只允许单个生产者调用。空间不足时按背压策略处理：默认覆盖最老的未读数据，永远写入成功；
+ * 丢弃/阻塞策略下整次写入被拒绝。
+ *
  * @param rb 环形缓冲区指针
  * @param data 数据指针
  * @param len 数据长度
  * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NO_MEM: 丢弃策略下空间不足，本次写入被丢弃
+ *         - ESP_ERR_TIMEOUT: 阻塞策略下等待空间超时，本次写入被丢弃
+ *         - ESP_ERR_INVALID_SIZE: 丢弃/阻塞策略下数据超过缓冲区容量
+ *         - ESP_ERR_INVALID_ARG: 参数错误
  */
 esp_err_t esp_coze_ring_buffer_write(esp_coze_ring_buffer_t *rb, const uint8_t *data, size_t len);
 
 /**
  * @brief 从环形缓冲区读取字节数据
  *
+ * 只允许单个消费者调用。
+ *
  * @param rb 环形缓冲区指针
  * @param out 输出缓冲区
  * @param max_len 希望读取的最大字节数
@@ -72,14 +194,152 @@ esp_err_t esp_coze_ring_buffer_read(esp_coze_ring_buffer_t *rb, uint8_t *out, si
 /**
  * @brief 从环形缓冲区读取一个完整的JSON对象
  *
+ * 只允许单个消费者调用。扫描状态保存在rb中，对象分多次到达时从上次停下的位置继续扫描，
+ * 不会重复扫描已检查过的字节；读取位置被覆盖或被其他读取接口移动时自动从新位置重新同步。
+ *
  * @param rb 环形缓冲区指针
  * @param data 输出数据缓冲区
  * @param max_len 最大读取长度
  * @param actual_len 实际读取长度
  * @return esp_err_t
+ *         - ESP_OK: 读取成功
+ *         - ESP_ERR_NOT_FOUND: 当前没有完整对象
+ *         - ESP_ERR_INVALID_SIZE: 对象超过输出缓冲区，已跳过该对象，actual_len为对象长度
+ *         - ESP_ERR_INVALID_ARG: 参数错误
  */
 esp_err_t esp_coze_ring_buffer_read_json_object(esp_coze_ring_buffer_t *rb, uint8_t *data, size_t max_len, size_t *actual_len);
 
+/**
+ * @brief 开始写入一条新消息（消息模式，仅生产者调用）
+ *
+ * 如果上一条消息还没有调用 msg_end，上一条消息会被丢弃并计入 truncated。
+ *
+ * @param rb 环形缓冲区指针
+ * @param size_hint 预计的消息长度（例如WebSocket帧的payload_len），用于一次性预留空间，未知时传0
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_ring_buffer_msg_begin(esp_coze_ring_buffer_t *rb, size_t size_hint);
+
+/**
+ * @brief 向当前消息追加数据（消息模式，仅生产者调用）
+ *
+ * 空间不足时按背压策略处理（覆盖最老的整条消息、丢弃当前消息或阻塞等待）；
+ * 消息本身超过缓冲区容量时整条丢弃并计入 oversize。当前消息被丢弃后，后续追加直接返回同样的错误。
+ *
+ * @param rb 环形缓冲区指针
+ * @param data 数据指针
+ * @param len 数据长度
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ *         - ESP_ERR_INVALID_STATE: 没有正在写入的消息
+ *         - ESP_ERR_INVALID_SIZE: 消息超过缓冲区容量，已丢弃
+ *         - ESP_ERR_NO_MEM: 空间不足，按策略丢弃了当前消息
+ *         - ESP_ERR_TIMEOUT: 阻塞策略下等待空间超时，已丢弃当前消息
+ */
+esp_err_t esp_coze_ring_buffer_msg_append(esp_coze_ring_buffer_t *rb, const uint8_t *data, size_t len);
+
+/**
+ * @brief 给当前消息打标记（消息模式，仅生产者调用）
+ *
+ * 标记随消息保存在记录头中，消息丢失（被覆盖、截断、超长或丢弃）时额外计入 tagged_lost，
+ * 用于区分某一类消息的丢失，例如只统计丢失的音频消息。msg_begin 会清除标记。
+ *
+ * @param rb 环形缓冲区指针
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 没有正在写入的消息
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_ring_buffer_msg_tag(esp_coze_ring_buffer_t *rb);
+
+/**
+ * @brief 结束当前消息并发布给消费者（消息模式，仅生产者调用）
+ *
+ * @param rb 环形缓冲区指针
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 没有正在写入的消息
+ *         - ESP_ERR_INVALID_SIZE: 消息超过缓冲区容量，已丢弃
+ */
+esp_err_t esp_coze_ring_buffer_msg_end(esp_coze_ring_buffer_t *rb);
+
+/**
+ * @brief 放弃当前未完成的消息（例如连接断开），计入 truncated（消息模式，仅生产者调用）
+ *
+ * @param rb 环形缓冲区指针
+ */
+void esp_coze_ring_buffer_msg_abort(esp_coze_ring_buffer_t *rb);
+
+/**
+ * @brief 读取一条完整消息（消息模式，仅消费者调用）
+ *
+ * 根据记录长度头直接定位消息边界，不需要扫描消息内容。
+ *
+ * @param rb 环形缓冲区指针
+ * @param data 输出缓冲区，读取成功时末尾追加'\0'
+ * @param max_len 输出缓冲区大小
+ * @param actual_len 消息长度
+ * @return esp_err_t
+ *         - ESP_OK: 读取成功
+ *         - ESP_ERR_NOT_FOUND: 当前没有完整消息
+ *         - ESP_ERR_INVALID_SIZE: 消息超过输出缓冲区，已跳过该消息，actual_len为消息长度
+ *         - ESP_ERR_INVALID_STATE: 有peek的消息还没有提交
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_ring_buffer_read_message(esp_coze_ring_buffer_t *rb, uint8_t *data, size_t max_len, size_t *actual_len);
+
+/**
+ * @brief 原地查看最老的一条完整消息（消息模式，仅消费者调用）
+ *
+ * 成功后该消息被占用，生产者不会覆盖它，处理完后必须调用 commit_message 释放。
+ *
+ * @param rb 环形缓冲区指针
+ * @param view 输出消息视图
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NOT_FOUND: 当前没有完整消息
+ *         - ESP_ERR_INVALID_STATE: 上一条peek的消息还没有提交
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_ring_buffer_peek_message(esp_coze_ring_buffer_t *rb, esp_coze_ring_buffer_msg_view_t *view);
+
+/**
+ * @brief 提交peek得到的消息，释放其占用的缓冲区空间（消息模式，仅消费者调用）
+ *
+ * @param rb 环形缓冲区指针
+ * @param view peek_message 返回的视图
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 没有被占用的消息
+ *         - ESP_ERR_INVALID_ARG: 参数错误
+ */
+esp_err_t esp_coze_ring_buffer_commit_message(esp_coze_ring_buffer_t *rb, const esp_coze_ring_buffer_msg_view_t *view);
+
+/**
+ * @brief 获取消息的连续内存
+ *
+ * 未回绕的消息直接返回缓冲区内的指针；只有跨越缓冲区末尾的消息才拷贝到scratch中拼接。
+ *
+ * @param view 消息视图
+ * @param scratch 拼接用的临时缓冲区
+ * @param scratch_len 临时缓冲区大小
+ * @return const uint8_t* 连续的消息数据（不以'\0'结尾），scratch不足时返回NULL
+ */
+const uint8_t *esp_coze_ring_buffer_view_linearize(const esp_coze_ring_buffer_msg_view_t *view,
+                                                   uint8_t *scratch, size_t scratch_len);
+
+/**
+ * @brief 获取消息模式统计信息
+ *
+ * @param rb 环形缓冲区指针
+ * @param stats 输出统计信息
+ * @return esp_err_t ESP_OK表示成功
+ */
+esp_err_t esp_coze_ring_buffer_get_msg_stats(esp_coze_ring_buffer_t *rb, esp_coze_ring_buffer_msg_stats_t *stats);
+
 /**
  * @brief 获取环形缓冲区可用数据量
  *
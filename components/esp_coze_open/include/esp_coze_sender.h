@@ -0,0 +1,144 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 16:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 16:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\include\esp_coze_sender.h
+ * @Description: 扣子上行消息异步发送任务
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_websocket_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_COZE_SENDER_AUDIO_SLOTS     8    // 音频通道消息槽数量（队列深度）
+#define ESP_COZE_SENDER_CONTROL_SLOTS   4    // 控制通道消息槽数量（队列深度）
+#define ESP_COZE_SENDER_SLOT_SIZE       8192 // 每个消息槽的初始大小，控制通道不够时按需扩容
+#define ESP_COZE_SENDER_SEND_TIMEOUT_MS 5000 // 单条消息发送超时，网络卡死时让队列按策略丢弃
+
+/**
+ * @brief 上行消息种类，决定走哪个通道以及排队规则
+ *
+ * 有序的控制消息之间保持提交顺序；立即发送的控制消息不等待音频，也可以越过
+ * 还在等待音频发完的有序控制消息先发出。
+ */
+typedef enum {
+    ESP_COZE_TX_KIND_OTHER = 0,        ///< 其他文本消息：控制通道，排在它之前提交的音频之后
+    ESP_COZE_TX_KIND_AUDIO_APPEND,     ///< input_audio_buffer.append：音频通道
+    ESP_COZE_TX_KIND_AUDIO_COMPLETE,   ///< input_audio_buffer.complete：控制通道，排在它之前提交的音频之后
+    ESP_COZE_TX_KIND_CHAT_CANCEL,      ///< conversation.chat.cancel：控制通道，立即发送
+    ESP_COZE_TX_KIND_CHAT_UPDATE,      ///< chat.update：控制通道，立即发送
+    ESP_COZE_TX_KIND_GENERATE_AUDIO,   ///< input_text.generate_audio：控制通道，立即发送
+    ESP_COZE_TX_KIND_BINARY,           ///< 二进制帧：控制通道，排在它之前提交的音频之后
+    ESP_COZE_TX_KIND_MAX,
+} esp_coze_tx_kind_t;
+
+/**
+ * @brief 音频通道满时的处理策略
+ */
+typedef enum {
+    ESP_COZE_SENDER_DROP_OLDEST = 0,   ///< 丢弃最老的未发送音频，保证最新的音频能发出（默认）
+    ESP_COZE_SENDER_DROP_NEWEST,       ///< 丢弃新提交的音频
+} esp_coze_sender_policy_t;
+
+/**
+ * @brief 一条待发送的消息，由 esp_coze_sender_alloc 分配
+ */
+typedef struct {
+    char *buf;                 ///< 消息缓冲区
+    size_t cap;                ///< 缓冲区容量
+    size_t len;                ///< 消息长度，由调用方在提交前填写
+    esp_coze_tx_kind_t kind;   ///< 消息种类
+    uint32_t audio_seq;        ///< 内部使用：音频消息的序号 / 控制消息需要等待的音频序号
+    uint8_t index;             ///< 内部使用：槽位编号
+} esp_coze_tx_msg_t;
+
+/**
+ * @brief 发送统计
+ */
+typedef struct {
+    uint32_t sent[2];          ///< 发送成功的消息数（[0]控制通道，[1]音频通道）
+    uint32_t dropped[2];       ///< 通道满被丢弃的消息数
+    uint32_t send_failed;      ///< 发送失败（未连接或超时）的消息数
+    uint32_t coalesced;        ///< 与已排队的同类控制消息合并的次数
+    uint32_t pending[2];       ///< 当前排队消息数
+    uint32_t max_pending[2];   ///< 排队消息数的最大值
+    uint64_t bytes_sent[2];    ///< 发送成功的总字节数
+} esp_coze_sender_stats_t;
+
+/**
+ * @brief 初始化发送任务
+ *
+ * 分配消息槽（优先PSRAM）并创建发送任务，之后所有上行文本消息都由该任务调用
+ * esp_websocket_client_send_text 发出，录音和按键等调用方只把消息放入队列，
+ * 不会因为TCP背压而阻塞。
+ *
+ * @param client WebSocket客户端句柄
+ * @param policy 音频通道满时的处理策略
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_ERR_INVALID_STATE: 已经初始化
+ *         - ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t esp_coze_sender_init(esp_websocket_client_handle_t client, esp_coze_sender_policy_t policy);
+
+/**
+ * @brief 停止发送任务并释放资源，未发送的消息直接丢弃
+ */
+void esp_coze_sender_deinit(void);
+
+/**
+ * @brief 分配一个消息槽
+ *
+ * 音频通道没有空闲槽时按策略丢弃最老的未发送音频或返回失败；控制通道没有空闲槽时返回失败。
+ * 不阻塞。
+ *
+ * @param kind 消息种类
+ * @param len 需要的缓冲区大小
+ * @param out 输出消息
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 发送任务未初始化
+ *         - ESP_ERR_NO_MEM: 通道已满（已计入dropped）或扩容失败
+ *         - ESP_ERR_INVALID_SIZE: 音频消息超过槽大小
+ */
+esp_err_t esp_coze_sender_alloc(esp_coze_tx_kind_t kind, size_t len, esp_coze_tx_msg_t **out);
+
+/**
+ * @brief 提交消息，之后由发送任务负责发送和回收
+ *
+ * 控制通道中已经排队的同类消息（且之后没有新的音频）会与本消息合并，本消息直接回收。
+ *
+ * @param msg 已填写len的消息
+ */
+void esp_coze_sender_submit(esp_coze_tx_msg_t *msg);
+
+/**
+ * @brief 放弃已分配但不再发送的消息
+ *
+ * @param msg 消息
+ */
+void esp_coze_sender_discard(esp_coze_tx_msg_t *msg);
+
+/**
+ * @brief 获取发送统计
+ *
+ * @param stats 输出统计
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ */
+esp_err_t esp_coze_sender_get_stats(esp_coze_sender_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,141 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 11:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 11:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\src\esp_coze_base64.c
+ * @Description: 查表式base64编解码实现
+ *
+ */
+#include "esp_coze_base64.h"
+
+// 非法字符标记，6位值移位后最多占用低24位，标记放在最高位，四张表按位或后仍能检出
+#define B64_INVALID 0x80000000u
+
+// 字符到6位值的映射，非法字符为0xFF
+#define B64V(c) (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' :        \
+                 ((c) >= 'a' && (c) <= 'z') ? (c) - 'a' + 26 :   \
+                 ((c) >= '0' && (c) <= '9') ? (c) - '0' + 52 :   \
+                 ((c) == '+') ? 62 : ((c) == '/') ? 63 : 0xFF)
+
+// 编译期生成256项查找表，每项为该字符的6位值左移shift位
+#define B64E(c, shift) ((B64V(c) == 0xFF) ? B64_INVALID : ((uint32_t)B64V(c) << (shift)))
+#define B64R4(c, s)    B64E((c), s), B64E((c) + 1, s), B64E((c) + 2, s), B64E((c) + 3, s)
+#define B64R16(c, s)   B64R4((c), s), B64R4((c) + 4, s), B64R4((c) + 8, s), B64R4((c) + 12, s)
+#define B64R64(c, s)   B64R16((c), s), B64R16((c) + 16, s), B64R16((c) + 32, s), B64R16((c) + 48, s)
+#define B64TABLE(s)    { B64R64(0, s), B64R64(64, s), B64R64(128, s), B64R64(192, s) }
+
+// 四个字符位置各一张表，解码一组只需4次查表和3次按位或
+static const uint32_t s_dec0[256] = B64TABLE(18);
+static const uint32_t s_dec1[256] = B64TABLE(12);
+static const uint32_t s_dec2[256] = B64TABLE(6);
+static const uint32_t s_dec3[256] = B64TABLE(0);
+
+/**
+ * @brief base64解码
+ */
+esp_err_t esp_coze_base64_decode(const char *src, size_t src_len, uint8_t *dst, size_t dst_len, size_t *out_len)
+{
+    if ((!src && src_len > 0) || !dst || !out_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *out_len = 0;
+
+    // 去掉末尾的'='填充，剩余不足4个字符的尾部单独处理
+    while (src_len > 0 && src[src_len - 1] == '=') {
+        src_len--;
+    }
+    size_t tail = src_len & 3;
+    if (tail == 1) {
+        return ESP_FAIL;
+    }
+
+    size_t total = (src_len / 4) * 3 + (tail ? tail - 1 : 0);
+    if (total > dst_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint8_t *s = (const uint8_t *)src;
+    const uint8_t *s_end = s + (src_len - tail);
+    uint8_t *d = dst;
+    uint32_t bad = 0;
+
+    // 每轮解码两组（8字符→6字节），先读完输入再写输出，原地解码时写入位置永远落后于读取位置
+    while (s_end - s >= 8) {
+        uint32_t a = s_dec0[s[0]] | s_dec1[s[1]] | s_dec2[s[2]] | s_dec3[s[3]];
+        uint32_t b = s_dec0[s[4]] | s_dec1[s[5]] | s_dec2[s[6]] | s_dec3[s[7]];
+        bad |= a | b;
+        d[0] = (uint8_t)(a >> 16);
+        d[1] = (uint8_t)(a >> 8);
+        d[2] = (uint8_t)a;
+        d[3] = (uint8_t)(b >> 16);
+        d[4] = (uint8_t)(b >> 8);
+        d[5] = (uint8_t)b;
+        s += 8;
+        d += 6;
+    }
+
+    if (s < s_end) {
+        uint32_t a = s_dec0[s[0]] | s_dec1[s[1]] | s_dec2[s[2]] | s_dec3[s[3]];
+        bad |= a;
+        d[0] = (uint8_t)(a >> 16);
+        d[1] = (uint8_t)(a >> 8);
+        d[2] = (uint8_t)a;
+        s += 4;
+        d += 3;
+    }
+
+    // 尾部2个字符得到1字节，3个字符得到2字节
+    if (tail >= 2) {
+        uint32_t a = s_dec0[s[0]] | s_dec1[s[1]] | (tail == 3 ? s_dec2[s[2]] : 0);
+        bad |= a;
+        d[0] = (uint8_t)(a >> 16);
+        if (tail == 3) {
+            d[1] = (uint8_t)(a >> 8);
+        }
+    }
+
+    if (bad & B64_INVALID) {
+        return ESP_FAIL;
+    }
+
+    *out_len = total;
+    return ESP_OK;
+}
+
+static const char s_enc[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * @brief base64编码
+ */
+size_t esp_coze_base64_encode(const uint8_t *src, size_t src_len, char *dst)
+{
+    const uint8_t *s = src;
+    const uint8_t *s_end = src + (src_len - src_len % 3);
+    char *d = dst;
+
+    // 每3字节拼成24位，再按6位一组查表
+    while (s < s_end) {
+        uint32_t v = ((uint32_t)s[0] << 16) | ((uint32_t)s[1] << 8) | s[2];
+        d[0] = s_enc[v >> 18];
+        d[1] = s_enc[(v >> 12) & 0x3F];
+        d[2] = s_enc[(v >> 6) & 0x3F];
+        d[3] = s_enc[v & 0x3F];
+        s += 3;
+        d += 4;
+    }
+
+    // 尾部1字节得到2个字符+"=="，2字节得到3个字符+"="
+    size_t tail = src_len % 3;
+    if (tail) {
+        uint32_t v = ((uint32_t)s[0] << 16) | (tail == 2 ? (uint32_t)s[1] << 8 : 0);
+        d[0] = s_enc[v >> 18];
+        d[1] = s_enc[(v >> 12) & 0x3F];
+        d[2] = tail == 2 ? s_enc[(v >> 6) & 0x3F] : '=';
+        d[3] = '=';
+        d += 4;
+    }
+
+    return (size_t)(d - dst);
+}
@@ -9,62 +9,69 @@
 */
 #include "esp_coze_chat.h"
 #include "esp_coze_ring_buffer.h"
+#include "esp_coze_json_scan.h"
+#include "esp_coze_dispatch.h"
 #include "cJSON.h"
-#include "mbedtls/base64.h"
+#include "esp_coze_base64.h"
 #include "esp_coze_events.h"
 #include "esp_coze_chat_config.h"
 #include "opus_audio_decoder.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 static const char *TAG = "ESP_COZE_CHAT";
 
 static esp_coze_chat_handle_t *g_coze_handle = NULL;
 static esp_coze_ring_buffer_t g_ring_buffer = {0};
+
+// WebSocket帧操作码（RFC 6455）
+#define WS_OPCODE_CONTINUATION 0x00
+#define WS_OPCODE_TEXT         0x01
+#define WS_OPCODE_BINARY       0x02
 static TaskHandle_t g_parser_task_handle = NULL;
 
 // Opus解码器相关
 static opus_audio_decoder_t *g_opus_decoder = NULL;
 static bool g_audio_format_is_opus = false;
 
+#define DL_OPUS_MAX_RATE            48000   // 下行Opus最高采样率
+#define DL_OPUS_MAX_FRAME_MS        60      // 解码器按最长60ms一帧准备缓冲，服务端不一定按请求的帧长发
+#define DL_OPUS_MAX_FRAME_SAMPLES   (DL_OPUS_MAX_RATE / 1000 * DL_OPUS_MAX_FRAME_MS)
+#define DL_MAX_CONCEAL_FRAMES       3       // 一次最多补的丢失帧数，更长的缺口PLC只剩嗡嗡声，不如直接跳过
+#define DL_STREAM_GAP_US            1000000 // 距上一个音频delta超过1秒视为新的一段回复，之间的丢失不补
+#define DL_EVENT_TYPE_SCAN_LEN      256     // 在消息第一块的前这么多字节里找event_type
+
+/**
+ * @brief 下行音频丢包检测
+ *
+ * WebSocket走TCP，不会乱序也不会只是迟到；音频delta真正丢失只有两种情况：
+ * 环形缓冲区放不下被丢弃/覆盖/截断，或者delta本身解码失败。WebSocket任务在每条消息的第一块里
+ * 认出音频delta就给它打上环形缓冲区标记，两个delta之间丢失的带标记消息数就是丢失的帧数，
+ * 文本、字幕等其他消息丢了不算，下一个delta解码前先补上。
+ */
+static struct {
+    uint32_t ring_lost;     ///< 上次统计时环形缓冲区累计丢失的音频delta数
+    uint32_t pending;       ///< 解码失败等待补的帧数
+    int64_t last_us;        ///< 上一个音频delta的到达时间
+} g_dl_loss;
+
+// 下行音频格式：chat.update的output_audio和Opus解码器都由它生成，初始化时由应用协商后传入
+static esp_coze_downlink_format_t g_dl_format = ESP_COZE_DOWNLINK_FORMAT_DEFAULT();
+static uint32_t g_dl_pcm_sample_rate = 24000; // 下行PCM格式时的采样率，chat.updated里带了pcm_config时以其为准
+
+// Opus输出缓冲：补帧时一个delta可能输出多帧
+static EXT_RAM_BSS_ATTR int16_t g_pcm_buffer[(DL_MAX_CONCEAL_FRAMES + 1) * DL_OPUS_MAX_FRAME_SAMPLES];
+
 // 数据解析任务栈 - 放在PSRAM，增加到16KB
 #define DATA_PARSER_STACK_SIZE (16384 / sizeof(StackType_t))
 static EXT_RAM_BSS_ATTR StackType_t data_parser_stack[DATA_PARSER_STACK_SIZE];
 static StaticTask_t data_parser_task_buffer;
 static bool g_parser_running = false;
 
-// 弱实现，应用层可覆盖
-__attribute__((weak)) void esp_coze_on_pcm_audio(const int16_t *pcm, size_t sample_count)
-{
-    (void)pcm; (void)sample_count;
-}
-
-// 弱实现，应用层可覆盖
-__attribute__((weak)) void esp_coze_on_opus_audio(const uint8_t *opus_data, size_t opus_len)
-{
-    (void)opus_data; (void)opus_len;
-    
-    // 测试Opus解码功能
-    if (g_opus_decoder && opus_data && opus_len > 0) {
-        static int16_t pcm_buffer[1440]; // 24kHz * 60ms = 1440样本
-        size_t decoded_samples = 0;
-        
-        esp_err_t ret = opus_audio_decoder_decode(g_opus_decoder, opus_data, opus_len,
-                                                 pcm_buffer, sizeof(pcm_buffer)/sizeof(pcm_buffer[0]),
-                                                 &decoded_samples);
-        if (ret == ESP_OK && decoded_samples > 0) {
-            // ESP_LOGI(TAG, "Opus解码成功: %d样本", (int)decoded_samples);
-            // 这里可以调用PCM音频回调
-            esp_coze_on_pcm_audio(pcm_buffer, decoded_samples);
-        } else {
-            ESP_LOGW(TAG, "Opus解码失败: %s", esp_err_to_name(ret));
-        }
-    }
-}
-
-// 弱实现，应用层可覆盖
-__attribute__((weak)) void esp_coze_on_subtitle_text(const char *subtitle_text, const char *event_id)
-{
-    (void)subtitle_text; (void)event_id;
-}
+// 回绕消息拼接缓冲区初始大小，遇到更长的回绕消息时按需扩容（上限为环形缓冲区容量）
+#define PARSER_LINEAR_BUFFER_SIZE 4096
+static uint8_t *g_linear_buffer = NULL;
+static size_t g_linear_buffer_size = 0;
 
 /**
  * @brief 初始化Opus解码器
@@ -75,10 +82,11 @@ static esp_err_t init_opus_decoder(void)
         return ESP_OK; // 已经初始化
     }
 
+    // 解码输出采样率与请求服务端的采样率一致，播放端不需要再转换
     opus_audio_decoder_config_t config = {
-        .sample_rate = 24000,    // 24kHz采样率
+        .sample_rate = (int)g_dl_format.sample_rate,
         .channels = 1,           // 单声道
-        .max_frame_size = 1440   // 60ms @ 24kHz = 1440样本
+        .max_frame_size = (int)(g_dl_format.sample_rate / 1000 * DL_OPUS_MAX_FRAME_MS)
     };
 
     g_opus_decoder = opus_audio_decoder_create(&config);
@@ -87,7 +95,7 @@ static esp_err_t init_opus_decoder(void)
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Opus解码器初始化成功 (24kHz, 单声道)");
+    ESP_LOGI(TAG, "Opus解码器初始化成功 (%luHz, 单声道)", (unsigned long)g_dl_format.sample_rate);
     return ESP_OK;
 }
 
@@ -103,101 +111,328 @@ static void destroy_opus_decoder(void)
     }
 }
 
+/**
+* @brief 环形缓冲区累计丢失的音频delta数（覆盖、截断、超长、丢弃中带标记的消息）
+*/
+static uint32_t ring_lost_audio(void)
+{
+    esp_coze_ring_buffer_msg_stats_t st;
+    if (esp_coze_ring_buffer_get_msg_stats(&g_ring_buffer, &st) != ESP_OK) {
+        return g_dl_loss.ring_lost;
+    }
+    return st.tagged_lost;
+}
+
+/**
+* @brief 判断消息的第一块是否属于音频delta（WebSocket任务调用）
+*
+* 服务端的event_type排在data之前，只扫描开头一小段；第一块太短、找不到时按非音频处理，
+* 最多少补一帧，不会把其他消息的丢失当成音频。
+*
+* @param data 消息第一块
+* @param len 第一块长度
+*/
+static bool is_audio_delta_head(const char *data, size_t len)
+{
+    static const char *const keys[] = {"event_type"};
+    esp_coze_json_span_t type;
+    if (len > DL_EVENT_TYPE_SCAN_LEN) {
+        len = DL_EVENT_TYPE_SCAN_LEN;
+    }
+    return esp_coze_json_scan_object(data, len, keys, 1, &type) == ESP_OK && type.type == ESP_COZE_JSON_STRING &&
+           esp_coze_dl_event_lookup(type.ptr, type.len) == ESP_COZE_DL_EVENT_CONVERSATION_AUDIO_DELTA;
+}
+
+/**
+* @brief 取出当前delta之前丢失的帧数
+*/
+static uint32_t take_lost_frames(void)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t ring_lost = ring_lost_audio();
+    uint32_t lost = g_dl_loss.pending + (ring_lost - g_dl_loss.ring_lost);
+    bool same_stream = g_dl_loss.last_us != 0 && now - g_dl_loss.last_us <= DL_STREAM_GAP_US;
+
+    g_dl_loss.ring_lost = ring_lost;
+    g_dl_loss.pending = 0;
+    g_dl_loss.last_us = now;
+
+    if (!same_stream) {
+        return 0;
+    }
+    if (lost > DL_MAX_CONCEAL_FRAMES) {
+        ESP_LOGW(TAG, "连续丢失%u帧音频，只补%d帧", (unsigned)lost, DL_MAX_CONCEAL_FRAMES);
+        lost = DL_MAX_CONCEAL_FRAMES;
+    }
+    return lost;
+}
+
+/**
+* @brief 解码一段音频delta，结果填入事件的audio/pcm字段
+*
+* 原地解码，不分配内存：输出写回base64所在的内存，起点向前对齐到4字节，
+* 保证PCM样本按int16对齐访问。调用者需保证audio_base64可写，且其前3个字节
+* 属于同一条消息（JSON中content值前面至少有"content":"，cJSON字符串本身就是对齐的）。
+* Opus数据由组件解码成PCM，应用层统一从 event->pcm 取样本。
+*
+* @param event 事件
+* @param audio_base64 base64编码的音频数据（不要求以'\0'结尾），解码后内容被覆盖
+* @param b64_len base64数据长度
+*/
+static void decode_audio_delta(esp_coze_dl_event_t *event, char *audio_base64, size_t b64_len)
+{
+    uint8_t *raw = (uint8_t *)audio_base64 - ((uintptr_t)audio_base64 & 3);
+    size_t out_len = 0;
+    esp_err_t ret = esp_coze_base64_decode(audio_base64, b64_len, raw, b64_len, &out_len);
+    if (ret != ESP_OK || out_len == 0) {
+        ESP_LOGW(TAG, "Base64解码失败: %s", esp_err_to_name(ret));
+        g_dl_loss.pending++;
+        return;
+    }
+
+    event->audio = raw;
+    event->audio_len = out_len;
+
+    if (!g_audio_format_is_opus) {
+        // PCM格式音频数据直接使用
+        event->pcm = (const int16_t *)raw;
+        event->pcm_samples = out_len / 2;
+        event->pcm_sample_rate = g_dl_pcm_sample_rate;
+        return;
+    }
+
+    // Opus格式音频数据
+    ESP_LOGD(TAG, "收到Opus音频数据，长度: %d", (int)out_len);
+    if (g_opus_decoder) {
+        // 前面丢了帧就先用PLC/FEC补上，再解码本包，播放端拿到的是连续的PCM
+        uint32_t lost = take_lost_frames();
+        size_t decoded_samples = 0;
+        ret = opus_audio_decoder_decode_with_loss(g_opus_decoder, raw, out_len, lost,
+                                                  g_pcm_buffer, sizeof(g_pcm_buffer) / sizeof(g_pcm_buffer[0]),
+                                                  &decoded_samples);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Opus解码失败: %s", esp_err_to_name(ret));
+            g_dl_loss.pending++;
+        }
+        if (decoded_samples > 0) {
+            event->pcm = g_pcm_buffer;
+            event->pcm_samples = decoded_samples;
+            event->pcm_sample_rate = g_dl_format.sample_rate;
+        }
+    }
+}
+
+/**
+* @brief 准备音频delta事件的音频数据
+*
+* 解码后原始消息（或cJSON树中的content）已被二进制音频覆盖，随后清空事件的 json/data，
+* 处理函数只能使用 audio/pcm 字段，esp_coze_dl_event_get_json 返回NULL。
+*
+* @param event 事件
+*/
+static void prepare_audio_delta(esp_coze_dl_event_t *event)
+{
+    static const char *const data_keys[] = {"content"};
+    esp_coze_json_span_t content;
+
+    if (event->data.type == ESP_COZE_JSON_OBJECT &&
+            esp_coze_json_scan_object(event->data.ptr, event->data.len, data_keys, 1, &content) == ESP_OK &&
+            content.type == ESP_COZE_JSON_STRING && !content.escaped) {
+        // 快速路径：在data中直接定位content，消息提交前归解析任务独占，base64区间可以原地解码
+        decode_audio_delta(event, (char *)content.ptr, content.len);
+    } else {
+        // base64中含有转义（例如"\/"）时由cJSON反转义，cJSON树在分发结束后释放
+        cJSON *json = esp_coze_dl_event_get_json(event);
+        cJSON *data_item = json ? cJSON_GetObjectItem(json, "data") : NULL;
+        cJSON *content_item = data_item ? cJSON_GetObjectItem(data_item, "content") : NULL;
+        char *audio_base64 = cJSON_IsString(content_item) ? cJSON_GetStringValue(content_item) : NULL;
+        if (!audio_base64) {
+            return;
+        }
+        decode_audio_delta(event, audio_base64, strlen(audio_base64));
+    }
+
+    event->json = NULL;
+    event->json_len = 0;
+    memset(&event->data, 0, sizeof(event->data));
+}
+
+/**
+* @brief 组件自身关心的事件：错误和对话结果用类型化解码后打印关键字段，
+*        会话配置里的下行PCM采样率也在这里记下
+*
+* @param event 事件
+*/
+static void log_downlink_event(const esp_coze_dl_event_t *event)
+{
+    switch (event->id) {
+    case ESP_COZE_DL_EVENT_ERROR: {
+        esp_coze_dl_error_t err;
+        if (esp_coze_dl_decode_error(&event->data, &err) == ESP_OK) {
+            ESP_LOGE(TAG, "服务端错误: code=%lld, msg=%s", (long long)err.code, err.msg);
+        }
+        break;
+    }
+    case ESP_COZE_DL_EVENT_CONVERSATION_CHAT_FAILED: {
+        esp_coze_dl_chat_t chat;
+        if (esp_coze_dl_decode_chat(&event->data, &chat) == ESP_OK) {
+            ESP_LOGE(TAG, "对话失败: chat_id=%s, code=%lld, msg=%s", chat.id,
+                     (long long)chat.last_error.code, chat.last_error.msg);
+        }
+        break;
+    }
+    case ESP_COZE_DL_EVENT_CONVERSATION_CHAT_COMPLETED: {
+        esp_coze_dl_chat_t chat;
+        if (esp_coze_dl_decode_chat(&event->data, &chat) == ESP_OK &&
+                (chat.present & ESP_COZE_DL_CHAT_HAS_USAGE)) {
+            ESP_LOGI(TAG, "对话完成: chat_id=%s, token=%lld (输入%lld/输出%lld)", chat.id,
+                     (long long)chat.usage.token_count, (long long)chat.usage.input_count,
+                     (long long)chat.usage.output_count);
+        }
+        opus_audio_decoder_stats_t opus_stats;
+        if (g_opus_decoder && opus_audio_decoder_get_stats(g_opus_decoder, &opus_stats) == ESP_OK &&
+                opus_stats.concealed_samples > 0) {
+            ESP_LOGI(TAG, "下行丢包: PLC %u帧, FEC %u帧, 累计隐藏%u ms", (unsigned)opus_stats.plc_frames,
+                     (unsigned)opus_stats.fec_frames, (unsigned)(opus_stats.concealed_samples / (g_dl_format.sample_rate / 1000)));
+        }
+        break;
+    }
+    case ESP_COZE_DL_EVENT_CHAT_UPDATED: {
+        esp_coze_dl_session_t session;
+        if (esp_coze_dl_decode_session(&event->data, &session) == ESP_OK) {
+            ESP_LOGI(TAG, "会话配置: 上行 %s/%lldHz, 下行 %s", session.input_audio.codec,
+                     (long long)session.input_audio.sample_rate, session.output_audio.codec);
+            const esp_coze_dl_session_output_audio_pcm_config_t *pcm = &session.output_audio.pcm_config;
+            if ((session.output_audio.present & ESP_COZE_DL_SESSION_OUTPUT_AUDIO_HAS_PCM_CONFIG) &&
+                    (pcm->present & ESP_COZE_DL_SESSION_OUTPUT_AUDIO_PCM_CONFIG_HAS_SAMPLE_RATE) &&
+                    pcm->sample_rate > 0) {
+                g_dl_pcm_sample_rate = (uint32_t)pcm->sample_rate;
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+* @brief 处理一条下行JSON消息
+*
+* 用零分配扫描器取出 id、event_type 和 data，完美哈希查出事件ID后分发给注册的处理函数，
+* 不构建cJSON树；处理函数用 esp_coze_dl_decode_* 把data解码成结构体。
+*
+* @param json_data 消息数据（不要求以'\0'结尾）
+* @param json_len 消息长度
+*/
+static void handle_downlink_message(const char *json_data, size_t json_len)
+{
+    static const char *const top_keys[] = {"event_type", "data", "id"};
+    esp_coze_json_span_t top[3];
+    if (esp_coze_json_scan_object(json_data, json_len, top_keys, 3, top) != ESP_OK ||
+            top[0].type != ESP_COZE_JSON_STRING) {
+        ESP_LOGW(TAG, "JSON解析失败: %.*s", (int)json_len > 100 ? 100 : (int)json_len, json_data);
+        return;
+    }
+
+    esp_coze_dl_event_t event = {
+        .id = esp_coze_dl_event_lookup(top[0].ptr, top[0].len),
+        .type = top[0].ptr,
+        .type_len = top[0].len,
+        .json = json_data,
+        .json_len = json_len,
+        .event_id = top[2],
+        .data = top[1],
+    };
+
+    bool handled = esp_coze_has_event_handler(event.id);
+    if (event.id == ESP_COZE_DL_EVENT_CONVERSATION_AUDIO_DELTA) {
+        // 音频delta占下行流量的绝大部分，没有处理函数时连解码也省掉
+        if (!handled) {
+            return;
+        }
+        prepare_audio_delta(&event);
+    }
+
+    log_downlink_event(&event);
+
+    if (esp_coze_dispatch_event(&event) == ESP_ERR_NOT_FOUND) {
+        // 没有处理函数的事件只打印出来
+        ESP_LOGI(TAG, "收到事件: %.*s", (int)event.type_len, event.type);
+        ESP_LOGD(TAG, "事件详情: %.*s", (int)json_len, json_data);
+    }
+}
+
+/**
+* @brief 确保回绕消息拼接缓冲区至少有len字节
+*
+* 按2倍扩容，优先使用PSRAM；扩容失败时保留原缓冲区
+*
+* @param len 需要的长度
+* @return true 缓冲区足够
+*/
+static bool ensure_linear_buffer(size_t len)
+{
+    if (len <= g_linear_buffer_size) {
+        return true;
+    }
+
+    size_t new_size = g_linear_buffer_size ? g_linear_buffer_size : PARSER_LINEAR_BUFFER_SIZE;
+    while (new_size < len) {
+        new_size *= 2;
+    }
+    if (new_size > g_ring_buffer.size) {
+        new_size = g_ring_buffer.size;
+    }
+    if (new_size < len) {
+        return false;
+    }
+
+    uint8_t *buf = (uint8_t *)heap_caps_malloc(new_size, MALLOC_CAP_SPIRAM);
+    if (!buf) {
+        buf = (uint8_t *)malloc(new_size);
+    }
+    if (!buf) {
+        ESP_LOGE(TAG, "扩容消息拼接缓冲区失败: %d bytes", (int)new_size);
+        return false;
+    }
+
+    free(g_linear_buffer);
+    g_linear_buffer = buf;
+    g_linear_buffer_size = new_size;
+    ESP_LOGI(TAG, "消息拼接缓冲区扩容到 %d bytes", (int)new_size);
+    return true;
+}
+
 /**
 * @brief 数据解析任务
 */
 static void data_parser_task(void *param)
 {
-    uint8_t json_buffer[4096];
-    size_t json_len;
+    // 只有跨越环形缓冲区末尾的消息才需要拼接，先按常见消息大小分配，遇到更长的再扩容
+    ensure_linear_buffer(PARSER_LINEAR_BUFFER_SIZE);
 
     ESP_LOGI(TAG, "数据解析任务启动");
 
     while (g_parser_running) {
         // 等待数据信号
         if (xSemaphoreTake(g_ring_buffer.data_sem, pdMS_TO_TICKS(100)) == pdTRUE) {
-            // 连续处理所有可用的JSON对象
-            while (esp_coze_ring_buffer_read_json_object(&g_ring_buffer, json_buffer, sizeof(json_buffer), &json_len) == ESP_OK) {
-                // ESP_LOGI(TAG, "解析JSON对象，长度: %d", (int)json_len);
-                // ESP_LOGI(TAG, "JSON内容: %.*s", (int)json_len > 200 ? 200 : (int)json_len, (char*)json_buffer);
-
-                // 解析JSON
-                cJSON *json = cJSON_ParseWithLength((char *)json_buffer, json_len);
-                if (json) {
-                    cJSON *event_type_item = cJSON_GetObjectItem(json, "event_type");
-                    if (event_type_item && cJSON_IsString(event_type_item)) {
-                        const char *event_type = cJSON_GetStringValue(event_type_item);
-
-                        if (strcmp(event_type, "conversation.audio.delta") == 0) {
-                            // 处理音频数据：content 为 base64 编码的音频数据
-                            cJSON *data_item = cJSON_GetObjectItem(json, "data");
-                            if (data_item) {
-                                cJSON *content_item = cJSON_GetObjectItem(data_item, "content");
-                                if (content_item && cJSON_IsString(content_item)) {
-                                    const char *audio_base64 = cJSON_GetStringValue(content_item);
-                                    if (audio_base64) {
-                                        size_t b64_len = strlen(audio_base64);
-                                        size_t raw_len = (b64_len * 3) / 4 + 4;
-                                        uint8_t *raw = (uint8_t *)malloc(raw_len);
-                                        if (raw) {
-                                            size_t out_len = 0;
-                                            int ret = mbedtls_base64_decode(raw, raw_len, &out_len,
-                                                                            (const unsigned char *)audio_base64, b64_len);
-                                            if (ret == 0 && out_len > 0) {
-                                                if (g_audio_format_is_opus) {
-                                                    // Opus格式音频数据
-                                                    ESP_LOGD(TAG, "收到Opus音频数据，长度: %d", (int)out_len);
-                                                    esp_coze_on_opus_audio(raw, out_len);
-                                                } else {
-                                                    // PCM格式音频数据（兼容原有逻辑）
-                                                    if (out_len >= 2) {
-                                                        size_t samples = out_len / 2;
-                                                        esp_coze_on_pcm_audio((const int16_t *)raw, samples);
-                                                    }
-                                                }
-                                            } else {
-                                                ESP_LOGW(TAG, "Base64解码失败 ret=%d", ret);
-                                            }
-                                            free(raw);
-                                        }
-                                    }
-                                }
-                            }
-                        } else if (strcmp(event_type, "conversation.audio.sentence_start") == 0) {
-                            // 处理字幕文本事件
-                            cJSON *id_item = cJSON_GetObjectItem(json, "id");
-                            cJSON *data_item = cJSON_GetObjectItem(json, "data");
-                            if (data_item) {
-                                cJSON *text_item = cJSON_GetObjectItem(data_item, "text");
-                                if (text_item && cJSON_IsString(text_item)) {
-                                    const char *subtitle_text = cJSON_GetStringValue(text_item);
-                                    const char *event_id = (id_item && cJSON_IsString(id_item)) ? 
-                                                           cJSON_GetStringValue(id_item) : "unknown";
-                                    
-                                    if (subtitle_text) {
-                                        ESP_LOGI(TAG, "收到字幕: %s (ID: %s)", subtitle_text, event_id);
-                                        // 调用字幕处理回调
-                                        esp_coze_on_subtitle_text(subtitle_text, event_id);
-                                    }
-                                }
-                            }
-                        } else {
-                            // 其他事件打印详情
-                            char *json_string = cJSON_Print(json);
-                            if (json_string) {
-                                ESP_LOGI(TAG, "收到事件: %s", event_type);
-                                ESP_LOGI(TAG, "事件详情: %s", json_string);
-                                free(json_string);
-                            } else {
-                                ESP_LOGI(TAG, "收到事件: %s (无法格式化详情)", event_type);
-                            }
-                        }
-                    }
-                    cJSON_Delete(json);
-                } else {
-                    ESP_LOGW(TAG, "JSON解析失败: %.*s", (int)json_len > 100 ? 100 : (int)json_len, (char *)json_buffer);
+            // 连续处理所有已完整接收的消息，消息边界由WebSocket帧决定，无需扫描花括号；
+            // 消息在环形缓冲区内原地解析，处理完再提交释放空间
+            esp_coze_ring_buffer_msg_view_t view;
+            while (esp_coze_ring_buffer_peek_message(&g_ring_buffer, &view) == ESP_OK) {
+                // 消息长度不受限制（最大为环形缓冲区容量），未回绕时直接原地解析
+                const uint8_t *msg = NULL;
+                if (view.seg_len[1] == 0 || ensure_linear_buffer(view.len)) {
+                    msg = esp_coze_ring_buffer_view_linearize(&view, g_linear_buffer, g_linear_buffer_size);
+                }
+                if (msg) {
+                    handle_downlink_message((const char *)msg, view.len);
+                } else if (view.len > 0) {
+                    ESP_LOGW(TAG, "回绕消息长度 %d 无法拼接，已跳过", (int)view.len);
                 }
-            } // end while (连续处理JSON对象)
+                esp_coze_ring_buffer_commit_message(&g_ring_buffer, &view);
+            }
         } else {
             // 没有接收到信号，但检查是否有剩余数据
             if (esp_coze_ring_buffer_available(&g_ring_buffer) > 0) {
@@ -206,6 +441,9 @@ static void data_parser_task(void *param)
         }
     }
 
+    free(g_linear_buffer);
+    g_linear_buffer = NULL;
+    g_linear_buffer_size = 0;
     ESP_LOGI(TAG, "数据解析任务退出");
     g_parser_task_handle = NULL;
     vTaskDelete(NULL);
@@ -239,21 +477,28 @@ void example_send_custom_chat_update(void)
         config->input_audio->bit_depth = 16;       // 16位深度
     }
 
-    // 创建自定义输出音频配置
+    // 输出音频配置：编码、采样率、帧长和码率都来自协商好的下行格式
     config->output_audio = calloc(1, sizeof(esp_coze_output_audio_config_t));
     if (config->output_audio) {
-        config->output_audio->codec = ESP_COZE_AUDIO_CODEC_OPUS;  // 使用Opus编码
+        config->output_audio->codec = g_dl_format.codec;
         config->output_audio->speech_rate = 10;    // 1.1倍速
         // 不设置voice_id，使用默认音色
         config->output_audio->voice_id = NULL;
 
-        // Opus配置
-        config->output_audio->opus_config = calloc(1, sizeof(esp_coze_opus_config_t));
-        if (config->output_audio->opus_config) {
-            config->output_audio->opus_config->bitrate = 64000;      // 64kbps码率
-            config->output_audio->opus_config->use_cbr = true;       // 使用CBR编码
-            config->output_audio->opus_config->frame_size_ms = 20.0f; // 20ms帧长
-            config->output_audio->opus_config->sample_rate = 24000;   // 24kHz采样率
+        if (g_dl_format.codec == ESP_COZE_AUDIO_CODEC_OPUS) {
+            config->output_audio->opus_config = calloc(1, sizeof(esp_coze_opus_config_t));
+            if (config->output_audio->opus_config) {
+                config->output_audio->opus_config->bitrate = (int)g_dl_format.bitrate;
+                config->output_audio->opus_config->use_cbr = true;       // 使用CBR编码
+                config->output_audio->opus_config->frame_size_ms = g_dl_format.frame_ms;
+                config->output_audio->opus_config->sample_rate = (int)g_dl_format.sample_rate;
+            }
+        } else {
+            config->output_audio->pcm_config = calloc(1, sizeof(esp_coze_pcm_config_t));
+            if (config->output_audio->pcm_config) {
+                config->output_audio->pcm_config->sample_rate = (int)g_dl_format.sample_rate;
+                config->output_audio->pcm_config->frame_size_ms = g_dl_format.frame_ms;
+            }
         }
     }
 
@@ -327,6 +572,8 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
 
     case WEBSOCKET_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "WebSocket连接断开");
+        // 断开时未收完的消息不会再有后续分片
+        esp_coze_ring_buffer_msg_abort(&g_ring_buffer);
         if (handle) {
             handle->ws_state = ESP_COZE_WS_STATE_DISCONNECTED;
         }
@@ -334,13 +581,34 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
 
     case WEBSOCKET_EVENT_DATA:
         // ESP_LOGI(TAG, "WebSocket接收到数据，长度: %d", data->data_len);
+        // 只处理文本/二进制帧及其延续帧，ping/pong/close等控制帧不进入消息队列
+        if (data->op_code != WS_OPCODE_CONTINUATION && data->op_code != WS_OPCODE_TEXT &&
+                data->op_code != WS_OPCODE_BINARY) {
+            break;
+        }
+
+        // 新消息的第一块：客户端按接收缓冲区把一帧拆成多次事件，payload_offset为0时才是帧的开头；
+        // 延续帧（分片消息的后续片段）属于同一条消息，不能重新开始
+        if (data->payload_offset == 0 && data->op_code != WS_OPCODE_CONTINUATION) {
+            esp_coze_ring_buffer_msg_begin(&g_ring_buffer, data->payload_len);
+            // 音频delta打上标记，环形缓冲区丢消息时才能只统计丢失的音频
+            if (data->data_ptr && is_audio_delta_head(data->data_ptr, data->data_len)) {
+                esp_coze_ring_buffer_msg_tag(&g_ring_buffer);
+            }
+        }
+
         if (data->data_ptr && data->data_len > 0) {
-            // 直接写入环形缓冲区
-            esp_err_t ret = esp_coze_ring_buffer_write(&g_ring_buffer, (uint8_t *)data->data_ptr, data->data_len);
-            if (ret != ESP_OK) {
-                ESP_LOGW(TAG, "写入环形缓冲区失败: %s", esp_err_to_name(ret));
+            esp_err_t ret = esp_coze_ring_buffer_msg_append(&g_ring_buffer, (const uint8_t *)data->data_ptr, data->data_len);
+            // 按背压策略丢弃的消息（超长、空间不足、阻塞超时）在msg_end时计数，这里不逐块打印
+            if (ret != ESP_OK && ret != ESP_ERR_INVALID_SIZE && ret != ESP_ERR_NO_MEM && ret != ESP_ERR_TIMEOUT) {
+                ESP_LOGW(TAG, "写入消息队列失败: %s", esp_err_to_name(ret));
             }
         }
+
+        // 最后一个分片的最后一块到达，整条消息入队
+        if (data->fin && data->payload_offset + data->data_len >= data->payload_len) {
+            esp_coze_ring_buffer_msg_end(&g_ring_buffer);
+        }
         break;
 
     case WEBSOCKET_EVENT_ERROR:
@@ -381,6 +649,18 @@ esp_err_t esp_coze_chat_init_with_config(const esp_coze_chat_config_t *config)
         esp_coze_chat_destroy();
     }
 
+    if (config->downlink_format) {
+        if (config->downlink_format->codec != ESP_COZE_AUDIO_CODEC_OPUS &&
+                config->downlink_format->codec != ESP_COZE_AUDIO_CODEC_PCM) {
+            ESP_LOGE(TAG, "不支持的下行音频编码");
+            return ESP_ERR_INVALID_ARG;
+        }
+        g_dl_format = *config->downlink_format;
+    } else {
+        g_dl_format = (esp_coze_downlink_format_t)ESP_COZE_DOWNLINK_FORMAT_DEFAULT();
+    }
+    g_dl_pcm_sample_rate = g_dl_format.sample_rate;
+
     // 分配句柄内存
     g_coze_handle = calloc(1, sizeof(esp_coze_chat_handle_t));
     if (g_coze_handle == NULL) {
@@ -438,12 +718,20 @@ esp_err_t esp_coze_chat_init_with_config(const esp_coze_chat_config_t *config)
     // 注册WebSocket事件处理器
     esp_websocket_register_events(g_coze_handle->ws_client, WEBSOCKET_EVENT_ANY, websocket_event_handler, g_coze_handle);
 
+    // 启动上行发送任务，之后所有上行消息都经它发出
+    esp_err_t ret = esp_coze_sender_init(g_coze_handle->ws_client, config->uplink_policy);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "初始化上行发送任务失败");
+        goto cleanup;
+    }
+
     // 初始化环形缓冲区
-    esp_err_t ret = esp_coze_ring_buffer_init(&g_ring_buffer, RING_BUFFER_SIZE);
+    ret = esp_coze_ring_buffer_init(&g_ring_buffer, RING_BUFFER_SIZE);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "初始化环形缓冲区失败");
         goto cleanup;
     }
+    esp_coze_ring_buffer_set_policy(&g_ring_buffer, config->downlink_policy, config->downlink_block_timeout_ms);
 
     // 启动数据解析任务 - 使用静态任务，栈在PSRAM
     g_parser_running = true;
@@ -481,6 +769,7 @@ cleanup:
         free(g_coze_handle);
         g_coze_handle = NULL;
     }
+    esp_coze_sender_deinit();
     esp_coze_ring_buffer_deinit(&g_ring_buffer);
     return ESP_ERR_NO_MEM;
 }
@@ -526,6 +815,9 @@ esp_err_t esp_coze_chat_destroy()
         }
     }
 
+    // 先停止发送任务，它还持有WebSocket客户端
+    esp_coze_sender_deinit();
+
     // 销毁WebSocket客户端
     if (g_coze_handle->ws_client) {
         esp_websocket_client_destroy(g_coze_handle->ws_client);
@@ -601,24 +893,42 @@ esp_err_t esp_coze_chat_disconnect()
 * @brief 通过WebSocket发送文本消息
 */
 esp_err_t esp_coze_websocket_send_text(const char *data)
+{
+    if (!data) {
+        ESP_LOGE(TAG, "发送数据不能为空");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return esp_coze_websocket_send_text_len(data, strlen(data));
+}
+
+/**
+* @brief 通过WebSocket发送指定长度的文本消息
+*/
+esp_err_t esp_coze_websocket_send_text_len(const char *data, size_t data_len)
 {
     if (g_coze_handle == NULL || g_coze_handle->ws_client == NULL) {
         ESP_LOGE(TAG, "WebSocket客户端未初始化");
         return ESP_ERR_INVALID_STATE;
     }
 
-    if (!data) {
+    if (!data || data_len == 0) {
         ESP_LOGE(TAG, "发送数据不能为空");
         return ESP_ERR_INVALID_ARG;
     }
 
-    int len = esp_websocket_client_send_text(g_coze_handle->ws_client, data, strlen(data), portMAX_DELAY);
-    if (len < 0) {
-        ESP_LOGE(TAG, "发送WebSocket文本消息失败");
+    // 拷贝进控制通道，由发送任务按提交顺序发出
+    esp_coze_tx_msg_t *msg = NULL;
+    esp_err_t ret = esp_coze_sender_alloc(ESP_COZE_TX_KIND_OTHER, data_len, &msg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "WebSocket文本消息入队失败: %s", esp_err_to_name(ret));
         return ESP_FAIL;
     }
+    memcpy(msg->buf, data, data_len);
+    msg->len = data_len;
+    esp_coze_sender_submit(msg);
 
-    ESP_LOGD(TAG, "成功发送WebSocket文本消息，长度: %d", len);
+    ESP_LOGD(TAG, "WebSocket文本消息已入队，长度: %d", (int)data_len);
     return ESP_OK;
 }
 
@@ -637,12 +947,36 @@ esp_err_t esp_coze_websocket_send_binary(const uint8_t *data, size_t len)
         return ESP_ERR_INVALID_ARG;
     }
 
-    int sent_len = esp_websocket_client_send_bin(g_coze_handle->ws_client, (char *)data, len, portMAX_DELAY);
-    if (sent_len < 0) {
-        ESP_LOGE(TAG, "发送WebSocket二进制消息失败");
+    // 与文本消息一样拷贝进控制通道，由发送任务按提交顺序、带超时发出
+    esp_coze_tx_msg_t *msg = NULL;
+    esp_err_t ret = esp_coze_sender_alloc(ESP_COZE_TX_KIND_BINARY, len, &msg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "WebSocket二进制消息入队失败: %s", esp_err_to_name(ret));
         return ESP_FAIL;
     }
+    memcpy(msg->buf, data, len);
+    msg->len = len;
+    esp_coze_sender_submit(msg);
 
-    ESP_LOGD(TAG, "成功发送WebSocket二进制消息，长度: %d", sent_len);
+    ESP_LOGD(TAG, "WebSocket二进制消息已入队，长度: %d", (int)len);
     return ESP_OK;
 }
+
+/**
+* @brief 获取下行消息统计信息
+*/
+esp_err_t esp_coze_chat_get_downlink_stats(esp_coze_ring_buffer_msg_stats_t *stats, size_t *linear_buffer_size)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!g_ring_buffer.buffer) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (linear_buffer_size) {
+        *linear_buffer_size = g_linear_buffer_size;
+    }
+    return esp_coze_ring_buffer_get_msg_stats(&g_ring_buffer, stats);
+}
@@ -541,3 +541,83 @@ esp_err_t esp_coze_generate_event_id(char *event_id, size_t max_len)
 
     return ESP_OK;
 }
+
+// 服务端下行支持的采样率（升序）及Opus在各采样率下有意义的码率上限
+static const uint32_t dl_opus_rates[] = {8000, 12000, 16000, 24000, 48000};
+static const uint32_t dl_opus_max_bitrates[] = {24000, 32000, 48000, 64000, 96000};
+static const uint32_t dl_pcm_rates[] = {8000, 16000, 22050, 24000, 32000, 44100, 48000};
+
+static bool rate_in_list(uint32_t rate, const uint32_t *rates, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (rates[i] == rate) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 根据播放端能力和设备要求协商下行音频格式
+ */
+esp_err_t esp_coze_negotiate_downlink_format(const esp_coze_playback_caps_t *caps,
+                                             const esp_coze_downlink_profile_t *profile,
+                                             esp_coze_downlink_format_t *out)
+{
+    if (!caps || !profile || !out || (caps->native_rate_count && !caps->native_rates)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const uint32_t *rates;
+    size_t count;
+    if (profile->codec == ESP_COZE_AUDIO_CODEC_OPUS) {
+        rates = dl_opus_rates;
+        count = sizeof(dl_opus_rates) / sizeof(dl_opus_rates[0]);
+    } else if (profile->codec == ESP_COZE_AUDIO_CODEC_PCM) {
+        rates = dl_pcm_rates;
+        count = sizeof(dl_pcm_rates) / sizeof(dl_pcm_rates[0]);
+    } else {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    uint32_t max_rate = profile->max_sample_rate ? profile->max_sample_rate : UINT32_MAX;
+
+    // 优先：不超过上限、扬声器能直接播放的最高采样率
+    size_t pick = count;
+    for (size_t i = 0; i < count && rates[i] <= max_rate; i++) {
+        if (rate_in_list(rates[i], caps->native_rates, caps->native_rate_count)) {
+            pick = i;
+        }
+    }
+    bool native = pick < count;
+
+    if (!native) {
+        // 需要重采样：取不低于扬声器默认采样率的最低采样率，不损失扬声器能播放的带宽
+        uint32_t want = caps->default_rate < max_rate ? caps->default_rate : max_rate;
+        pick = 0;
+        for (size_t i = 0; i < count && rates[i] <= max_rate; i++) {
+            pick = i;
+            if (rates[i] >= want) {
+                break;
+            }
+        }
+    }
+
+    out->codec = profile->codec;
+    out->sample_rate = rates[pick];
+    out->native = native;
+
+    if (profile->codec == ESP_COZE_AUDIO_CODEC_OPUS) {
+        uint16_t f = profile->frame_ms;
+        out->frame_ms = (f == 10 || f == 20 || f == 40 || f == 60) ? f : 20;
+        uint32_t cap = dl_opus_max_bitrates[pick];
+        uint32_t bitrate = profile->bitrate && profile->bitrate < cap ? profile->bitrate : cap;
+        out->bitrate = bitrate < 6000 ? 6000 : bitrate;
+    } else {
+        out->frame_ms = profile->frame_ms ? profile->frame_ms : 20;
+        out->bitrate = out->sample_rate * 16;
+    }
+
+    ESP_LOGI(TAG, "下行音频: %s %" PRIu32 "Hz %ums %" PRIu32 "bps（%s）", audio_codec_strings[out->codec],
+             out->sample_rate, (unsigned)out->frame_ms, out->bitrate, native ? "直接播放" : "播放端重采样");
+    return ESP_OK;
+}
@@ -0,0 +1,161 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 14:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 14:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\src\esp_coze_dispatch.c
+ * @Description: 扣子下行事件分发与处理函数注册实现
+ *
+ */
+#include "esp_coze_dispatch.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "COZE_DISPATCH";
+
+/**
+ * @brief 处理函数槽位
+ */
+typedef struct {
+    esp_coze_dl_event_handler_t handler; ///< 处理函数，NULL表示空槽位
+    void *user_ctx;                      ///< 用户参数
+} dl_handler_slot_t;
+
+// 按事件ID直接索引的处理函数表，分发时不需要查找
+static dl_handler_slot_t s_handlers[ESP_COZE_DL_EVENT_MAX][ESP_COZE_DL_MAX_HANDLERS];
+static portMUX_TYPE s_handlers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 注册下行事件处理函数
+ */
+esp_err_t esp_coze_register_event_handler(esp_coze_dl_event_id_t id, esp_coze_dl_event_handler_t handler,
+                                          void *user_ctx)
+{
+    if ((unsigned)id >= ESP_COZE_DL_EVENT_MAX || !handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    dl_handler_slot_t *slots = s_handlers[id];
+
+    portENTER_CRITICAL(&s_handlers_lock);
+    dl_handler_slot_t *free_slot = NULL;
+    for (int i = 0; i < ESP_COZE_DL_MAX_HANDLERS; i++) {
+        if (slots[i].handler == handler) {
+            // 重复注册只更新用户参数
+            slots[i].user_ctx = user_ctx;
+            free_slot = NULL;
+            ret = ESP_OK;
+            break;
+        }
+        if (!slots[i].handler && !free_slot) {
+            free_slot = &slots[i];
+        }
+    }
+    if (free_slot) {
+        free_slot->handler = handler;
+        free_slot->user_ctx = user_ctx;
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_handlers_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "事件 %s 的处理函数已满", esp_coze_dl_event_name(id));
+    }
+    return ret;
+}
+
+/**
+ * @brief 注销下行事件处理函数
+ */
+esp_err_t esp_coze_unregister_event_handler(esp_coze_dl_event_id_t id, esp_coze_dl_event_handler_t handler)
+{
+    if ((unsigned)id >= ESP_COZE_DL_EVENT_MAX || !handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    dl_handler_slot_t *slots = s_handlers[id];
+
+    portENTER_CRITICAL(&s_handlers_lock);
+    for (int i = 0; i < ESP_COZE_DL_MAX_HANDLERS; i++) {
+        if (slots[i].handler == handler) {
+            slots[i].handler = NULL;
+            slots[i].user_ctx = NULL;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_handlers_lock);
+
+    return ret;
+}
+
+/**
+ * @brief 查询事件是否注册了处理函数
+ */
+bool esp_coze_has_event_handler(esp_coze_dl_event_id_t id)
+{
+    if ((unsigned)id >= ESP_COZE_DL_EVENT_MAX) {
+        return false;
+    }
+
+    bool found = false;
+    portENTER_CRITICAL(&s_handlers_lock);
+    for (int i = 0; i < ESP_COZE_DL_MAX_HANDLERS && !found; i++) {
+        found = s_handlers[id][i].handler != NULL;
+    }
+    portEXIT_CRITICAL(&s_handlers_lock);
+    return found;
+}
+
+/**
+ * @brief 获取事件的cJSON树，第一次调用时才解析
+ */
+cJSON *esp_coze_dl_event_get_json(esp_coze_dl_event_t *event)
+{
+    if (!event || !event->json) {
+        return NULL;
+    }
+
+    if (!event->root) {
+        event->root = cJSON_ParseWithLength(event->json, event->json_len);
+        if (!event->root) {
+            ESP_LOGW(TAG, "JSON解析失败: %.*s", (int)event->json_len > 100 ? 100 : (int)event->json_len,
+                     event->json);
+        }
+    }
+    return event->root;
+}
+
+/**
+ * @brief 把事件分发给已注册的处理函数
+ */
+esp_err_t esp_coze_dispatch_event(esp_coze_dl_event_t *event)
+{
+    if (!event || (unsigned)event->id >= ESP_COZE_DL_EVENT_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 拷贝一份处理函数列表再调用，处理函数里可以安全地注册/注销
+    dl_handler_slot_t slots[ESP_COZE_DL_MAX_HANDLERS];
+    portENTER_CRITICAL(&s_handlers_lock);
+    memcpy(slots, s_handlers[event->id], sizeof(slots));
+    portEXIT_CRITICAL(&s_handlers_lock);
+
+    int called = 0;
+    for (int i = 0; i < ESP_COZE_DL_MAX_HANDLERS; i++) {
+        if (slots[i].handler) {
+            slots[i].handler(event, slots[i].user_ctx);
+            called++;
+        }
+    }
+
+    if (event->root) {
+        cJSON_Delete(event->root);
+        event->root = NULL;
+    }
+
+    return called > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -9,16 +9,160 @@
  */
 #include "esp_coze_events.h"
 #include "esp_coze_chat.h"
+#include "esp_coze_base64.h"
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_timer.h"
+#include "esp_coze_sender.h"
+#include "freertos/FreeRTOS.h"
 #include <string.h>
 #include <stdlib.h>
 
 static const char *TAG = "ESP_COZE_EVENTS";
 
-// 外部声明WebSocket发送函数
-extern esp_err_t esp_coze_websocket_send_text(const char *data);
+/**
+ * @brief 上行事件模板
+ *
+ * 事件按 {"id":"<ID>","event_type":"<类型>"<data开头><正文><结尾> 拼接，
+ * 除ID和正文外的片段都是编译期常量，长度也在编译期算好。
+ */
+typedef struct {
+    const char *mid;   ///< ID之后、正文之前的固定片段
+    size_t mid_len;    ///< mid长度
+    const char *tail;  ///< 正文之后的固定片段
+    size_t tail_len;   ///< tail长度
+} uplink_template_t;
+
+#define UPLINK_HEAD "{\"id\":\""
+#define UPLINK_MID(type, data_open) "\",\"event_type\":\"" type "\"" data_open
+#define UPLINK_TEMPLATE(type, data_open, tail) \
+    { UPLINK_MID(type, data_open), sizeof(UPLINK_MID(type, data_open)) - 1, tail, sizeof(tail) - 1 }
+
+static const uplink_template_t s_tpl_audio_append =
+    UPLINK_TEMPLATE("input_audio_buffer.append", ",\"data\":{\"delta\":\"", "\"}}");
+static const uplink_template_t s_tpl_audio_complete =
+    UPLINK_TEMPLATE("input_audio_buffer.complete", "", "}");
+static const uplink_template_t s_tpl_chat_cancel =
+    UPLINK_TEMPLATE("conversation.chat.cancel", "", "}");
+static const uplink_template_t s_tpl_generate_audio =
+    UPLINK_TEMPLATE("input_text.generate_audio", ",\"data\":{\"mode\":\"text\",\"text\":\"", "\"}}");
+
+/**
+ * @brief 正文写入函数：把len字节的body写到dst，返回写入的字节数
+ */
+typedef size_t (*uplink_body_writer_t)(char *dst, const void *body, size_t len);
+
+/**
+ * @brief 按JSON字符串规则转义写入
+ *
+ * 只转义引号、反斜杠和控制字符，UTF-8字节原样保留；dst至少需要 len * 6 字节
+ */
+static size_t write_escaped(char *dst, const void *body, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *src = body;
+    char *d = dst;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = src[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            *d++ = (char)c;
+            continue;
+        }
+
+        *d++ = '\\';
+        switch (c) {
+        case '"':  *d++ = '"';  break;
+        case '\\': *d++ = '\\'; break;
+        case '\n': *d++ = 'n';  break;
+        case '\r': *d++ = 'r';  break;
+        case '\t': *d++ = 't';  break;
+        default:
+            *d++ = 'u';
+            *d++ = '0';
+            *d++ = '0';
+            *d++ = hex[c >> 4];
+            *d++ = hex[c & 0xF];
+            break;
+        }
+    }
+    return (size_t)(d - dst);
+}
+
+/**
+ * @brief 原样拷贝（已经是base64的数据不需要转义）
+ */
+static size_t write_raw(char *dst, const void *body, size_t len)
+{
+    memcpy(dst, body, len);
+    return len;
+}
+
+/**
+ * @brief 把原始音频直接base64编码进正文位置
+ */
+static size_t write_base64(char *dst, const void *body, size_t len)
+{
+    return esp_coze_base64_encode(body, len, dst);
+}
+
+/**
+ * @brief 按模板把事件写入一个发送槽并交给发送任务
+ *
+ * @param kind 消息种类，决定发送通道和排队规则
+ * @param tpl 事件模板
+ * @param event_id 事件ID，NULL时自动生成
+ * @param body 正文，NULL表示没有正文
+ * @param body_len 正文长度
+ * @param body_max 正文写入后的最大长度，用于预留缓冲区
+ * @param writer 正文写入函数
+ * @param out_id 输出实际使用的事件ID，可为NULL
+ * @param out_id_size out_id缓冲区大小
+ * @return esp_err_t
+ */
+static esp_err_t send_template_event(esp_coze_tx_kind_t kind, const uplink_template_t *tpl, const char *event_id,
+                                     const void *body, size_t body_len, size_t body_max,
+                                     uplink_body_writer_t writer, char *out_id, size_t out_id_size)
+{
+    char generated_id[64];
+    if (!event_id) {
+        esp_err_t ret = esp_coze_generate_event_id(generated_id, sizeof(generated_id));
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "生成事件ID失败");
+            return ret;
+        }
+        event_id = generated_id;
+    }
+    if (out_id && out_id_size > 0) {
+        strncpy(out_id, event_id, out_id_size - 1);
+        out_id[out_id_size - 1] = '\0';
+    }
+
+    size_t id_len = strnlen(event_id, 63);
+    size_t need = sizeof(UPLINK_HEAD) - 1 + id_len * 6 + tpl->mid_len + body_max + tpl->tail_len;
+
+    esp_coze_tx_msg_t *msg = NULL;
+    esp_err_t ret = esp_coze_sender_alloc(kind, need, &msg);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    char *p = msg->buf;
+    memcpy(p, UPLINK_HEAD, sizeof(UPLINK_HEAD) - 1);
+    p += sizeof(UPLINK_HEAD) - 1;
+    p += write_escaped(p, event_id, id_len);
+    memcpy(p, tpl->mid, tpl->mid_len);
+    p += tpl->mid_len;
+    if (body_len > 0) {
+        p += writer(p, body, body_len);
+    }
+    memcpy(p, tpl->tail, tpl->tail_len);
+    p += tpl->tail_len;
+
+    msg->len = (size_t)(p - msg->buf);
+    esp_coze_sender_submit(msg);
+    return ESP_OK;
+}
 
 /**
  * @brief 发送chat.update事件
@@ -66,8 +210,8 @@ esp_err_t esp_coze_send_custom_chat_update_event(const char *event_id,
         return ESP_FAIL;
     }
 
-    // 转换为字符串
-    char *json_string = cJSON_Print(event_json);
+    // 转换为字符串（不带缩进，减少上行字节数）
+    char *json_string = cJSON_PrintUnformatted(event_json);
     cJSON_Delete(event_json);
 
     if (!json_string) {
@@ -77,17 +221,24 @@ esp_err_t esp_coze_send_custom_chat_update_event(const char *event_id,
 
     ESP_LOGI(TAG, "发送chat.update事件: %s", json_string);
 
-    // 发送WebSocket消息
-    esp_err_t ret = esp_coze_websocket_send_text(json_string);
+    // 拷贝进发送槽，由发送任务发出
+    size_t json_len = strlen(json_string);
+    esp_coze_tx_msg_t *msg = NULL;
+    esp_err_t ret = esp_coze_sender_alloc(ESP_COZE_TX_KIND_CHAT_UPDATE, json_len, &msg);
+    if (ret == ESP_OK) {
+        memcpy(msg->buf, json_string, json_len);
+        msg->len = json_len;
+        esp_coze_sender_submit(msg);
+    }
 
     free(json_string);
 
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "发送WebSocket消息失败");
+        ESP_LOGE(TAG, "chat.update事件入队失败: %s", esp_err_to_name(ret));
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "chat.update事件发送成功，ID: %s", generated_id);
+    ESP_LOGI(TAG, "chat.update事件已提交，ID: %s", generated_id);
     return ESP_OK;
 }
 
@@ -346,238 +497,409 @@ esp_err_t esp_coze_send_text_generate_audio_event(const char *event_id, const ch
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (strlen(text) > 1024) {
+    size_t text_len = strlen(text);
+    if (text_len > 1024) {
         ESP_LOGE(TAG, "合成文本长度超过限制(1024字符)");
         return ESP_ERR_INVALID_ARG;
     }
 
-    // 生成事件ID
-    char generated_id[64];
-    if (event_id) {
-        strncpy(generated_id, event_id, sizeof(generated_id) - 1);
-        generated_id[sizeof(generated_id) - 1] = '\0';
+    char sent_id[64];
+    esp_err_t ret = send_template_event(ESP_COZE_TX_KIND_GENERATE_AUDIO, &s_tpl_generate_audio, event_id, text, text_len, text_len * 6,
+                                        write_escaped, sent_id, sizeof(sent_id));
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "语音合成事件已提交，ID: %s, 文本: %s", sent_id, text);
     } else {
-        esp_err_t ret = esp_coze_generate_event_id(generated_id, sizeof(generated_id));
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "生成事件ID失败");
-            return ret;
-        }
-    }
-
-    // 创建JSON对象
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        ESP_LOGE(TAG, "创建JSON对象失败");
-        return ESP_ERR_NO_MEM;
+        ESP_LOGE(TAG, "发送语音合成事件失败: %s", esp_err_to_name(ret));
     }
 
-    // 设置基本字段
-    cJSON_AddStringToObject(json, "id", generated_id);
-    cJSON_AddStringToObject(json, "event_type", "input_text.generate_audio");
+    return ret;
+}
 
-    // 创建data对象
-    cJSON *data = cJSON_CreateObject();
-    if (!data) {
-        ESP_LOGE(TAG, "创建data对象失败");
-        cJSON_Delete(json);
-        return ESP_ERR_NO_MEM;
+/**
+ * @brief 发送conversation.chat.cancel打断事件
+ */
+esp_err_t esp_coze_send_conversation_cancel_event(const char *event_id)
+{
+    char sent_id[64];
+    esp_err_t ret = send_template_event(ESP_COZE_TX_KIND_CHAT_CANCEL, &s_tpl_chat_cancel, event_id, NULL, 0, 0, NULL, sent_id, sizeof(sent_id));
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "打断事件已提交，ID: %s", sent_id);
+    } else {
+        ESP_LOGE(TAG, "发送打断事件失败: %s", esp_err_to_name(ret));
     }
 
-    cJSON_AddStringToObject(data, "mode", "text");
-    cJSON_AddStringToObject(data, "text", text);
-    cJSON_AddItemToObject(json, "data", data);
+    return ret;
+}
 
-    // 转换为字符串
-    char *json_string = cJSON_Print(json);
-    cJSON_Delete(json);
+/**
+ * @brief 发送input_audio_buffer.append事件
+ */
+esp_err_t esp_coze_send_input_audio_buffer_append_event(const char *event_id, const uint8_t *audio_data, size_t data_len)
+{
+    if (!audio_data || data_len == 0) {
+        ESP_LOGE(TAG, "音频数据不能为空");
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    if (!json_string) {
-        ESP_LOGE(TAG, "转换JSON为字符串失败");
-        return ESP_ERR_NO_MEM;
+    // base64字符不需要转义，直接拷贝进模板的正文位置
+    esp_err_t ret = send_template_event(ESP_COZE_TX_KIND_AUDIO_APPEND, &s_tpl_audio_append, event_id, audio_data, data_len, data_len,
+                                        write_raw, NULL, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "发送音频片段失败: %s", esp_err_to_name(ret));
     }
 
-    ESP_LOGI(TAG, "发送语音合成事件: %s", json_string);
+    return ret;
+}
 
-    // 发送WebSocket消息
-    esp_err_t ret = esp_coze_websocket_send_text(json_string);
-    free(json_string);
+/**
+ * @brief 发送input_audio_buffer.append事件（直接传入原始音频）
+ */
+esp_err_t esp_coze_send_input_audio_buffer_append_raw_event(const char *event_id, const void *audio, size_t audio_len)
+{
+    if (!audio || audio_len == 0) {
+        ESP_LOGE(TAG, "音频数据不能为空");
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "语音合成事件发送成功，ID: %s", generated_id);
-    } else {
-        ESP_LOGE(TAG, "发送语音合成事件失败: %s", esp_err_to_name(ret));
+    // 编码与拼接合并：原始音频直接base64编码到发送缓冲区的正文位置
+    esp_err_t ret = send_template_event(ESP_COZE_TX_KIND_AUDIO_APPEND, &s_tpl_audio_append, event_id, audio, audio_len,
+                                        ESP_COZE_BASE64_ENCODED_LEN(audio_len), write_base64, NULL, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "发送音频片段失败: %s", esp_err_to_name(ret));
     }
 
     return ret;
 }
 
+#define AUDIO_BATCH_STEP_UP_MS    20     // 发送跟不上时每次增大的批大小
+#define AUDIO_BATCH_STEP_DOWN_MS  10     // 发送空闲时每次减小的批大小
+#define AUDIO_BATCH_ADAPT_US      500000 // 两次调整之间至少间隔的时间
+
 /**
- * @brief 发送conversation.chat.cancel打断事件
+ * @brief 麦克风音频批量发送状态
+ *
+ * 正在填充的append消息直接持有一个音频发送槽，新音频边到边base64编码进槽里，
+ * 不足3字节的尾巴留到下一次写入再凑成一组，凑够一批后补上结尾提交。
  */
-esp_err_t esp_coze_send_conversation_cancel_event(const char *event_id)
+static struct {
+    bool active;
+    char id[64 * 6];                  // 已转义的事件ID
+    size_t id_len;
+    uint32_t bytes_per_sec;
+    uint32_t batch_ms;                // 跨录音段保留，下一段从上次调整的结果开始
+    size_t batch_bytes;               // 当前一批的原始音频字节数
+    size_t slot_max_bytes;            // 一个发送槽最多能装下的原始音频字节数
+    esp_coze_tx_msg_t *msg;           // 正在填充的消息，NULL表示还没有打开
+    char *wp;                         // msg中的写入位置
+    size_t msg_audio;                 // msg中已写入的原始音频字节数
+    uint8_t carry[2];                 // 上次写入剩下的不足3字节的音频
+    size_t carry_len;
+    int64_t last_adapt_us;
+    uint64_t last_bytes_sent;
+    uint64_t last_wire_bytes;
+    uint32_t last_dropped;
+    esp_coze_audio_batch_stats_t stats;
+} s_batch;
+static portMUX_TYPE s_batch_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 批大小（毫秒）对应的原始音频字节数，取6的倍数保证样本完整且中间不出现'='填充
+ */
+static size_t audio_batch_bytes(uint32_t ms)
 {
-    // 生成事件ID
-    char generated_id[64];
-    if (event_id) {
-        strncpy(generated_id, event_id, sizeof(generated_id) - 1);
-        generated_id[sizeof(generated_id) - 1] = '\0';
-    } else {
-        esp_err_t ret = esp_coze_generate_event_id(generated_id, sizeof(generated_id));
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "生成事件ID失败");
-            return ret;
-        }
+    size_t bytes = (size_t)((uint64_t)s_batch.bytes_per_sec * ms / 1000);
+    if (bytes > s_batch.slot_max_bytes) {
+        bytes = s_batch.slot_max_bytes;
     }
+    bytes -= bytes % 6;
+    return bytes > 0 ? bytes : 6;
+}
 
-    // 创建JSON对象
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        ESP_LOGE(TAG, "创建JSON对象失败");
-        return ESP_ERR_NO_MEM;
+/**
+ * @brief 根据发送任务的吞吐和排队情况调整批大小
+ *
+ * 只看音频通道：音频通道有积压、丢过音频或发送速度低于产生速度时说明每条消息的开销太大，增大批；
+ * 音频通道空闲时减小批，降低延迟。
+ */
+static void audio_batch_adapt(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - s_batch.last_adapt_us;
+    if (elapsed < AUDIO_BATCH_ADAPT_US) {
+        return;
     }
 
-    // 设置基本字段
-    cJSON_AddStringToObject(json, "id", generated_id);
-    cJSON_AddStringToObject(json, "event_type", "conversation.chat.cancel");
+    esp_coze_sender_stats_t st;
+    if (esp_coze_sender_get_stats(&st) != ESP_OK) {
+        return;
+    }
 
-    // 转换为字符串
-    char *json_string = cJSON_Print(json);
-    cJSON_Delete(json);
+    uint64_t sent = st.bytes_sent[1] - s_batch.last_bytes_sent;
+    uint64_t produced = s_batch.stats.wire_bytes - s_batch.last_wire_bytes;
+    bool congested = st.dropped[1] != s_batch.last_dropped || st.pending[1] > 1 || sent * 10 < produced * 9;
 
-    if (!json_string) {
-        ESP_LOGE(TAG, "转换JSON为字符串失败");
-        return ESP_ERR_NO_MEM;
+    uint32_t ms = s_batch.batch_ms;
+    if (congested) {
+        ms += AUDIO_BATCH_STEP_UP_MS;
+    } else if (st.pending[1] == 0 && ms > AUDIO_BATCH_STEP_DOWN_MS) {
+        ms -= AUDIO_BATCH_STEP_DOWN_MS;
+    }
+    if (ms < ESP_COZE_AUDIO_BATCH_MIN_MS) {
+        ms = ESP_COZE_AUDIO_BATCH_MIN_MS;
+    } else if (ms > ESP_COZE_AUDIO_BATCH_MAX_MS) {
+        ms = ESP_COZE_AUDIO_BATCH_MAX_MS;
+    }
+    if (ms != s_batch.batch_ms) {
+        ESP_LOGD(TAG, "音频批大小 %u -> %u ms（排队%u，发送%u/产生%u字节）", (unsigned)s_batch.batch_ms, (unsigned)ms,
+                 (unsigned)st.pending[1], (unsigned)sent, (unsigned)produced);
     }
 
-    ESP_LOGI(TAG, "发送打断事件: %s", json_string);
+    portENTER_CRITICAL(&s_batch_lock);
+    s_batch.batch_ms = ms;
+    s_batch.stats.batch_ms = ms;
+    s_batch.stats.send_rate = (uint32_t)(sent * 1000000 / (uint64_t)elapsed);
+    portEXIT_CRITICAL(&s_batch_lock);
 
-    // 发送WebSocket消息
-    esp_err_t ret = esp_coze_websocket_send_text(json_string);
-    free(json_string);
+    s_batch.batch_bytes = audio_batch_bytes(ms);
+    s_batch.last_adapt_us = now;
+    s_batch.last_bytes_sent = st.bytes_sent[1];
+    s_batch.last_wire_bytes = s_batch.stats.wire_bytes;
+    s_batch.last_dropped = st.dropped[1];
+}
 
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "打断事件发送成功，ID: %s", generated_id);
-    } else {
-        ESP_LOGE(TAG, "发送打断事件失败: %s", esp_err_to_name(ret));
+/**
+ * @brief 打开一条append消息：分配发送槽并写好正文之前的固定部分
+ */
+static esp_err_t audio_batch_open(void)
+{
+    const uplink_template_t *tpl = &s_tpl_audio_append;
+    size_t need = sizeof(UPLINK_HEAD) - 1 + s_batch.id_len + tpl->mid_len +
+                  ESP_COZE_BASE64_ENCODED_LEN(s_batch.batch_bytes) + tpl->tail_len;
+
+    esp_err_t ret = esp_coze_sender_alloc(ESP_COZE_TX_KIND_AUDIO_APPEND, need, &s_batch.msg);
+    if (ret != ESP_OK) {
+        s_batch.msg = NULL;
+        return ret;
     }
 
-    return ret;
+    char *p = s_batch.msg->buf;
+    memcpy(p, UPLINK_HEAD, sizeof(UPLINK_HEAD) - 1);
+    p += sizeof(UPLINK_HEAD) - 1;
+    memcpy(p, s_batch.id, s_batch.id_len);
+    p += s_batch.id_len;
+    memcpy(p, tpl->mid, tpl->mid_len);
+    p += tpl->mid_len;
+
+    s_batch.wp = p;
+    s_batch.msg_audio = 0;
+    s_batch.carry_len = 0;
+    return ESP_OK;
 }
 
 /**
- * @brief 发送input_audio_buffer.append事件
+ * @brief 把音频base64编码追加到正在填充的消息，不足3字节的尾巴留到下次
  */
-esp_err_t esp_coze_send_input_audio_buffer_append_event(const char *event_id, const uint8_t *audio_data, size_t data_len)
+static void audio_batch_encode(const uint8_t *src, size_t len)
 {
-    if (!audio_data || data_len == 0) {
-        ESP_LOGE(TAG, "音频数据不能为空");
+    s_batch.msg_audio += len;
+
+    if (s_batch.carry_len > 0) {
+        uint8_t group[3];
+        memcpy(group, s_batch.carry, s_batch.carry_len);
+        size_t take = 3 - s_batch.carry_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(group + s_batch.carry_len, src, take);
+        src += take;
+        len -= take;
+        if (s_batch.carry_len + take < 3) {
+            memcpy(s_batch.carry, group, s_batch.carry_len + take);
+            s_batch.carry_len += take;
+            return;
+        }
+        s_batch.wp += esp_coze_base64_encode(group, 3, s_batch.wp);
+        s_batch.carry_len = 0;
+    }
+
+    size_t whole = len - len % 3;
+    s_batch.wp += esp_coze_base64_encode(src, whole, s_batch.wp);
+    s_batch.carry_len = len - whole;
+    memcpy(s_batch.carry, src + whole, s_batch.carry_len);
+}
+
+/**
+ * @brief 补上结尾并提交正在填充的消息
+ */
+static void audio_batch_close(void)
+{
+    esp_coze_tx_msg_t *msg = s_batch.msg;
+    const uplink_template_t *tpl = &s_tpl_audio_append;
+
+    if (s_batch.carry_len > 0) {
+        s_batch.wp += esp_coze_base64_encode(s_batch.carry, s_batch.carry_len, s_batch.wp);
+        s_batch.carry_len = 0;
+    }
+    memcpy(s_batch.wp, tpl->tail, tpl->tail_len);
+    s_batch.wp += tpl->tail_len;
+    msg->len = (size_t)(s_batch.wp - msg->buf);
+
+    portENTER_CRITICAL(&s_batch_lock);
+    s_batch.stats.messages++;
+    s_batch.stats.audio_bytes += s_batch.msg_audio;
+    s_batch.stats.wire_bytes += msg->len;
+    portEXIT_CRITICAL(&s_batch_lock);
+
+    s_batch.msg = NULL;
+    esp_coze_sender_submit(msg);
+    audio_batch_adapt();
+}
+
+/**
+ * @brief 开始批量发送一段麦克风音频
+ */
+esp_err_t esp_coze_audio_batch_begin(const char *event_id, uint32_t bytes_per_sec)
+{
+    if (bytes_per_sec == 0) {
         return ESP_ERR_INVALID_ARG;
     }
+    if (s_batch.active) {
+        esp_coze_audio_batch_end();
+    }
 
-    // 生成事件ID
     char generated_id[64];
-    if (event_id) {
-        strncpy(generated_id, event_id, sizeof(generated_id) - 1);
-        generated_id[sizeof(generated_id) - 1] = '\0';
-    } else {
+    if (!event_id) {
         esp_err_t ret = esp_coze_generate_event_id(generated_id, sizeof(generated_id));
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "生成事件ID失败");
             return ret;
         }
+        event_id = generated_id;
     }
 
-    // 创建JSON对象
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        ESP_LOGE(TAG, "创建JSON对象失败");
-        return ESP_ERR_NO_MEM;
-    }
+    // 事件ID每条消息都一样，转义一次后直接拷贝
+    s_batch.id_len = write_escaped(s_batch.id, event_id, strnlen(event_id, 63));
+    s_batch.bytes_per_sec = bytes_per_sec;
 
-    // 设置基本字段
-    cJSON_AddStringToObject(json, "id", generated_id);
-    cJSON_AddStringToObject(json, "event_type", "input_audio_buffer.append");
+    const uplink_template_t *tpl = &s_tpl_audio_append;
+    size_t overhead = sizeof(UPLINK_HEAD) - 1 + s_batch.id_len + tpl->mid_len + tpl->tail_len;
+    s_batch.slot_max_bytes = (ESP_COZE_SENDER_SLOT_SIZE - overhead) / 4 * 3;
 
-    // 创建data对象
-    cJSON *data = cJSON_CreateObject();
-    if (!data) {
-        ESP_LOGE(TAG, "创建data对象失败");
-        cJSON_Delete(json);
-        return ESP_ERR_NO_MEM;
+    if (s_batch.batch_ms == 0) {
+        s_batch.batch_ms = ESP_COZE_AUDIO_BATCH_MIN_MS;
     }
+    s_batch.batch_bytes = audio_batch_bytes(s_batch.batch_ms);
+    s_batch.msg = NULL;
+    s_batch.carry_len = 0;
 
-    cJSON_AddStringToObject(data, "delta", (const char *)audio_data);
-    cJSON_AddItemToObject(json, "data", data);
+    esp_coze_sender_stats_t st = {0};
+    esp_coze_sender_get_stats(&st);
+    s_batch.last_adapt_us = esp_timer_get_time();
+    s_batch.last_bytes_sent = st.bytes_sent[1];
+    s_batch.last_wire_bytes = s_batch.stats.wire_bytes;
+    s_batch.last_dropped = st.dropped[1];
 
-    // 转换为字符串
-    char *json_string = cJSON_Print(json);
-    cJSON_Delete(json);
+    portENTER_CRITICAL(&s_batch_lock);
+    s_batch.stats.batch_ms = s_batch.batch_ms;
+    portEXIT_CRITICAL(&s_batch_lock);
 
-    if (!json_string) {
-        ESP_LOGE(TAG, "转换JSON为字符串失败");
-        return ESP_ERR_NO_MEM;
+    s_batch.active = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief 写入一段音频，凑够一批时提交
+ */
+esp_err_t esp_coze_audio_batch_write(const void *audio, size_t len)
+{
+    if (!s_batch.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!audio || len == 0) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    // 发送WebSocket消息
-    esp_err_t ret = esp_coze_websocket_send_text(json_string);
-    free(json_string);
+    const uint8_t *src = audio;
+    while (len > 0) {
+        if (!s_batch.msg) {
+            esp_err_t ret = audio_batch_open();
+            if (ret != ESP_OK) {
+                portENTER_CRITICAL(&s_batch_lock);
+                s_batch.stats.dropped++;
+                portEXIT_CRITICAL(&s_batch_lock);
+                return ret;
+            }
+        }
 
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "发送音频片段失败: %s", esp_err_to_name(ret));
-    }
+        size_t room = s_batch.batch_bytes - s_batch.msg_audio;
+        size_t n = len < room ? len : room;
+        audio_batch_encode(src, n);
+        src += n;
+        len -= n;
 
-    return ret;
+        if (s_batch.msg_audio >= s_batch.batch_bytes) {
+            audio_batch_close();
+        }
+    }
+    return ESP_OK;
 }
 
 /**
- * @brief 发送input_audio_buffer.complete事件
+ * @brief 提交剩余音频并结束本段
  */
-esp_err_t esp_coze_send_input_audio_buffer_complete_event(const char *event_id)
+esp_err_t esp_coze_audio_batch_end(void)
 {
-    // 生成事件ID
-    char generated_id[64];
-    if (event_id) {
-        strncpy(generated_id, event_id, sizeof(generated_id) - 1);
-        generated_id[sizeof(generated_id) - 1] = '\0';
-    } else {
-        esp_err_t ret = esp_coze_generate_event_id(generated_id, sizeof(generated_id));
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "生成事件ID失败");
-            return ret;
-        }
+    if (!s_batch.active) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    // 创建JSON对象
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        ESP_LOGE(TAG, "创建JSON对象失败");
-        return ESP_ERR_NO_MEM;
+    if (s_batch.msg) {
+        if (s_batch.msg_audio > 0) {
+            audio_batch_close();
+        } else {
+            esp_coze_sender_discard(s_batch.msg);
+            s_batch.msg = NULL;
+        }
     }
+    s_batch.active = false;
 
-    // 设置基本字段
-    cJSON_AddStringToObject(json, "id", generated_id);
-    cJSON_AddStringToObject(json, "event_type", "input_audio_buffer.complete");
-
-    // 转换为字符串
-    char *json_string = cJSON_Print(json);
-    cJSON_Delete(json);
-
-    if (!json_string) {
-        ESP_LOGE(TAG, "转换JSON为字符串失败");
-        return ESP_ERR_NO_MEM;
+    esp_coze_audio_batch_stats_t st;
+    esp_coze_audio_batch_get_stats(&st);
+    if (st.messages > 0) {
+        ESP_LOGI(TAG, "音频批量发送累计: %u条消息，平均%u字节/条，音频占比%u%%，批大小%u ms，丢弃%u批",
+                 (unsigned)st.messages, (unsigned)(st.wire_bytes / st.messages),
+                 (unsigned)(st.audio_bytes * 100 / st.wire_bytes), (unsigned)st.batch_ms, (unsigned)st.dropped);
     }
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "发送音频提交事件: %s", json_string);
+/**
+ * @brief 获取麦克风音频批量发送统计
+ */
+esp_err_t esp_coze_audio_batch_get_stats(esp_coze_audio_batch_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    // 发送WebSocket消息
-    esp_err_t ret = esp_coze_websocket_send_text(json_string);
-    free(json_string);
+    portENTER_CRITICAL(&s_batch_lock);
+    *stats = s_batch.stats;
+    portEXIT_CRITICAL(&s_batch_lock);
+    return ESP_OK;
+}
 
+/**
+ * @brief 发送input_audio_buffer.complete事件
+ */
+esp_err_t esp_coze_send_input_audio_buffer_complete_event(const char *event_id)
+{
+    char sent_id[64];
+    esp_err_t ret = send_template_event(ESP_COZE_TX_KIND_AUDIO_COMPLETE, &s_tpl_audio_complete, event_id, NULL, 0, 0, NULL, sent_id, sizeof(sent_id));
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "音频提交事件发送成功，ID: %s", generated_id);
+        ESP_LOGI(TAG, "音频提交事件已提交，ID: %s", sent_id);
     } else {
         ESP_LOGE(TAG, "发送音频提交事件失败: %s", esp_err_to_name(ret));
     }
 
     return ret;
-}
\ No newline at end of file
+}
@@ -0,0 +1,455 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 10:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 10:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\src\esp_coze_json_scan.c
+ * @Description: 零分配JSON字段扫描器实现
+ *
+ */
+#include "esp_coze_json_scan.h"
+#include <string.h>
+
+/**
+ * @brief 跳过空白字符
+ */
+static inline const char *scan_skip_ws(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief 跳过字符串内容，p指向开头引号之后
+ *
+ * 用memchr直接查找结尾引号，音频delta中几KB的base64正文不需要逐字节判断。
+ *
+ * @param p 字符串内容起始位置
+ * @param end 数据结尾
+ * @param escaped 输出：字符串中是否含有转义符，可为NULL
+ * @return 结尾引号的位置，未找到返回NULL
+ */
+static const char *scan_string(const char *p, const char *end, bool *escaped)
+{
+    const char *q = p;
+
+    for (;;) {
+        q = (const char *)memchr(q, '"', (size_t)(end - q));
+        if (!q) {
+            return NULL;
+        }
+
+        // 引号前连续反斜杠为奇数个时是转义的引号，继续向后找
+        const char *b = q;
+        while (b > p && b[-1] == '\\') {
+            b--;
+        }
+        if (((q - b) & 1) == 0) {
+            break;
+        }
+        q++;
+    }
+
+    if (escaped) {
+        *escaped = memchr(p, '\\', (size_t)(q - p)) != NULL;
+    }
+    return q;
+}
+
+/**
+ * @brief 跳过一个值，p指向值的第一个字符
+ *
+ * @param p 值起始位置
+ * @param end 数据结尾
+ * @param span 输出值区间
+ * @return 值之后的位置，格式错误返回NULL
+ */
+static const char *scan_value(const char *p, const char *end, esp_coze_json_span_t *span)
+{
+    span->escaped = false;
+
+    if (*p == '"') {
+        const char *q = scan_string(p + 1, end, &span->escaped);
+        if (!q) {
+            return NULL;
+        }
+        span->ptr = p + 1;
+        span->len = (size_t)(q - p - 1);
+        span->type = ESP_COZE_JSON_STRING;
+        return q + 1;
+    }
+
+    if (*p == '{' || *p == '[') {
+        // 嵌套容器只统计括号深度，字符串整体跳过
+        const char *q = p;
+        int depth = 0;
+        while (q < end) {
+            char ch = *q++;
+            if (ch == '"') {
+                q = scan_string(q, end, NULL);
+                if (!q) {
+                    return NULL;
+                }
+                q++;
+            } else if (ch == '{' || ch == '[') {
+                depth++;
+            } else if (ch == '}' || ch == ']') {
+                if (--depth == 0) {
+                    span->ptr = p;
+                    span->len = (size_t)(q - p);
+                    span->type = (*p == '{') ? ESP_COZE_JSON_OBJECT : ESP_COZE_JSON_ARRAY;
+                    return q;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    // 数字、true/false/null：到分隔符为止
+    const char *q = p;
+    while (q < end && *q != ',' && *q != '}' && *q != ']' &&
+            *q != ' ' && *q != '\t' && *q != '\n' && *q != '\r') {
+        q++;
+    }
+    if (q == p) {
+        return NULL;
+    }
+    span->ptr = p;
+    span->len = (size_t)(q - p);
+    span->type = ESP_COZE_JSON_PRIMITIVE;
+    return q;
+}
+
+/**
+ * @brief 单遍扫描一个JSON对象的顶层字段
+ */
+esp_err_t esp_coze_json_scan_object(const char *json, size_t len, const char *const *keys, size_t key_count,
+                                    esp_coze_json_span_t *values)
+{
+    if (!json || (key_count > 0 && (!keys || !values))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < key_count; i++) {
+        memset(&values[i], 0, sizeof(values[i]));
+    }
+
+    const char *end = json + len;
+    const char *p = scan_skip_ws(json, end);
+    if (p == end || *p != '{') {
+        return ESP_FAIL;
+    }
+    p = scan_skip_ws(p + 1, end);
+    if (p < end && *p == '}') {
+        return ESP_OK;
+    }
+
+    size_t remaining = key_count;
+    while (p < end) {
+        // 字段名
+        if (*p != '"') {
+            return ESP_FAIL;
+        }
+        bool key_escaped = false;
+        const char *key_end = scan_string(p + 1, end, &key_escaped);
+        if (!key_end) {
+            return ESP_FAIL;
+        }
+        const char *key = p + 1;
+        size_t key_len = (size_t)(key_end - key);
+
+        p = scan_skip_ws(key_end + 1, end);
+        if (p == end || *p != ':') {
+            return ESP_FAIL;
+        }
+        p = scan_skip_ws(p + 1, end);
+        if (p == end) {
+            return ESP_FAIL;
+        }
+
+        // 字段值
+        esp_coze_json_span_t span;
+        p = scan_value(p, end, &span);
+        if (!p) {
+            return ESP_FAIL;
+        }
+
+        if (!key_escaped) {
+            for (size_t i = 0; i < key_count; i++) {
+                if (values[i].type == ESP_COZE_JSON_NONE && strlen(keys[i]) == key_len &&
+                        memcmp(keys[i], key, key_len) == 0) {
+                    values[i] = span;
+                    remaining--;
+                    break;
+                }
+            }
+            if (key_count > 0 && remaining == 0) {
+                // 关心的字段都已找到，剩余部分不再扫描
+                return ESP_OK;
+            }
+        }
+
+        p = scan_skip_ws(p, end);
+        if (p == end) {
+            return ESP_FAIL;
+        }
+        if (*p == '}') {
+            return ESP_OK;
+        }
+        if (*p != ',') {
+            return ESP_FAIL;
+        }
+        p = scan_skip_ws(p + 1, end);
+    }
+
+    return ESP_FAIL;
+}
+
+/**
+ * @brief 判断字符串值是否等于给定字符串
+ */
+bool esp_coze_json_span_equals(const esp_coze_json_span_t *span, const char *str)
+{
+    if (!span || !str || span->type != ESP_COZE_JSON_STRING || span->escaped) {
+        return false;
+    }
+
+    size_t len = strlen(str);
+    return span->len == len && memcmp(span->ptr, str, len) == 0;
+}
+
+/**
+ * @brief 解析4位十六进制数，失败返回-1
+ */
+static int scan_hex4(const char *p)
+{
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') {
+            v |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            v |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            v |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return v;
+}
+
+/**
+ * @brief 把码点编码为UTF-8，返回字节数
+ */
+static size_t scan_utf8_encode(uint32_t cp, char *out)
+{
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/**
+ * @brief 截断后去掉末尾不完整的UTF-8字符，返回新长度
+ */
+static size_t scan_utf8_trim(const char *buf, size_t len)
+{
+    // 从末尾找到最后一个非后续字节（最多回看3个字节）
+    size_t i = len;
+    while (i > 0 && len - i < 3 && ((uint8_t)buf[i - 1] & 0xC0) == 0x80) {
+        i--;
+    }
+    if (i == 0) {
+        return len;
+    }
+
+    uint8_t lead = (uint8_t)buf[i - 1];
+    size_t need = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : (lead >= 0xC0) ? 2 : 1;
+    return (len - (i - 1) < need) ? i - 1 : len;
+}
+
+/**
+ * @brief 把字符串值反转义后拷贝到缓冲区
+ */
+esp_err_t esp_coze_json_span_to_str(const esp_coze_json_span_t *span, char *buf, size_t size)
+{
+    if (!span || !buf || size == 0 || span->type != ESP_COZE_JSON_STRING) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const char *p = span->ptr;
+    const char *end = p + span->len;
+    size_t cap = size - 1;
+    size_t n = 0;
+
+    // 没有转义时整段拷贝
+    if (!span->escaped) {
+        if (span->len <= cap) {
+            memcpy(buf, p, span->len);
+            buf[span->len] = '\0';
+            return ESP_OK;
+        }
+        memcpy(buf, p, cap);
+        buf[scan_utf8_trim(buf, cap)] = '\0';
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    while (p < end) {
+        char tmp[4];
+        size_t tmp_len;
+
+        if (*p != '\\') {
+            // 普通字节批量拷贝到下一个转义符为止
+            const char *q = memchr(p, '\\', (size_t)(end - p));
+            size_t run = (size_t)((q ? q : end) - p);
+            if (run > cap - n) {
+                memcpy(buf + n, p, cap - n);
+                buf[scan_utf8_trim(buf, cap)] = '\0';
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(buf + n, p, run);
+            n += run;
+            p += run;
+            continue;
+        }
+
+        if (end - p < 2) {
+            buf[n] = '\0';
+            return ESP_FAIL;
+        }
+        switch (p[1]) {
+        case '"':  tmp[0] = '"';  break;
+        case '\\': tmp[0] = '\\'; break;
+        case '/':  tmp[0] = '/';  break;
+        case 'b':  tmp[0] = '\b'; break;
+        case 'f':  tmp[0] = '\f'; break;
+        case 'n':  tmp[0] = '\n'; break;
+        case 'r':  tmp[0] = '\r'; break;
+        case 't':  tmp[0] = '\t'; break;
+        case 'u':  break;
+        default:
+            buf[n] = '\0';
+            return ESP_FAIL;
+        }
+
+        if (p[1] != 'u') {
+            tmp_len = 1;
+            p += 2;
+        } else {
+            int cp = (end - p >= 6) ? scan_hex4(p + 2) : -1;
+            p += 6;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                // 代理对：高位后面必须紧跟\uDC00-\uDFFF的低位
+                int lo = (end - p >= 6 && p[0] == '\\' && p[1] == 'u') ? scan_hex4(p + 2) : -1;
+                if (lo < 0xDC00 || lo > 0xDFFF) {
+                    buf[n] = '\0';
+                    return ESP_FAIL;
+                }
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                p += 6;
+            } else if (cp < 0 || (cp >= 0xDC00 && cp <= 0xDFFF)) {
+                buf[n] = '\0';
+                return ESP_FAIL;
+            }
+            tmp_len = scan_utf8_encode((uint32_t)cp, tmp);
+        }
+
+        // 转义得到的字符整体放不下时在它之前截断
+        if (tmp_len > cap - n) {
+            buf[scan_utf8_trim(buf, n)] = '\0';
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(buf + n, tmp, tmp_len);
+        n += tmp_len;
+    }
+
+    buf[n] = '\0';
+    return ESP_OK;
+}
+
+/**
+ * @brief 把数字值转换为整数
+ */
+esp_err_t esp_coze_json_span_to_int(const esp_coze_json_span_t *span, int64_t *out)
+{
+    if (!span || !out || span->type != ESP_COZE_JSON_PRIMITIVE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const char *p = span->ptr;
+    const char *end = p + span->len;
+    bool neg = false;
+    if (p < end && *p == '-') {
+        neg = true;
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 按负数累加，INT64_MIN也能表示
+    int64_t v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        int d = *p - '0';
+        if (v < (INT64_MIN + d) / 10) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        v = v * 10 - d;
+    }
+
+    // 小数和指数部分直接丢弃，但必须是合法的数字字符
+    for (; p < end; p++) {
+        if (!((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    if (!neg) {
+        if (v == INT64_MIN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        v = -v;
+    }
+    *out = v;
+    return ESP_OK;
+}
+
+/**
+ * @brief 把true/false转换为布尔值
+ */
+esp_err_t esp_coze_json_span_to_bool(const esp_coze_json_span_t *span, bool *out)
+{
+    if (!span || !out || span->type != ESP_COZE_JSON_PRIMITIVE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (span->len == 4 && memcmp(span->ptr, "true", 4) == 0) {
+        *out = true;
+        return ESP_OK;
+    }
+    if (span->len == 5 && memcmp(span->ptr, "false", 5) == 0) {
+        *out = false;
+        return ESP_OK;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
@@ -10,11 +10,147 @@
 #include "esp_coze_ring_buffer.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "freertos/task.h"
 #include <string.h>
 #include <stdlib.h>
 
 static const char *TAG = "RING_BUFFER";
 
+// 消息模式下每条记录前的长度头大小，最高位为 msg_tag 的标记（消息长度不超过缓冲区容量，用不到这一位）
+#define RB_MSG_HDR_SIZE sizeof(uint32_t)
+#define RB_MSG_TAGGED   0x80000000u
+
+// 位置计数为31位自由递增计数，read_pos 的最高位用作“最老消息正被消费者原地读取”标记
+#define RB_POS_MASK     0x7FFFFFFFu
+#define RB_POS_CLAIMED  0x80000000u
+
+/**
+ * @brief 位置计数前进n字节
+ */
+static inline uint32_t rb_pos_add(uint32_t pos, size_t n)
+{
+    return (pos + (uint32_t)n) & RB_POS_MASK;
+}
+
+/**
+ * @brief 计算两个位置计数之间的字节数（自动忽略占用标记）
+ */
+static inline uint32_t rb_pos_diff(uint32_t to, uint32_t from)
+{
+    return (to - from) & RB_POS_MASK;
+}
+
+/**
+ * @brief 原子读取位置计数
+ */
+static inline uint32_t rb_load(const volatile uint32_t *pos)
+{
+    return __atomic_load_n(pos, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief 尝试把读取计数从expected推进到desired（消费者提交或生产者覆盖）
+ *
+ * @return 成功返回true；失败返回false并把当前值写回expected
+ */
+static inline bool rb_cas_read_pos(esp_coze_ring_buffer_t *rb, uint32_t *expected, uint32_t desired)
+{
+    return __atomic_compare_exchange_n(&rb->read_pos, expected, desired, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief 把数据拷贝进环形缓冲区，回绕时分两段memcpy
+ */
+static inline void rb_copy_in(esp_coze_ring_buffer_t *rb, uint32_t pos, const uint8_t *src, size_t len)
+{
+    size_t idx = pos & rb->mask;
+    size_t first = rb->size - idx;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(rb->buffer + idx, src, first);
+    if (len > first) {
+        memcpy(rb->buffer, src + first, len - first);
+    }
+}
+
+/**
+ * @brief 从环形缓冲区拷贝数据出来，回绕时分两段memcpy
+ */
+static inline void rb_copy_out(const esp_coze_ring_buffer_t *rb, uint32_t pos, uint8_t *dst, size_t len)
+{
+    size_t idx = pos & rb->mask;
+    size_t first = rb->size - idx;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(dst, rb->buffer + idx, first);
+    if (len > first) {
+        memcpy(dst + first, rb->buffer, len - first);
+    }
+}
+
+/**
+ * @brief 把JSON扫描状态重置到指定读取位置
+ */
+static inline void rb_scan_reset(esp_coze_ring_buffer_t *rb, uint32_t pos)
+{
+    rb->scan_start = pos;
+    rb->scan_pos = pos;
+    rb->scan_depth = 0;
+    rb->scan_found_start = false;
+    rb->scan_in_string = false;
+    rb->scan_escape = false;
+}
+
+/**
+ * @brief 消费者释放空间后唤醒正在等待的生产者（仅阻塞策略下生产者才会等待）
+ */
+static inline void rb_notify_space(esp_coze_ring_buffer_t *rb)
+{
+    // 与生产者“先置等待标记再检查空间”配对，保证不会漏掉唤醒
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&rb->space_waiting, __ATOMIC_RELAXED)) {
+        xSemaphoreGive(rb->space_sem);
+    }
+}
+
+/**
+ * @brief 阻塞策略下等待消费者腾出空间，直到能容纳到end位置为止（仅生产者调用）
+ *
+ * @param rb 环形缓冲区指针
+ * @param end 需要容纳到的位置计数
+ * @return ESP_OK 空间足够；ESP_ERR_TIMEOUT 等待超时
+ */
+static esp_err_t rb_wait_space(esp_coze_ring_buffer_t *rb, uint32_t end)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(rb->block_timeout_ms);
+    esp_err_t ret = ESP_OK;
+
+    __atomic_add_fetch(&rb->blocked, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&rb->space_waiting, true, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // 占用标记不影响已用空间的计算，被peek的消息提交后同样会唤醒
+    while (rb_pos_diff(end, rb_load(&rb->read_pos)) > rb->size) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout || xSemaphoreTake(rb->space_sem, timeout - elapsed) != pdTRUE) {
+            ret = ESP_ERR_TIMEOUT;
+            break;
+        }
+    }
+
+    __atomic_store_n(&rb->space_waiting, false, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&rb->blocked_ms, (uint32_t)pdTICKS_TO_MS(xTaskGetTickCount() - start), __ATOMIC_RELAXED);
+    if (ret != ESP_OK) {
+        __atomic_add_fetch(&rb->block_timeouts, 1, __ATOMIC_RELAXED);
+        ESP_LOGW(TAG, "等待缓冲区空间超时(%d ms)，丢弃新数据", (int)rb->block_timeout_ms);
+    }
+    return ret;
+}
+
 /**
  * @brief 初始化环形缓冲区
  */
@@ -24,6 +160,12 @@ esp_err_t esp_coze_ring_buffer_init(esp_coze_ring_buffer_t *rb, size_t size)
         return ESP_ERR_INVALID_ARG;
     }
 
+    // 下标用掩码计算，要求大小为2的幂；位置计数为31位，容量不能超过1GB
+    if ((size & (size - 1)) != 0 || size > (RB_POS_MASK >> 1) + 1) {
+        ESP_LOGE(TAG, "缓冲区大小必须为2的幂: %d", (int)size);
+        return ESP_ERR_INVALID_ARG;
+    }
+
     // 优先使用PSRAM分配缓冲区
     rb->buffer = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
     if (!rb->buffer) {
@@ -42,22 +184,44 @@ esp_err_t esp_coze_ring_buffer_init(esp_coze_ring_buffer_t *rb, size_t size)
              (esp_ptr_external_ram(rb->buffer)) ? "PSRAM" : "内部RAM");
 
     rb->size = size;
+    rb->mask = size - 1;
     rb->write_pos = 0;
     rb->read_pos = 0;
     rb->total_overwrites = 0;
     rb->total_overwritten_bytes = 0;
-
-    rb->mutex = xSemaphoreCreateMutex();
-    if (!rb->mutex) {
-        free(rb->buffer);
-        ESP_LOGE(TAG, "创建互斥锁失败");
-        return ESP_ERR_NO_MEM;
-    }
+    rb_scan_reset(rb, 0);
+    rb->msg_active = false;
+    rb->msg_drop_reason = ESP_OK;
+    rb->msg_len = 0;
+    rb->msg_tagged = false;
+    rb->msg_tagged_lost = 0;
+    rb->msg_committed = 0;
+    rb->msg_dropped = 0;
+    rb->msg_overwritten = 0;
+    rb->msg_truncated = 0;
+    rb->msg_oversize = 0;
+    rb->msg_max_len = 0;
+    memset((void *)rb->msg_size_hist, 0, sizeof(rb->msg_size_hist));
+    rb->policy = ESP_COZE_RB_POLICY_OVERWRITE_OLDEST;
+    rb->block_timeout_ms = ESP_COZE_RB_DEFAULT_BLOCK_TIMEOUT_MS;
+    rb->space_waiting = false;
+    rb->blocked = 0;
+    rb->block_timeouts = 0;
+    rb->blocked_ms = 0;
 
     rb->data_sem = xSemaphoreCreateBinary();
-    if (!rb->data_sem) {
-        vSemaphoreDelete(rb->mutex);
+    rb->space_sem = xSemaphoreCreateBinary();
+    if (!rb->data_sem || !rb->space_sem) {
+        if (rb->data_sem) {
+            vSemaphoreDelete(rb->data_sem);
+            rb->data_sem = NULL;
+        }
+        if (rb->space_sem) {
+            vSemaphoreDelete(rb->space_sem);
+            rb->space_sem = NULL;
+        }
         free(rb->buffer);
+        rb->buffer = NULL;
         ESP_LOGE(TAG, "创建信号量失败");
         return ESP_ERR_NO_MEM;
     }
@@ -67,43 +231,56 @@ esp_err_t esp_coze_ring_buffer_init(esp_coze_ring_buffer_t *rb, size_t size)
 }
 
 
+/**
+ * @brief 设置缓冲区满时的背压策略
+ */
+esp_err_t esp_coze_ring_buffer_set_policy(esp_coze_ring_buffer_t *rb, esp_coze_ring_buffer_policy_t policy,
+                                          uint32_t block_timeout_ms)
+{
+    if (!rb || policy > ESP_COZE_RB_POLICY_BLOCK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rb->policy = policy;
+    rb->block_timeout_ms = block_timeout_ms ? block_timeout_ms : ESP_COZE_RB_DEFAULT_BLOCK_TIMEOUT_MS;
+    ESP_LOGI(TAG, "背压策略: %d, 阻塞超时: %d ms", (int)policy, (int)rb->block_timeout_ms);
+    return ESP_OK;
+}
+
 /**
  * @brief 从环形缓冲区读取字节数据
  */
 esp_err_t esp_coze_ring_buffer_read(esp_coze_ring_buffer_t *rb, uint8_t *out, size_t max_len, size_t *out_len, uint32_t timeout_ms)
 {
-    if (!rb || !out || max_len == 0) {
+    if (!rb || !rb->buffer || !out || max_len == 0) {
         return ESP_ERR_INVALID_ARG;
     }
 
     if (out_len) *out_len = 0;
 
     // 如果无数据且允许等待，则等待一次信号
-    if (rb->read_pos == rb->write_pos && timeout_ms > 0) {
+    if (rb_load(&rb->read_pos) == rb_load(&rb->write_pos) && timeout_ms > 0) {
         if (xSemaphoreTake(rb->data_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
             return ESP_ERR_TIMEOUT;
         }
     }
 
-    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(50)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
-    }
-
-    size_t available;
-    if (rb->write_pos >= rb->read_pos) {
-        available = rb->write_pos - rb->read_pos;
-    } else {
-        available = rb->size - rb->read_pos + rb->write_pos;
-    }
+    size_t to_read;
+    uint32_t read_pos = rb_load(&rb->read_pos);
+    do {
+        uint32_t available = rb_pos_diff(rb_load(&rb->write_pos), read_pos);
+        to_read = (available < max_len) ? available : max_len;
+        if (to_read == 0) {
+            break;
+        }
+        rb_copy_out(rb, read_pos, out, to_read);
+        // 提交读取位置；CAS失败说明拷贝期间生产者覆盖了这段数据，按新的读取位置重读
+    } while (!rb_cas_read_pos(rb, &read_pos, rb_pos_add(read_pos, to_read)));
 
-    size_t to_read = (available < max_len) ? available : max_len;
-    for (size_t i = 0; i < to_read; ++i) {
-        out[i] = rb->buffer[rb->read_pos];
-        rb->read_pos = (rb->read_pos + 1) % rb->size;
+    if (to_read > 0) {
+        rb_notify_space(rb);
     }
 
-    xSemaphoreGive(rb->mutex);
-
     if (out_len) *out_len = to_read;
     return (to_read > 0) ? ESP_OK : ESP_ERR_TIMEOUT;
 }
@@ -113,161 +290,657 @@ esp_err_t esp_coze_ring_buffer_read(esp_coze_ring_buffer_t *rb, uint8_t *out, si
  */
 esp_err_t esp_coze_ring_buffer_write(esp_coze_ring_buffer_t *rb, const uint8_t *data, size_t len)
 {
-    if (!rb || !data || len == 0) {
+    if (!rb || !rb->buffer || !data || len == 0) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGW(TAG, "获取互斥锁超时");
-        return ESP_ERR_TIMEOUT;
+    size_t overwritten_bytes = 0;
+
+    // 丢弃/阻塞策略下不覆盖任何未读数据，空间不足时整次写入被拒绝
+    if (rb->policy != ESP_COZE_RB_POLICY_OVERWRITE_OLDEST) {
+        if (len > rb->size) {
+            __atomic_add_fetch(&rb->msg_dropped, 1, __ATOMIC_RELAXED);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint32_t end = rb_pos_add(rb->write_pos, len);
+        if (rb_pos_diff(end, rb_load(&rb->read_pos)) > rb->size) {
+            esp_err_t ret = ESP_ERR_NO_MEM;
+            if (rb->policy == ESP_COZE_RB_POLICY_BLOCK) {
+                ret = rb_wait_space(rb, end);
+            }
+            if (ret != ESP_OK) {
+                __atomic_add_fetch(&rb->msg_dropped, 1, __ATOMIC_RELAXED);
+                return ret;
+            }
+        }
     }
 
-    // 真正的环形缓冲区：写入数据，必要时覆盖旧数据
-    size_t overwritten_bytes = 0;
-    
-    for (size_t i = 0; i < len; i++) {
-        // 写入数据
-        rb->buffer[rb->write_pos] = data[i];
-        
-        // 移动写指针
-        size_t old_write_pos = rb->write_pos;
-        rb->write_pos = (rb->write_pos + 1) % rb->size;
-        
-        // 检查是否覆盖了未读数据
-        if (rb->write_pos == rb->read_pos) {
-            // 写指针追上了读指针，强制移动读指针（覆盖最老的数据）
-            rb->read_pos = (rb->read_pos + 1) % rb->size;
-            overwritten_bytes++;
-            rb->total_overwritten_bytes++;
-        }
-    }
-    
+    // 单次写入超过整个缓冲区时，只有最后size字节能留下来
+    if (len > rb->size) {
+        overwritten_bytes += len - rb->size;
+        data += len - rb->size;
+        len = rb->size;
+    }
+
+    // 写入计数只有生产者自己修改，直接读取即可
+    uint32_t write_pos = rb->write_pos;
+    uint32_t new_write_pos = rb_pos_add(write_pos, len);
+
+    // 空间不足时把读取位置推到 new_write_pos - size，覆盖最老的数据
+    uint32_t read_pos = rb_load(&rb->read_pos);
+    while (rb_pos_diff(new_write_pos, read_pos) > rb->size) {
+        uint32_t new_read_pos = (new_write_pos - (uint32_t)rb->size) & RB_POS_MASK;
+        if (rb_cas_read_pos(rb, &read_pos, new_read_pos)) {
+            overwritten_bytes += rb_pos_diff(new_read_pos, read_pos);
+            break;
+        }
+        // 消费者刚好提交了读取位置，用新值重新判断
+    }
+
+    // 两段memcpy写入数据，再发布写入位置
+    rb_copy_in(rb, write_pos, data, len);
+    __atomic_store_n(&rb->write_pos, new_write_pos, __ATOMIC_RELEASE);
+
     // 如果有数据被覆盖，记录警告（但不阻止写入）
     if (overwritten_bytes > 0) {
-        rb->total_overwrites++;
-        ESP_LOGW(TAG, "环形缓冲区覆盖了 %d 字节旧数据，总覆盖次数: %d，总覆盖字节: %d", 
-                 (int)overwritten_bytes, 
-                 (int)rb->total_overwrites,
-                 (int)rb->total_overwritten_bytes);
+        uint32_t overwrites = __atomic_add_fetch(&rb->total_overwrites, 1, __ATOMIC_RELAXED);
+        uint32_t total_bytes = __atomic_add_fetch(&rb->total_overwritten_bytes,
+                                                  (uint32_t)overwritten_bytes, __ATOMIC_RELAXED);
+        ESP_LOGW(TAG, "环形缓冲区覆盖了 %d 字节旧数据，总覆盖次数: %d，总覆盖字节: %d",
+                 (int)overwritten_bytes, (int)overwrites, (int)total_bytes);
     }
 
-    xSemaphoreGive(rb->mutex);
-
     // 通知有数据可读
     xSemaphoreGive(rb->data_sem);
 
-    ESP_LOGD(TAG, "写入数据: %d bytes, 写入位置: %d (环形缓冲区永远成功)", (int)len, (int)rb->write_pos);
+    ESP_LOGD(TAG, "写入数据: %d bytes, 写入位置: %d (环形缓冲区永远成功)", (int)len, (int)(new_write_pos & rb->mask));
     return ESP_OK;
 }
 
 
 
+/**
+ * @brief 在一段连续内存上推进JSON扫描状态机
+ *
+ * @param rb 环形缓冲区指针（提供扫描状态）
+ * @param p 待扫描数据
+ * @param len 待扫描长度
+ * @param complete 输出：是否在本段内找到对象结尾
+ * @return size_t 本次消耗的字节数（找到结尾时包含结尾的'}'）
+ */
+static size_t rb_scan_span(esp_coze_ring_buffer_t *rb, const uint8_t *p, size_t len, bool *complete)
+{
+    const uint8_t *cur = p;
+    const uint8_t *end = p + len;
+
+    *complete = false;
+    while (cur < end) {
+        if (rb->scan_escape) {
+            rb->scan_escape = false;
+            cur++;
+            continue;
+        }
+
+        if (rb->scan_in_string) {
+            // 字符串内部（音频delta的base64正文）只关心引号和转义符，快速跳过其余字节
+            while (cur < end && *cur != '"' && *cur != '\\') {
+                cur++;
+            }
+            if (cur == end) {
+                break;
+            }
+        }
+
+        uint8_t ch = *cur++;
+
+        if (ch == '\\') {
+            rb->scan_escape = true;
+            continue;
+        }
+
+        if (ch == '"') {
+            rb->scan_in_string = !rb->scan_in_string;
+            continue;
+        }
+
+        if (!rb->scan_in_string) {
+            if (ch == '{') {
+                rb->scan_depth++;
+                rb->scan_found_start = true;
+            } else if (ch == '}' && rb->scan_found_start) {
+                rb->scan_depth--;
+                if (rb->scan_depth == 0) {
+                    // 找到完整的JSON对象
+                    *complete = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return (size_t)(cur - p);
+}
+
 /**
  * @brief 从环形缓冲区读取一个完整的JSON对象
  */
 esp_err_t esp_coze_ring_buffer_read_json_object(esp_coze_ring_buffer_t *rb, uint8_t *data, size_t max_len, size_t *actual_len)
 {
-    if (!rb || !data || !actual_len || max_len == 0) {
+    if (!rb || !rb->buffer || !data || !actual_len || max_len == 0) {
         return ESP_ERR_INVALID_ARG;
     }
 
     *actual_len = 0;
 
-    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGW(TAG, "获取互斥锁超时");
-        return ESP_ERR_TIMEOUT;
-    }
+    for (;;) {
+        // 读取位置变化（被生产者覆盖或被字节读取接口消费）时，从新位置重新同步
+        uint32_t read_pos = rb_load(&rb->read_pos);
+        if (read_pos != rb->scan_start) {
+            rb_scan_reset(rb, read_pos);
+        }
+
+        uint32_t write_pos = rb_load(&rb->write_pos);
+        bool complete = false;
+
+        // 从上次停下的位置继续扫描，每个字节只检查一次；
+        // 扫描不受输出缓冲区大小限制，超长对象也要找到结尾才能整体跳过，否则会永远卡在这里
+        while (!complete && rb->scan_pos != write_pos) {
+            // 本轮可扫描的连续区间：不越过写入位置和缓冲区末尾
+            size_t idx = rb->scan_pos & rb->mask;
+            size_t span = rb_pos_diff(write_pos, rb->scan_pos);
+            if (span > rb->size - idx) {
+                span = rb->size - idx;
+            }
 
-    size_t temp_read_pos = rb->read_pos;
-    size_t json_len = 0;
-    int brace_count = 0;
-    bool found_start = false;
-    bool in_string = false;
-    bool escape_next = false;
+            rb->scan_pos = rb_pos_add(rb->scan_pos, rb_scan_span(rb, rb->buffer + idx, span, &complete));
+        }
 
-    // 查找完整的JSON对象
-    while (temp_read_pos != rb->write_pos && json_len < max_len - 1) {
-        uint8_t ch = rb->buffer[temp_read_pos];
-        temp_read_pos = (temp_read_pos + 1) % rb->size;
-        json_len++;
+        if (!complete) {
+            // 没有找到完整的JSON对象，保留扫描状态等待更多数据
+            ESP_LOGD(TAG, "未找到完整JSON对象，found_start=%d, brace_count=%d, available=%d",
+                     rb->scan_found_start, rb->scan_depth, (int)rb_pos_diff(write_pos, read_pos));
+            return ESP_ERR_NOT_FOUND;
+        }
 
-        if (escape_next) {
-            escape_next = false;
+        size_t json_len = rb_pos_diff(rb->scan_pos, rb->scan_start);
+        if (json_len + 1 > max_len) {
+            // 输出缓冲区放不下，跳过该对象避免阻塞后续数据
+            if (rb_cas_read_pos(rb, &read_pos, rb->scan_pos)) {
+                rb_scan_reset(rb, rb->scan_pos);
+                rb_notify_space(rb);
+                *actual_len = json_len;
+                ESP_LOGW(TAG, "JSON对象长度 %d 超过输出缓冲区 %d，已跳过", (int)json_len, (int)max_len);
+                return ESP_ERR_INVALID_SIZE;
+            }
             continue;
         }
 
-        if (ch == '\\') {
-            escape_next = true;
-            continue;
+        // 读取完整的JSON对象并提交读取位置
+        rb_copy_out(rb, read_pos, data, json_len);
+        if (rb_cas_read_pos(rb, &read_pos, rb->scan_pos)) {
+            rb_scan_reset(rb, rb->scan_pos);
+            rb_notify_space(rb);
+            data[json_len] = '\0';
+            *actual_len = json_len;
+            ESP_LOGD(TAG, "读取JSON对象: %d bytes", (int)json_len);
+            return ESP_OK;
         }
 
-        if (ch == '"' && !escape_next) {
-            in_string = !in_string;
-            continue;
+        // 扫描或拷贝期间数据被覆盖，下一轮从新的读取位置重新同步
+    }
+}
+
+/**
+ * @brief 读取pos处的消息长度头
+ *
+ * @param tagged 输出消息是否带标记，可为NULL
+ * @return 消息长度
+ */
+static inline uint32_t rb_msg_read_hdr(const esp_coze_ring_buffer_t *rb, uint32_t pos, bool *tagged)
+{
+    uint32_t hdr;
+    rb_copy_out(rb, pos, (uint8_t *)&hdr, RB_MSG_HDR_SIZE);
+    if (tagged) {
+        *tagged = (hdr & RB_MSG_TAGGED) != 0;
+    }
+    return hdr & ~RB_MSG_TAGGED;
+}
+
+/**
+ * @brief 一条消息丢失，带标记时同时计入 tagged_lost（仅生产者调用）
+ */
+static inline void rb_msg_count_lost(esp_coze_ring_buffer_t *rb, volatile uint32_t *counter, bool tagged)
+{
+    __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+    if (tagged) {
+        __atomic_add_fetch(&rb->msg_tagged_lost, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 确保缓冲区能容纳到end位置为止的数据，不够时按背压策略处理
+ *
+ * 调用前已保证当前消息不超过缓冲区容量。覆盖策略下按整条消息覆盖最老的已完成消息，
+ * 只要最老的消息没有被消费者占用，总能腾出空间；丢弃策略直接失败；阻塞策略等待消费者释放空间。
+ *
+ * @param rb 环形缓冲区指针
+ * @param end 需要容纳到的位置计数（当前未完成消息的末尾）
+ * @return ESP_OK 空间足够；ESP_ERR_NO_MEM 空间不足且不能覆盖；ESP_ERR_TIMEOUT 阻塞等待超时
+ */
+static esp_err_t rb_msg_reserve(esp_coze_ring_buffer_t *rb, uint32_t end)
+{
+    uint32_t read_pos = rb_load(&rb->read_pos);
+
+    if (rb_pos_diff(end, read_pos) <= rb->size) {
+        return ESP_OK;
+    }
+
+    if (rb->policy == ESP_COZE_RB_POLICY_DROP_NEWEST) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (rb->policy == ESP_COZE_RB_POLICY_BLOCK) {
+        return rb_wait_space(rb, end);
+    }
+
+    while (rb_pos_diff(end, read_pos) > rb->size) {
+        // 消费者正在原地解析最老的消息，不能覆盖
+        if (read_pos & RB_POS_CLAIMED) {
+            return ESP_ERR_NO_MEM;
         }
 
-        if (!in_string) {
-            if (ch == '{') {
-                brace_count++;
-                found_start = true;
-            } else if (ch == '}' && found_start) {
-                brace_count--;
-                if (brace_count == 0) {
-                    // 找到完整的JSON对象
-                    break;
+        // 已完成的消息位于 [read_pos, write_pos)
+        if (read_pos == rb->write_pos) {
+            return ESP_ERR_NO_MEM;
+        }
+
+        bool tagged;
+        uint32_t len = rb_msg_read_hdr(rb, read_pos, &tagged);
+        uint32_t next = rb_pos_add(read_pos, RB_MSG_HDR_SIZE + len);
+        if (rb_cas_read_pos(rb, &read_pos, next)) {
+            rb_msg_count_lost(rb, &rb->msg_overwritten, tagged);
+            __atomic_add_fetch(&rb->total_overwrites, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&rb->total_overwritten_bytes, (uint32_t)RB_MSG_HDR_SIZE + len, __ATOMIC_RELAXED);
+            ESP_LOGW(TAG, "缓冲区已满，覆盖一条未读旧消息: %d bytes", (int)len);
+            read_pos = next;
+        }
+        // CAS失败说明消费者刚取走了这条消息，用新的读取位置重新判断
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief 确保当前消息能扩展到total_len字节，失败时记录丢弃原因
+ *
+ * @return ESP_OK；超过缓冲区容量返回ESP_ERR_INVALID_SIZE；无法腾出空间返回ESP_ERR_NO_MEM或ESP_ERR_TIMEOUT
+ */
+static esp_err_t rb_msg_make_room(esp_coze_ring_buffer_t *rb, size_t total_len)
+{
+    if (total_len > rb->size - RB_MSG_HDR_SIZE) {
+        rb->msg_drop_reason = ESP_ERR_INVALID_SIZE;
+    } else {
+        rb->msg_drop_reason = rb_msg_reserve(rb, rb_pos_add(rb->write_pos, RB_MSG_HDR_SIZE + total_len));
+    }
+    return rb->msg_drop_reason;
+}
+
+/**
+ * @brief 记录入队消息的长度分布（仅生产者调用）
+ */
+static void rb_msg_record_size(esp_coze_ring_buffer_t *rb, uint32_t len)
+{
+    // 桶i的上限为 256<<(2*i)，超过倒数第二个桶上限的都计入最后一个桶
+    int bucket = 0;
+    uint32_t limit = ESP_COZE_RB_MSG_SIZE_BUCKET0;
+    while (bucket < ESP_COZE_RB_MSG_SIZE_BUCKETS - 1 && len >= limit) {
+        bucket++;
+        limit <<= 2;
+    }
+    __atomic_add_fetch(&rb->msg_size_hist[bucket], 1, __ATOMIC_RELAXED);
+
+    // 最大值只有生产者写入，不需要CAS
+    if (len > rb->msg_max_len) {
+        __atomic_store_n(&rb->msg_max_len, len, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 开始写入一条新消息
+ */
+esp_err_t esp_coze_ring_buffer_msg_begin(esp_coze_ring_buffer_t *rb, size_t size_hint)
+{
+    if (!rb || !rb->buffer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 上一条消息还没收完就开始了新消息，上一条只能丢弃
+    if (rb->msg_active) {
+        esp_coze_ring_buffer_msg_abort(rb);
+    }
+
+    rb->msg_active = true;
+    rb->msg_drop_reason = ESP_OK;
+    rb->msg_len = 0;
+    rb->msg_tagged = false;
+
+    // 已知总长度时一次性预留空间，后续追加不需要再逐段覆盖
+    if (size_hint > 0) {
+        rb_msg_make_room(rb, size_hint);
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief 向当前消息追加数据
+ */
+esp_err_t esp_coze_ring_buffer_msg_append(esp_coze_ring_buffer_t *rb, const uint8_t *data, size_t len)
+{
+    if (!rb || !rb->buffer || (!data && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!rb->msg_active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (rb->msg_drop_reason != ESP_OK) {
+        return rb->msg_drop_reason;
+    }
+
+    if (len == 0) {
+        return ESP_OK;
+    }
+
+    // 消息体写在长度头之后，发布前对消费者不可见
+    esp_err_t ret = rb_msg_make_room(rb, rb->msg_len + len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    rb_copy_in(rb, rb_pos_add(rb->write_pos, RB_MSG_HDR_SIZE + rb->msg_len), data, len);
+    rb->msg_len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief 给当前消息打标记
+ */
+esp_err_t esp_coze_ring_buffer_msg_tag(esp_coze_ring_buffer_t *rb)
+{
+    if (!rb || !rb->buffer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!rb->msg_active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rb->msg_tagged = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief 结束当前消息并发布给消费者
+ */
+esp_err_t esp_coze_ring_buffer_msg_end(esp_coze_ring_buffer_t *rb)
+{
+    if (!rb || !rb->buffer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!rb->msg_active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rb->msg_active = false;
+
+    if (rb->msg_drop_reason == ESP_ERR_INVALID_SIZE) {
+        rb_msg_count_lost(rb, &rb->msg_oversize, rb->msg_tagged);
+        ESP_LOGW(TAG, "消息超过缓冲区容量(%d bytes)，已丢弃", (int)rb->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (rb->msg_drop_reason != ESP_OK) {
+        rb_msg_count_lost(rb, &rb->msg_dropped, rb->msg_tagged);
+        ESP_LOGW(TAG, "缓冲区已满，丢弃新消息: %d bytes (%s)", (int)rb->msg_len, esp_err_to_name(rb->msg_drop_reason));
+        return rb->msg_drop_reason;
+    }
+
+    // 先写长度头，再发布写入位置，消费者看到的一定是完整记录
+    uint32_t len = (uint32_t)rb->msg_len;
+    uint32_t hdr = rb->msg_tagged ? len | RB_MSG_TAGGED : len;
+    rb_copy_in(rb, rb->write_pos, (const uint8_t *)&hdr, RB_MSG_HDR_SIZE);
+    __atomic_store_n(&rb->write_pos, rb_pos_add(rb->write_pos, RB_MSG_HDR_SIZE + len), __ATOMIC_RELEASE);
+    __atomic_add_fetch(&rb->msg_committed, 1, __ATOMIC_RELAXED);
+    rb_msg_record_size(rb, len);
+
+    // 通知有消息可读
+    xSemaphoreGive(rb->data_sem);
+
+    ESP_LOGD(TAG, "写入消息: %d bytes", (int)len);
+    return ESP_OK;
+}
+
+/**
+ * @brief 放弃当前未完成的消息
+ */
+void esp_coze_ring_buffer_msg_abort(esp_coze_ring_buffer_t *rb)
+{
+    if (!rb || !rb->msg_active) {
+        return;
+    }
+
+    rb->msg_active = false;
+    rb->msg_drop_reason = ESP_OK;
+    rb_msg_count_lost(rb, &rb->msg_truncated, rb->msg_tagged);
+    ESP_LOGW(TAG, "丢弃未接收完整的消息，已接收 %d bytes", (int)rb->msg_len);
+    rb->msg_len = 0;
+}
+
+/**
+ * @brief 读取一条完整消息
+ */
+esp_err_t esp_coze_ring_buffer_read_message(esp_coze_ring_buffer_t *rb, uint8_t *data, size_t max_len, size_t *actual_len)
+{
+    if (!rb || !rb->buffer || !data || !actual_len || max_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *actual_len = 0;
+
+    for (;;) {
+        uint32_t read_pos = rb_load(&rb->read_pos);
+        if (read_pos & RB_POS_CLAIMED) {
+            // 上一次peek的消息还没有提交
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        uint32_t write_pos = rb_load(&rb->write_pos);
+        if (read_pos == write_pos) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        // 长度头可能正被生产者覆盖，超出已发布范围时重新读取
+        uint32_t len = rb_msg_read_hdr(rb, read_pos, NULL);
+        uint32_t published = rb_pos_diff(write_pos, read_pos);
+        if (published < RB_MSG_HDR_SIZE || len > published - RB_MSG_HDR_SIZE) {
+            if (rb_load(&rb->read_pos) == read_pos) {
+                // 读取位置没有变化却得到非法长度，记录已损坏，丢弃全部已发布数据重新同步
+                ESP_LOGE(TAG, "消息长度头异常: %u，丢弃 %u bytes", (unsigned)len, (unsigned)published);
+                if (rb_cas_read_pos(rb, &read_pos, write_pos)) {
+                    rb_notify_space(rb);
                 }
             }
+            continue;
+        }
+
+        uint32_t next = rb_pos_add(read_pos, RB_MSG_HDR_SIZE + len);
+
+        if (len + 1 > max_len) {
+            // 输出缓冲区放不下，跳过该消息避免阻塞后续消息
+            if (rb_cas_read_pos(rb, &read_pos, next)) {
+                rb_notify_space(rb);
+                *actual_len = len;
+                ESP_LOGW(TAG, "消息长度 %d 超过输出缓冲区 %d，已跳过", (int)len, (int)max_len);
+                return ESP_ERR_INVALID_SIZE;
+            }
+            continue;
+        }
+
+        rb_copy_out(rb, rb_pos_add(read_pos, RB_MSG_HDR_SIZE), data, len);
+        if (rb_cas_read_pos(rb, &read_pos, next)) {
+            rb_notify_space(rb);
+            data[len] = '\0';
+            *actual_len = len;
+            ESP_LOGD(TAG, "读取消息: %d bytes", (int)len);
+            return ESP_OK;
         }
+
+        // 拷贝期间消息被覆盖，重新读取下一条
     }
+}
 
-    if (!found_start || brace_count != 0) {
-        // 没有找到完整的JSON对象
-        size_t available = (rb->write_pos >= rb->read_pos) ?
-                           (rb->write_pos - rb->read_pos) :
-                           (rb->size - rb->read_pos + rb->write_pos);
-        xSemaphoreGive(rb->mutex);
-        ESP_LOGD(TAG, "未找到完整JSON对象，found_start=%d, brace_count=%d, available=%d",
-                 found_start, brace_count, (int)available);
-        return ESP_ERR_NOT_FOUND;
+/**
+ * @brief 原地查看最老的一条完整消息
+ */
+esp_err_t esp_coze_ring_buffer_peek_message(esp_coze_ring_buffer_t *rb, esp_coze_ring_buffer_msg_view_t *view)
+{
+    if (!rb || !rb->buffer || !view) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    // 读取完整的JSON对象并更新读取指针
-    for (size_t i = 0; i < json_len; i++) {
-        data[i] = rb->buffer[rb->read_pos];
-        rb->read_pos = (rb->read_pos + 1) % rb->size;
+    memset(view, 0, sizeof(*view));
+
+    for (;;) {
+        uint32_t read_pos = rb_load(&rb->read_pos);
+        if (read_pos & RB_POS_CLAIMED) {
+            // 上一次peek的消息还没有提交
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        uint32_t write_pos = rb_load(&rb->write_pos);
+        if (read_pos == write_pos) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        // 给最老的消息打上占用标记，之后生产者不会再覆盖它；CAS失败说明它刚被覆盖，重新获取
+        if (!rb_cas_read_pos(rb, &read_pos, read_pos | RB_POS_CLAIMED)) {
+            continue;
+        }
+
+        uint32_t len = rb_msg_read_hdr(rb, read_pos, NULL);
+        uint32_t published = rb_pos_diff(write_pos, read_pos);
+        if (published < RB_MSG_HDR_SIZE || len > published - RB_MSG_HDR_SIZE) {
+            // 已占用的记录不会再被改写，长度仍非法说明记录已损坏，丢弃全部已发布数据重新同步
+            ESP_LOGE(TAG, "消息长度头异常: %u，丢弃 %u bytes", (unsigned)len, (unsigned)published);
+            __atomic_store_n(&rb->read_pos, write_pos, __ATOMIC_RELEASE);
+            rb_notify_space(rb);
+            continue;
+        }
+
+        // 消息体可能跨越缓冲区末尾，此时拆成两段
+        size_t idx = rb_pos_add(read_pos, RB_MSG_HDR_SIZE) & rb->mask;
+        size_t first = rb->size - idx;
+        if (first > len) {
+            first = len;
+        }
+        view->seg[0] = rb->buffer + idx;
+        view->seg_len[0] = first;
+        if (len > first) {
+            view->seg[1] = rb->buffer;
+            view->seg_len[1] = len - first;
+        }
+        view->len = len;
+        view->next_pos = rb_pos_add(read_pos, RB_MSG_HDR_SIZE + len);
+        return ESP_OK;
     }
+}
 
-    data[json_len] = '\0';
-    *actual_len = json_len;
+/**
+ * @brief 提交peek得到的消息，释放其占用的缓冲区空间
+ */
+esp_err_t esp_coze_ring_buffer_commit_message(esp_coze_ring_buffer_t *rb, const esp_coze_ring_buffer_msg_view_t *view)
+{
+    if (!rb || !rb->buffer || !view) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    xSemaphoreGive(rb->mutex);
+    uint32_t read_pos = rb_load(&rb->read_pos);
+    if (!(read_pos & RB_POS_CLAIMED)) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    ESP_LOGD(TAG, "读取JSON对象: %d bytes", (int)json_len);
+    // 占用期间生产者不会修改read_pos，直接发布新的读取位置并清除占用标记
+    __atomic_store_n(&rb->read_pos, view->next_pos, __ATOMIC_RELEASE);
+    rb_notify_space(rb);
+    ESP_LOGD(TAG, "提交消息: %d bytes", (int)view->len);
     return ESP_OK;
 }
 
 /**
- * @brief 获取环形缓冲区可用数据量
+ * @brief 获取消息的连续内存视图，只有回绕的消息才拷贝
  */
-size_t esp_coze_ring_buffer_available(esp_coze_ring_buffer_t *rb)
+const uint8_t *esp_coze_ring_buffer_view_linearize(const esp_coze_ring_buffer_msg_view_t *view,
+                                                   uint8_t *scratch, size_t scratch_len)
 {
-    if (!rb) {
-        return 0;
+    if (!view || view->len == 0) {
+        return NULL;
     }
 
-    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
-        return 0;
+    // 未回绕的消息直接返回缓冲区内的指针，零拷贝
+    if (view->seg_len[1] == 0) {
+        return view->seg[0];
     }
 
-    size_t available;
-    if (rb->write_pos >= rb->read_pos) {
-        available = rb->write_pos - rb->read_pos;
-    } else {
-        available = rb->size - rb->read_pos + rb->write_pos;
+    if (!scratch || scratch_len < view->len) {
+        return NULL;
     }
 
-    xSemaphoreGive(rb->mutex);
-    return available;
+    memcpy(scratch, view->seg[0], view->seg_len[0]);
+    memcpy(scratch + view->seg_len[0], view->seg[1], view->seg_len[1]);
+    return scratch;
+}
+
+/**
+ * @brief 获取消息模式统计信息
+ */
+esp_err_t esp_coze_ring_buffer_get_msg_stats(esp_coze_ring_buffer_t *rb, esp_coze_ring_buffer_msg_stats_t *stats)
+{
+    if (!rb || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stats->committed = __atomic_load_n(&rb->msg_committed, __ATOMIC_RELAXED);
+    stats->overwritten = __atomic_load_n(&rb->msg_overwritten, __ATOMIC_RELAXED);
+    stats->truncated = __atomic_load_n(&rb->msg_truncated, __ATOMIC_RELAXED);
+    stats->oversize = __atomic_load_n(&rb->msg_oversize, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&rb->msg_dropped, __ATOMIC_RELAXED);
+    stats->tagged_lost = __atomic_load_n(&rb->msg_tagged_lost, __ATOMIC_RELAXED);
+    stats->blocked = __atomic_load_n(&rb->blocked, __ATOMIC_RELAXED);
+    stats->block_timeouts = __atomic_load_n(&rb->block_timeouts, __ATOMIC_RELAXED);
+    stats->blocked_ms = __atomic_load_n(&rb->blocked_ms, __ATOMIC_RELAXED);
+    stats->max_len = __atomic_load_n(&rb->msg_max_len, __ATOMIC_RELAXED);
+    for (int i = 0; i < ESP_COZE_RB_MSG_SIZE_BUCKETS; i++) {
+        stats->size_hist[i] = __atomic_load_n(&rb->msg_size_hist[i], __ATOMIC_RELAXED);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 获取环形缓冲区可用数据量
+ */
+size_t esp_coze_ring_buffer_available(esp_coze_ring_buffer_t *rb)
+{
+    if (!rb || !rb->buffer) {
+        return 0;
+    }
+
+    // 先取读取位置再取写入位置，差值不会出现负数
+    uint32_t read_pos = rb_load(&rb->read_pos);
+    return rb_pos_diff(rb_load(&rb->write_pos), read_pos);
 }
 
 /**
@@ -279,14 +952,14 @@ void esp_coze_ring_buffer_deinit(esp_coze_ring_buffer_t *rb)
         return;
     }
 
-    if (rb->mutex) {
-        vSemaphoreDelete(rb->mutex);
-    }
-
     if (rb->data_sem) {
         vSemaphoreDelete(rb->data_sem);
     }
 
+    if (rb->space_sem) {
+        vSemaphoreDelete(rb->space_sem);
+    }
+
     if (rb->buffer) {
         free(rb->buffer);
     }
@@ -303,15 +976,8 @@ esp_err_t esp_coze_ring_buffer_get_overwrite_stats(esp_coze_ring_buffer_t *rb,
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGW(TAG, "获取互斥锁超时");
-        return ESP_ERR_TIMEOUT;
-    }
-
-    *total_overwrites = rb->total_overwrites;
-    *total_overwritten_bytes = rb->total_overwritten_bytes;
-
-    xSemaphoreGive(rb->mutex);
+    *total_overwrites = __atomic_load_n(&rb->total_overwrites, __ATOMIC_RELAXED);
+    *total_overwritten_bytes = __atomic_load_n(&rb->total_overwritten_bytes, __ATOMIC_RELAXED);
     return ESP_OK;
 }
 
@@ -321,15 +987,8 @@ esp_err_t esp_coze_ring_buffer_reset_overwrite_stats(esp_coze_ring_buffer_t *rb)
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGW(TAG, "获取互斥锁超时");
-        return ESP_ERR_TIMEOUT;
-    }
-
-    rb->total_overwrites = 0;
-    rb->total_overwritten_bytes = 0;
+    __atomic_store_n(&rb->total_overwrites, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&rb->total_overwritten_bytes, 0, __ATOMIC_RELAXED);
     ESP_LOGI(TAG, "环形缓冲区统计信息已重置");
-
-    xSemaphoreGive(rb->mutex);
     return ESP_OK;
 }
@@ -0,0 +1,428 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 16:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 16:00:00
+ * @FilePath: \esp-chunfeng\components\esp_coze_open\src\esp_coze_sender.c
+ * @Description: 扣子上行消息异步发送任务实现
+ *
+ */
+#include "esp_coze_sender.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "COZE_SENDER";
+
+#define LANE_CONTROL 0
+#define LANE_AUDIO   1
+#define SENDER_TOTAL_SLOTS (ESP_COZE_SENDER_CONTROL_SLOTS + ESP_COZE_SENDER_AUDIO_SLOTS)
+
+// 发送任务栈 - 放在PSRAM
+#define SENDER_TASK_STACK_SIZE (6144 / sizeof(StackType_t))
+static EXT_RAM_BSS_ATTR StackType_t s_sender_stack[SENDER_TASK_STACK_SIZE];
+static StaticTask_t s_sender_task_buffer;
+static TaskHandle_t s_sender_task = NULL;
+static volatile bool s_running = false;
+
+// 消息槽：前 CONTROL_SLOTS 个属于控制通道，其余属于音频通道
+static esp_coze_tx_msg_t s_msgs[SENDER_TOTAL_SLOTS];
+
+// 每个通道一个空闲队列，音频通道另有一个待发送队列，队列中存放槽位编号
+static QueueHandle_t s_free[2];
+static QueueHandle_t s_audio_pending;
+static StaticQueue_t s_queue_buffers[3];
+static uint8_t s_control_free_storage[ESP_COZE_SENDER_CONTROL_SLOTS];
+static uint8_t s_audio_free_storage[ESP_COZE_SENDER_AUDIO_SLOTS];
+static uint8_t s_audio_pending_storage[ESP_COZE_SENDER_AUDIO_SLOTS];
+
+static esp_websocket_client_handle_t s_client = NULL;
+static esp_coze_sender_policy_t s_policy = ESP_COZE_SENDER_DROP_OLDEST;
+
+// 以下状态由 s_lock 保护
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_audio_submit_seq = 0;                     // 最后提交的音频序号
+static uint32_t s_kind_pending[ESP_COZE_TX_KIND_MAX];       // 各类控制消息的排队数量
+static uint32_t s_kind_pending_seq[ESP_COZE_TX_KIND_MAX];   // 最后一条同类消息排队时的音频序号
+static esp_coze_sender_stats_t s_stats;
+// 控制通道待发送的槽位编号，按提交顺序排列；立即发送的消息要能越过排在前面的有序消息，所以不用队列
+static uint8_t s_control_pending[ESP_COZE_SENDER_CONTROL_SLOTS];
+static uint32_t s_control_pending_count = 0;
+
+// 已经发送或丢弃的音频序号（只增不减），有序控制消息据此判断之前的音频是否已经处理完
+static uint32_t s_audio_done_seq = 0;
+
+/**
+ * @brief 消息种类对应的通道
+ */
+static inline int kind_lane(esp_coze_tx_kind_t kind)
+{
+    return kind == ESP_COZE_TX_KIND_AUDIO_APPEND ? LANE_AUDIO : LANE_CONTROL;
+}
+
+/**
+ * @brief 是否需要排在之前提交的音频之后（complete必须在最后一段音频之后才能提交）
+ */
+static inline bool kind_ordered(esp_coze_tx_kind_t kind)
+{
+    return kind == ESP_COZE_TX_KIND_AUDIO_COMPLETE || kind == ESP_COZE_TX_KIND_OTHER ||
+           kind == ESP_COZE_TX_KIND_BINARY;
+}
+
+/**
+ * @brief 是否可以与排队中的同类消息合并（重复的打断/提交没有意义）
+ */
+static inline bool kind_coalescable(esp_coze_tx_kind_t kind)
+{
+    return kind == ESP_COZE_TX_KIND_CHAT_CANCEL || kind == ESP_COZE_TX_KIND_AUDIO_COMPLETE;
+}
+
+/**
+ * @brief 记录音频序号已处理，发送任务和丢弃最老消息的生产者都会调用，取最大值
+ */
+static void mark_audio_done(uint32_t seq)
+{
+    uint32_t cur = __atomic_load_n(&s_audio_done_seq, __ATOMIC_ACQUIRE);
+    while ((int32_t)(seq - cur) > 0 &&
+            !__atomic_compare_exchange_n(&s_audio_done_seq, &cur, seq, true, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static inline bool audio_seq_done(uint32_t seq)
+{
+    return (int32_t)(__atomic_load_n(&s_audio_done_seq, __ATOMIC_ACQUIRE) - seq) >= 0;
+}
+
+/**
+ * @brief 回收消息槽
+ */
+static void release_msg(esp_coze_tx_msg_t *msg)
+{
+    xQueueSend(s_free[kind_lane(msg->kind)], &msg->index, 0);
+}
+
+/**
+ * @brief 取下一条要发送的消息
+ *
+ * 控制通道优先，按提交顺序取第一条可以发送的：立即发送的消息随时可以发送；有序消息
+ * 只看最前面的一条，它之前提交的音频发完之前先让音频通道发送，排在它后面的立即发送
+ * 消息不受影响。
+ */
+static esp_coze_tx_msg_t *next_message(void)
+{
+    esp_coze_tx_msg_t *msg = NULL;
+    bool ordered_seen = false;
+    uint8_t idx;
+
+    portENTER_CRITICAL(&s_lock);
+    for (uint32_t i = 0; i < s_control_pending_count; i++) {
+        esp_coze_tx_msg_t *m = &s_msgs[s_control_pending[i]];
+        if (kind_ordered(m->kind)) {
+            bool first = !ordered_seen;
+            ordered_seen = true;
+            if (!first || !audio_seq_done(m->audio_seq)) {
+                continue;
+            }
+        }
+        msg = m;
+        memmove(&s_control_pending[i], &s_control_pending[i + 1], s_control_pending_count - i - 1);
+        s_control_pending_count--;
+        s_kind_pending[m->kind]--;
+        break;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (msg) {
+        return msg;
+    }
+
+    if (xQueueReceive(s_audio_pending, &idx, 0) == pdTRUE) {
+        return &s_msgs[idx];
+    }
+    return NULL;
+}
+
+/**
+ * @brief 发送任务：唯一调用 esp_websocket_client_send_text/send_bin 的地方
+ */
+static void sender_task(void *param)
+{
+    while (s_running) {
+        esp_coze_tx_msg_t *msg = next_message();
+        if (!msg) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        int lane = kind_lane(msg->kind);
+        int sent = -1;
+        if (!esp_websocket_client_is_connected(s_client)) {
+            // 未连接，按发送失败处理
+        } else if (msg->kind == ESP_COZE_TX_KIND_BINARY) {
+            sent = esp_websocket_client_send_bin(s_client, msg->buf, msg->len,
+                                                 pdMS_TO_TICKS(ESP_COZE_SENDER_SEND_TIMEOUT_MS));
+        } else {
+            sent = esp_websocket_client_send_text(s_client, msg->buf, msg->len,
+                                                  pdMS_TO_TICKS(ESP_COZE_SENDER_SEND_TIMEOUT_MS));
+        }
+
+        portENTER_CRITICAL(&s_lock);
+        if (sent >= 0) {
+            s_stats.sent[lane]++;
+            s_stats.bytes_sent[lane] += msg->len;
+        } else {
+            s_stats.send_failed++;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (sent < 0) {
+            ESP_LOGW(TAG, "发送失败，丢弃%s消息: %d字节", lane == LANE_AUDIO ? "音频" : "控制", (int)msg->len);
+        }
+        if (lane == LANE_AUDIO) {
+            mark_audio_done(msg->audio_seq);
+        }
+        release_msg(msg);
+    }
+
+    s_sender_task = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 初始化发送任务
+ */
+esp_err_t esp_coze_sender_init(esp_websocket_client_handle_t client, esp_coze_sender_policy_t policy)
+{
+    if (!client || policy > ESP_COZE_SENDER_DROP_NEWEST) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_running || s_sender_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (int i = 0; i < SENDER_TOTAL_SLOTS; i++) {
+        char *buf = heap_caps_malloc(ESP_COZE_SENDER_SLOT_SIZE, MALLOC_CAP_SPIRAM);
+        if (!buf) {
+            buf = malloc(ESP_COZE_SENDER_SLOT_SIZE);
+        }
+        if (!buf) {
+            ESP_LOGE(TAG, "分配消息槽失败");
+            for (int j = 0; j < i; j++) {
+                free(s_msgs[j].buf);
+            }
+            memset(s_msgs, 0, sizeof(s_msgs));
+            return ESP_ERR_NO_MEM;
+        }
+        s_msgs[i] = (esp_coze_tx_msg_t) {
+            .buf = buf,
+            .cap = ESP_COZE_SENDER_SLOT_SIZE,
+            .kind = i < ESP_COZE_SENDER_CONTROL_SLOTS ? ESP_COZE_TX_KIND_OTHER : ESP_COZE_TX_KIND_AUDIO_APPEND,
+            .index = (uint8_t)i,
+        };
+    }
+
+    s_free[LANE_CONTROL] = xQueueCreateStatic(ESP_COZE_SENDER_CONTROL_SLOTS, sizeof(uint8_t),
+                                              s_control_free_storage, &s_queue_buffers[0]);
+    s_free[LANE_AUDIO] = xQueueCreateStatic(ESP_COZE_SENDER_AUDIO_SLOTS, sizeof(uint8_t),
+                                            s_audio_free_storage, &s_queue_buffers[1]);
+    s_audio_pending = xQueueCreateStatic(ESP_COZE_SENDER_AUDIO_SLOTS, sizeof(uint8_t),
+                                         s_audio_pending_storage, &s_queue_buffers[2]);
+    for (int i = 0; i < SENDER_TOTAL_SLOTS; i++) {
+        release_msg(&s_msgs[i]);
+    }
+
+    s_client = client;
+    s_policy = policy;
+    s_audio_submit_seq = 0;
+    s_audio_done_seq = 0;
+    s_control_pending_count = 0;
+    memset(s_kind_pending, 0, sizeof(s_kind_pending));
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    // 优先级高于录音之外的应用任务，尽快把队列排空
+    s_running = true;
+    s_sender_task = xTaskCreateStatic(sender_task, "coze_sender", SENDER_TASK_STACK_SIZE, NULL, 6,
+                                      s_sender_stack, &s_sender_task_buffer);
+    if (!s_sender_task) {
+        ESP_LOGE(TAG, "创建发送任务失败");
+        s_running = false;
+        esp_coze_sender_deinit();
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "发送任务启动，控制通道%d槽，音频通道%d槽，音频满时%s", ESP_COZE_SENDER_CONTROL_SLOTS,
+             ESP_COZE_SENDER_AUDIO_SLOTS, policy == ESP_COZE_SENDER_DROP_OLDEST ? "丢弃最老" : "丢弃最新");
+    return ESP_OK;
+}
+
+/**
+ * @brief 停止发送任务并释放资源
+ */
+void esp_coze_sender_deinit(void)
+{
+    s_running = false;
+    if (s_sender_task) {
+        xTaskNotifyGive(s_sender_task);
+        int retry = 100 + ESP_COZE_SENDER_SEND_TIMEOUT_MS / 10;
+        while (s_sender_task && retry-- > 0) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (s_free[i]) {
+            vQueueDelete(s_free[i]);
+            s_free[i] = NULL;
+        }
+    }
+    if (s_audio_pending) {
+        vQueueDelete(s_audio_pending);
+        s_audio_pending = NULL;
+    }
+    s_control_pending_count = 0;
+    for (int i = 0; i < SENDER_TOTAL_SLOTS; i++) {
+        free(s_msgs[i].buf);
+    }
+    memset(s_msgs, 0, sizeof(s_msgs));
+    s_client = NULL;
+}
+
+/**
+ * @brief 分配一个消息槽
+ */
+esp_err_t esp_coze_sender_alloc(esp_coze_tx_kind_t kind, size_t len, esp_coze_tx_msg_t **out)
+{
+    if (!out || (unsigned)kind >= ESP_COZE_TX_KIND_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int lane = kind_lane(kind);
+    if (lane == LANE_AUDIO && len > ESP_COZE_SENDER_SLOT_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t idx;
+    if (xQueueReceive(s_free[lane], &idx, 0) != pdTRUE) {
+        // 音频通道满：取出最老的未发送音频直接复用它的槽位
+        bool stolen = lane == LANE_AUDIO && s_policy == ESP_COZE_SENDER_DROP_OLDEST &&
+                      xQueueReceive(s_audio_pending, &idx, 0) == pdTRUE;
+        if (stolen) {
+            mark_audio_done(s_msgs[idx].audio_seq);
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.dropped[lane]++;
+        portEXIT_CRITICAL(&s_lock);
+        if (!stolen) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_coze_tx_msg_t *msg = &s_msgs[idx];
+    if (len > msg->cap) {
+        // 只有控制通道会走到这里，例如较大的chat.update，扩容后一直保留
+        char *buf = heap_caps_realloc(msg->buf, len, MALLOC_CAP_SPIRAM);
+        if (!buf) {
+            buf = realloc(msg->buf, len);
+        }
+        if (!buf) {
+            ESP_LOGE(TAG, "扩容消息槽失败: %d字节", (int)len);
+            xQueueSend(s_free[lane], &idx, 0);
+            return ESP_ERR_NO_MEM;
+        }
+        msg->buf = buf;
+        msg->cap = len;
+    }
+
+    msg->kind = kind;
+    msg->len = 0;
+    *out = msg;
+    return ESP_OK;
+}
+
+/**
+ * @brief 提交消息
+ */
+void esp_coze_sender_submit(esp_coze_tx_msg_t *msg)
+{
+    if (!msg) {
+        return;
+    }
+
+    int lane = kind_lane(msg->kind);
+    bool coalesced = false;
+    uint32_t pending = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    if (lane == LANE_AUDIO) {
+        msg->audio_seq = ++s_audio_submit_seq;
+    } else {
+        msg->audio_seq = s_audio_submit_seq;
+        if (kind_coalescable(msg->kind) && s_kind_pending[msg->kind] > 0 &&
+                s_kind_pending_seq[msg->kind] == s_audio_submit_seq) {
+            coalesced = true;
+            s_stats.coalesced++;
+        } else {
+            s_kind_pending[msg->kind]++;
+            s_kind_pending_seq[msg->kind] = s_audio_submit_seq;
+            // 待发送数组长度等于槽位数，不会满
+            s_control_pending[s_control_pending_count++] = msg->index;
+            pending = s_control_pending_count;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (coalesced) {
+        release_msg(msg);
+        return;
+    }
+
+    if (lane == LANE_AUDIO) {
+        // 待发送队列长度等于槽位数，不会满
+        xQueueSend(s_audio_pending, &msg->index, 0);
+        pending = uxQueueMessagesWaiting(s_audio_pending);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (pending > s_stats.max_pending[lane]) {
+        s_stats.max_pending[lane] = pending;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    TaskHandle_t task = s_sender_task;
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+/**
+ * @brief 放弃已分配但不再发送的消息
+ */
+void esp_coze_sender_discard(esp_coze_tx_msg_t *msg)
+{
+    if (msg) {
+        release_msg(msg);
+    }
+}
+
+/**
+ * @brief 获取发送统计
+ */
+esp_err_t esp_coze_sender_get_stats(esp_coze_sender_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    stats->pending[LANE_CONTROL] = s_control_pending_count;
+    portEXIT_CRITICAL(&s_lock);
+    stats->pending[LANE_AUDIO] = s_audio_pending ? uxQueueMessagesWaiting(s_audio_pending) : 0;
+    return ESP_OK;
+}
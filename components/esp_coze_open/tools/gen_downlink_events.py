@@ -0,0 +1,438 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+根据 include/esp_coze_downlink_events.json 生成下行事件ID枚举、完美哈希查找表，
+以及各事件data字段的类型化结构体和解码函数。
+
+输出（均写入 --output-dir，内容不变时不覆盖，避免无谓的重新编译）：
+- esp_coze_downlink_event_ids.h：事件ID枚举和查找函数声明
+- esp_coze_downlink_events.c：完美哈希表、查找函数和事件名表
+- esp_coze_downlink_types.h：data字段结构体和解码函数声明
+- esp_coze_downlink_types.c：解码函数实现
+
+解码函数基于 esp_coze_json_scan_object：每层对象只扫描一遍，所有字段一次取出，
+不构建cJSON树、不分配内存；字符串按schema中的max_len拷贝到结构体内的定长数组。
+
+哈希函数为带种子的FNV-1a，槽位取哈希值的最高几位（FNV乘法的低位只受输入低位影响，
+高位混合得更充分）。生成时搜索一个没有冲突的种子，运行时每次查找固定为：
+一遍哈希 + 一次长度比较 + 一次memcmp。
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+FNV_PRIME = 16777619
+MAX_SEED = 1 << 20
+
+FIELD_TYPES = ('string', 'int', 'bool', 'object')
+IDENT_RE = re.compile(r'^[a-z_][a-z0-9_]*$')
+
+
+def fnv1a(seed, data):
+    h = seed
+    for b in data:
+        h ^= b
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def hash_slot(seed, key, bits):
+    return fnv1a(seed, key) >> (32 - bits)
+
+
+def find_perfect_hash(keys):
+    """返回 (seed, bits)，表大小为 1 << bits，所有key落在不同槽位"""
+    bits = 1
+    while (1 << bits) < len(keys) * 2:
+        bits += 1
+
+    while True:
+        for seed in range(1, MAX_SEED):
+            slots = set()
+            for key in keys:
+                slot = hash_slot(seed, key, bits)
+                if slot in slots:
+                    break
+                slots.add(slot)
+            else:
+                return seed, bits
+        bits += 1
+
+
+def check_fields(where, fields):
+    """检查一层字段定义，嵌套对象递归检查"""
+    if not fields:
+        raise ValueError('%s 没有字段' % where)
+    if len(fields) > 32:
+        raise ValueError('%s 字段超过32个' % where)
+    seen = set()
+    for field in fields:
+        name = field['name']
+        if not IDENT_RE.match(name) or name == 'present' or name in seen:
+            raise ValueError('%s 字段名不合法或重复: %s' % (where, name))
+        seen.add(name)
+        if field['type'] not in FIELD_TYPES:
+            raise ValueError('%s.%s 类型未知: %s' % (where, name, field['type']))
+        if field['type'] == 'string' and int(field.get('max_len', 0)) < 1:
+            raise ValueError('%s.%s 缺少max_len' % (where, name))
+        if field['type'] == 'object':
+            check_fields('%s.%s' % (where, name), field.get('fields'))
+
+
+def load_events(path):
+    with open(path, 'r', encoding='utf-8') as f:
+        doc = json.load(f)
+
+    data_types = doc.get('types', {})
+    for type_name, type_def in data_types.items():
+        if not IDENT_RE.match(type_name):
+            raise ValueError('类型名不合法: %s' % type_name)
+        check_fields(type_name, type_def.get('fields'))
+
+    events = doc['events']
+    names = set()
+    types = set()
+    for ev in events:
+        if ev['name'] in names or ev['type'] in types:
+            raise ValueError('重复的事件: %s / %s' % (ev['name'], ev['type']))
+        if len(ev['type'].encode('utf-8')) > 255:
+            raise ValueError('事件类型过长: %s' % ev['type'])
+        if 'data' in ev and ev['data'] not in data_types:
+            raise ValueError('事件 %s 引用了未定义的类型: %s' % (ev['type'], ev['data']))
+        names.add(ev['name'])
+        types.add(ev['type'])
+    return events, data_types
+
+
+def write_if_changed(path, content):
+    if os.path.exists(path):
+        with open(path, 'r', encoding='utf-8') as f:
+            if f.read() == content:
+                return
+    with open(path, 'w', encoding='utf-8') as f:
+        f.write(content)
+
+
+def gen_header(events):
+    lines = [
+        '/*',
+        ' * 本文件由 tools/gen_downlink_events.py 根据 esp_coze_downlink_events.json 自动生成，请勿手动修改',
+        ' */',
+        '#pragma once',
+        '',
+        '#include <stddef.h>',
+        '',
+        '#ifdef __cplusplus',
+        'extern "C" {',
+        '#endif',
+        '',
+        '/**',
+        ' * @brief 下行事件ID',
+        ' */',
+        'typedef enum {',
+        '    ESP_COZE_DL_EVENT_UNKNOWN = 0, ///< 未在事件列表中的事件',
+    ]
+    for ev in events:
+        lines.append('    ESP_COZE_DL_EVENT_%s, ///< %s' % (ev['name'], ev['type']))
+    lines += [
+        '    ESP_COZE_DL_EVENT_MAX,',
+        '} esp_coze_dl_event_id_t;',
+        '',
+        '/**',
+        ' * @brief 根据event_type字符串查找事件ID（完美哈希，耗时与事件数量无关）',
+        ' *',
+        ' * @param type event_type字符串（不要求以\'\\0\'结尾）',
+        ' * @param len 字符串长度',
+        ' * @return esp_coze_dl_event_id_t 事件ID，未知事件返回ESP_COZE_DL_EVENT_UNKNOWN',
+        ' */',
+        'esp_coze_dl_event_id_t esp_coze_dl_event_lookup(const char *type, size_t len);',
+        '',
+        '/**',
+        ' * @brief 获取事件ID对应的event_type字符串',
+        ' *',
+        ' * @param id 事件ID',
+        ' * @return const char* event_type字符串，未知事件返回"unknown"',
+        ' */',
+        'const char *esp_coze_dl_event_name(esp_coze_dl_event_id_t id);',
+        '',
+        '#ifdef __cplusplus',
+        '}',
+        '#endif',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+def gen_source(events, seed, bits):
+    size = 1 << bits
+    slots = [None] * size
+    for ev in events:
+        slots[hash_slot(seed, ev['type'].encode('utf-8'), bits)] = ev
+
+    lines = [
+        '/*',
+        ' * 本文件由 tools/gen_downlink_events.py 根据 esp_coze_downlink_events.json 自动生成，请勿手动修改',
+        ' */',
+        '#include <stdint.h>',
+        '#include <string.h>',
+        '#include "esp_coze_downlink_event_ids.h"',
+        '',
+        '#define DL_EVENT_HASH_SEED 0x%08Xu' % seed,
+        '#define DL_EVENT_HASH_SHIFT %d' % (32 - bits),
+        '',
+        'typedef struct {',
+        '    const char *type;',
+        '    uint8_t len;',
+        '    uint8_t id;',
+        '} dl_event_slot_t;',
+        '',
+        '// 完美哈希表：每个已知事件独占一个槽位，空槽位len为0',
+        'static const dl_event_slot_t s_slots[%d] = {' % size,
+    ]
+    for i, ev in enumerate(slots):
+        if ev:
+            lines.append('    [%d] = {"%s", %d, ESP_COZE_DL_EVENT_%s},'
+                         % (i, ev['type'], len(ev['type'].encode('utf-8')), ev['name']))
+    lines += [
+        '};',
+        '',
+        'static const char *const s_names[ESP_COZE_DL_EVENT_MAX] = {',
+        '    [ESP_COZE_DL_EVENT_UNKNOWN] = "unknown",',
+    ]
+    for ev in events:
+        lines.append('    [ESP_COZE_DL_EVENT_%s] = "%s",' % (ev['name'], ev['type']))
+    lines += [
+        '};',
+        '',
+        'esp_coze_dl_event_id_t esp_coze_dl_event_lookup(const char *type, size_t len)',
+        '{',
+        '    if (!type || len == 0 || len > 255) {',
+        '        return ESP_COZE_DL_EVENT_UNKNOWN;',
+        '    }',
+        '',
+        '    uint32_t h = DL_EVENT_HASH_SEED;',
+        '    for (size_t i = 0; i < len; i++) {',
+        '        h ^= (uint8_t)type[i];',
+        '        h *= %du;' % FNV_PRIME,
+        '    }',
+        '',
+        '    // 槽位唯一，只需确认确实是这个事件（未知字符串也可能落到已占用的槽位）',
+        '    const dl_event_slot_t *slot = &s_slots[h >> DL_EVENT_HASH_SHIFT];',
+        '    if (slot->len != len || memcmp(slot->type, type, len) != 0) {',
+        '        return ESP_COZE_DL_EVENT_UNKNOWN;',
+        '    }',
+        '    return (esp_coze_dl_event_id_t)slot->id;',
+        '}',
+        '',
+        'const char *esp_coze_dl_event_name(esp_coze_dl_event_id_t id)',
+        '{',
+        '    if ((unsigned)id >= ESP_COZE_DL_EVENT_MAX) {',
+        '        return s_names[ESP_COZE_DL_EVENT_UNKNOWN];',
+        '    }',
+        '    return s_names[id];',
+        '}',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+def collect_structs(prefix, path, fields, description, out):
+    """按依赖顺序（嵌套结构体在前）收集需要生成的结构体：(前缀, 字段, 说明)"""
+    for field in fields:
+        if field['type'] == 'object':
+            nested_path = '%s.%s' % (path, field['name'])
+            collect_structs('%s_%s' % (prefix, field['name']), nested_path, field['fields'], nested_path, out)
+    out.append((prefix, fields, description))
+
+
+def struct_type(prefix):
+    return 'esp_coze_dl_%s_t' % prefix
+
+
+def has_macro(prefix, field):
+    return 'ESP_COZE_DL_%s_HAS_%s' % (prefix.upper(), field['name'].upper())
+
+
+def field_decl(prefix, field):
+    if field['type'] == 'string':
+        return 'char %s[%d];' % (field['name'], int(field['max_len']) + 1)
+    if field['type'] == 'int':
+        return 'int64_t %s;' % field['name']
+    if field['type'] == 'bool':
+        return 'bool %s;' % field['name']
+    return '%s %s;' % (struct_type('%s_%s' % (prefix, field['name'])), field['name'])
+
+
+def all_structs(data_types):
+    structs = []
+    for type_name, type_def in data_types.items():
+        collect_structs(type_name, type_name, type_def['fields'], type_def.get('description', type_name), structs)
+    return structs
+
+
+def gen_types_header(events, data_types):
+    lines = [
+        '/*',
+        ' * 本文件由 tools/gen_downlink_events.py 根据 esp_coze_downlink_events.json 自动生成，请勿手动修改',
+        ' */',
+        '#pragma once',
+        '',
+        '#include <stdint.h>',
+        '#include <stdbool.h>',
+        '#include "esp_err.h"',
+        '#include "esp_coze_json_scan.h"',
+        '',
+        '#ifdef __cplusplus',
+        'extern "C" {',
+        '#endif',
+        '',
+    ]
+
+    for prefix, fields, description in all_structs(data_types):
+        for i, field in enumerate(fields):
+            lines.append('#define %s (1u << %d)' % (has_macro(prefix, field), i))
+        lines += [
+            '',
+            '/**',
+            ' * @brief %s' % description,
+            ' */',
+            'typedef struct {',
+            '    uint32_t present; ///< 消息中出现且解析成功的字段，%s_HAS_* 按位组合' % ('ESP_COZE_DL_' + prefix.upper()),
+        ]
+        for field in fields:
+            note = field['name']
+            if field['type'] == 'string':
+                note += '（超过%d字节时截断）' % int(field['max_len'])
+            lines.append('    %s ///< %s' % (field_decl(prefix, field), note))
+        lines += [
+            '} %s;' % struct_type(prefix),
+            '',
+        ]
+
+    for type_name, type_def in data_types.items():
+        users = [ev['type'] for ev in events if ev.get('data') == type_name]
+        lines += [
+            '/**',
+            ' * @brief 解码%s' % type_def.get('description', type_name),
+            ' *',
+            ' * 适用事件：%s' % ('、'.join(users) if users else '无'),
+            ' *',
+            ' * @param data 事件的data字段（esp_coze_dl_event_t.data）',
+            ' * @param out 输出结构体，先清零再填充，未出现的字段保持为0/空字符串',
+            ' * @return esp_err_t',
+            ' *         - ESP_OK: 成功，out->present 标记实际解析到的字段',
+            ' *         - ESP_ERR_INVALID_ARG: 参数错误',
+            ' *         - ESP_ERR_NOT_FOUND: data不存在或不是对象',
+            ' *         - ESP_FAIL: data格式错误',
+            ' */',
+            'esp_err_t esp_coze_dl_decode_%s(const esp_coze_json_span_t *data, %s *out);' % (type_name, struct_type(type_name)),
+            '',
+        ]
+
+    lines += [
+        '#ifdef __cplusplus',
+        '}',
+        '#endif',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+def gen_decoder(prefix, fields, public):
+    n = len(fields)
+    if public:
+        signature = 'esp_err_t esp_coze_dl_decode_%s(const esp_coze_json_span_t *data, %s *out)' % (prefix, struct_type(prefix))
+    else:
+        signature = 'static esp_err_t decode_%s(const esp_coze_json_span_t *data, %s *out)' % (prefix, struct_type(prefix))
+
+    lines = [
+        signature,
+        '{',
+        '    static const char *const keys[%d] = {%s};' % (n, ', '.join('"%s"' % f['name'] for f in fields)),
+        '    esp_coze_json_span_t v[%d];' % n,
+        '',
+        '    if (!data || !out) {',
+        '        return ESP_ERR_INVALID_ARG;',
+        '    }',
+        '    memset(out, 0, sizeof(*out));',
+        '    if (data->type != ESP_COZE_JSON_OBJECT) {',
+        '        return ESP_ERR_NOT_FOUND;',
+        '    }',
+        '',
+        '    esp_err_t ret = esp_coze_json_scan_object(data->ptr, data->len, keys, %d, v);' % n,
+        '    if (ret != ESP_OK) {',
+        '        return ret;',
+        '    }',
+        '',
+    ]
+    for i, field in enumerate(fields):
+        name = field['name']
+        if field['type'] == 'string':
+            cond = 'dl_decode_str(&v[%d], out->%s, sizeof(out->%s))' % (i, name, name)
+        elif field['type'] == 'int':
+            cond = 'esp_coze_json_span_to_int(&v[%d], &out->%s) == ESP_OK' % (i, name)
+        elif field['type'] == 'bool':
+            cond = 'esp_coze_json_span_to_bool(&v[%d], &out->%s) == ESP_OK' % (i, name)
+        else:
+            cond = 'decode_%s_%s(&v[%d], &out->%s) == ESP_OK' % (prefix, name, i, name)
+        lines += [
+            '    if (%s) {' % cond,
+            '        out->present |= %s;' % has_macro(prefix, field),
+            '    }',
+        ]
+    lines += [
+        '    return ESP_OK;',
+        '}',
+        '',
+    ]
+    return lines
+
+
+def gen_types_source(data_types):
+    lines = [
+        '/*',
+        ' * 本文件由 tools/gen_downlink_events.py 根据 esp_coze_downlink_events.json 自动生成，请勿手动修改',
+        ' */',
+        '#include <string.h>',
+        '#include "esp_coze_downlink_types.h"',
+        '',
+        '// 字符串超长时截断也算解析成功',
+        'static bool dl_decode_str(const esp_coze_json_span_t *span, char *buf, size_t size)',
+        '{',
+        '    esp_err_t ret = esp_coze_json_span_to_str(span, buf, size);',
+        '    return ret == ESP_OK || ret == ESP_ERR_INVALID_SIZE;',
+        '}',
+        '',
+    ]
+    for prefix, fields, _ in all_structs(data_types):
+        lines += gen_decoder(prefix, fields, prefix in data_types)
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='生成扣子下行事件ID枚举、完美哈希查找表和类型化解码函数')
+    parser.add_argument('--input', required=True, help='事件列表JSON文件')
+    parser.add_argument('--output-dir', required=True, help='输出目录')
+    args = parser.parse_args()
+
+    try:
+        events, data_types = load_events(args.input)
+    except (OSError, ValueError, KeyError) as e:
+        sys.stderr.write('读取事件列表失败: %s\n' % e)
+        return 1
+
+    seed, bits = find_perfect_hash([ev['type'].encode('utf-8') for ev in events])
+
+    os.makedirs(args.output_dir, exist_ok=True)
+    write_if_changed(os.path.join(args.output_dir, 'esp_coze_downlink_event_ids.h'), gen_header(events))
+    write_if_changed(os.path.join(args.output_dir, 'esp_coze_downlink_events.c'), gen_source(events, seed, bits))
+    write_if_changed(os.path.join(args.output_dir, 'esp_coze_downlink_types.h'), gen_types_header(events, data_types))
+    write_if_changed(os.path.join(args.output_dir, 'esp_coze_downlink_types.c'), gen_types_source(data_types))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
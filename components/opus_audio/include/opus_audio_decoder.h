@@ -26,6 +26,16 @@ typedef struct {
     int max_frame_size;     ///< 最大帧大小（样本数）
 } opus_audio_decoder_config_t;
 
+/**
+ * @brief 解码统计，隐藏/恢复的样本数除以采样率就是受丢包影响的时长
+ */
+typedef struct {
+    uint32_t frames;                ///< 正常解码的包数
+    uint32_t plc_frames;            ///< 丢包隐藏（PLC）合成的帧数
+    uint32_t fec_frames;            ///< 用后一包的带内FEC恢复的帧数
+    uint32_t concealed_samples;     ///< PLC和FEC输出的总样本数（每声道）
+} opus_audio_decoder_stats_t;
+
 /**
  * @brief Opus解码器句柄
  */
@@ -68,6 +78,66 @@ esp_err_t opus_audio_decoder_decode(opus_audio_decoder_t *decoder,
                                    size_t pcm_max_samples,
                                    size_t *pcm_decoded_samples);
 
+/**
+ * @brief 为一个丢失的包合成音频（PLC）
+ *
+ * 按上一包的时长输出一帧，连续丢包时能量逐帧衰减。
+ *
+ * @param decoder 解码器句柄
+ * @param pcm_output PCM输出缓冲区
+ * @param pcm_max_samples PCM缓冲区最大样本数
+ * @param pcm_decoded_samples 实际输出的样本数（输出参数）
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_ERR_INVALID_STATE: 解码器状态无效
+ *         - ESP_FAIL: 解码失败
+ */
+esp_err_t opus_audio_decoder_decode_lost(opus_audio_decoder_t *decoder,
+                                        int16_t *pcm_output,
+                                        size_t pcm_max_samples,
+                                        size_t *pcm_decoded_samples);
+
+/**
+ * @brief 解码一个包，并先补上它之前丢失的包
+ *
+ * 丢失的最后一帧优先用本包携带的带内FEC恢复（SILK/混合模式的包才可能携带），
+ * 其余丢失帧用PLC合成，然后正常解码本包。输出按时间顺序连续排列。
+ * lost_frames为0时等同于 opus_audio_decoder_decode。
+ *
+ * @param decoder 解码器句柄
+ * @param opus_data 本包Opus数据
+ * @param opus_len 本包长度
+ * @param lost_frames 本包之前丢失的包数
+ * @param pcm_output PCM输出缓冲区，需要容纳 (lost_frames + 1) 帧
+ * @param pcm_max_samples PCM缓冲区最大样本数
+ * @param pcm_decoded_samples 实际输出的样本数（输出参数）
+ * @return esp_err_t
+ *         - ESP_OK: 本包解码成功（丢失帧在缓冲区不够时会少补）
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_ERR_INVALID_STATE: 解码器状态无效
+ *         - ESP_FAIL: 本包解码失败，已输出的隐藏帧仍然有效
+ */
+esp_err_t opus_audio_decoder_decode_with_loss(opus_audio_decoder_t *decoder,
+                                             const uint8_t *opus_data,
+                                             size_t opus_len,
+                                             uint32_t lost_frames,
+                                             int16_t *pcm_output,
+                                             size_t pcm_max_samples,
+                                             size_t *pcm_decoded_samples);
+
+/**
+ * @brief 获取解码统计
+ *
+ * @param decoder 解码器句柄
+ * @param stats 输出统计
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ */
+esp_err_t opus_audio_decoder_get_stats(const opus_audio_decoder_t *decoder,
+                                      opus_audio_decoder_stats_t *stats);
+
 /**
  * @brief 获取解码器配置
  *
@@ -0,0 +1,106 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 18:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 18:00:00
+ * @FilePath: \esp-chunfeng\components\opus_audio\include\opus_audio_encoder.h
+ * @Description: Opus音频编码器头文件
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opus编码器配置结构体
+ */
+typedef struct {
+    int sample_rate;        ///< 采样率 (8000, 12000, 16000, 24000, 48000)
+    int channels;           ///< 声道数 (1或2)
+    int bitrate;            ///< 码率（bps），例如16000
+    int frame_duration_ms;  ///< 帧长（毫秒）：10、20、40、60
+    int complexity;         ///< 编码复杂度 0~10，越低越省CPU
+} opus_audio_encoder_config_t;
+
+/**
+ * @brief Opus编码器句柄
+ */
+typedef struct opus_audio_encoder_t opus_audio_encoder_t;
+
+/**
+ * @brief 创建Opus编码器（语音模式）
+ *
+ * @param config 编码器配置
+ * @return opus_audio_encoder_t* 编码器句柄，失败返回NULL
+ */
+opus_audio_encoder_t *opus_audio_encoder_create(const opus_audio_encoder_config_t *config);
+
+/**
+ * @brief 销毁Opus编码器
+ *
+ * @param encoder 编码器句柄
+ */
+void opus_audio_encoder_destroy(opus_audio_encoder_t *encoder);
+
+/**
+ * @brief 编码一帧PCM
+ *
+ * @param encoder 编码器句柄
+ * @param pcm_input PCM输入，样本数必须等于 opus_audio_encoder_get_frame_samples 的返回值
+ * @param pcm_samples PCM样本数（多声道为所有声道样本总数）
+ * @param opus_output Opus包输出缓冲区
+ * @param opus_max_len 输出缓冲区大小
+ * @param opus_encoded_len 实际编码的字节数（输出参数）
+ * @return esp_err_t
+ *         - ESP_OK: 编码成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效或样本数不是一帧
+ *         - ESP_ERR_INVALID_STATE: 编码器状态无效
+ *         - ESP_FAIL: 编码失败
+ */
+esp_err_t opus_audio_encoder_encode(opus_audio_encoder_t *encoder,
+                                   const int16_t *pcm_input,
+                                   size_t pcm_samples,
+                                   uint8_t *opus_output,
+                                   size_t opus_max_len,
+                                   size_t *opus_encoded_len);
+
+/**
+ * @brief 获取一帧的PCM样本数（多声道为所有声道样本总数）
+ *
+ * @param encoder 编码器句柄
+ * @return size_t 样本数，参数无效时返回0
+ */
+size_t opus_audio_encoder_get_frame_samples(const opus_audio_encoder_t *encoder);
+
+/**
+ * @brief 获取编码器配置
+ *
+ * @param encoder 编码器句柄
+ * @param config 输出配置
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ */
+esp_err_t opus_audio_encoder_get_config(const opus_audio_encoder_t *encoder,
+                                       opus_audio_encoder_config_t *config);
+
+/**
+ * @brief 重置编码器状态（开始新的一段语音时调用）
+ *
+ * @param encoder 编码器句柄
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 编码器未初始化
+ */
+esp_err_t opus_audio_encoder_reset(opus_audio_encoder_t *encoder);
+
+#ifdef __cplusplus
+}
+#endif
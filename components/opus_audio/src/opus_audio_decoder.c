@@ -22,6 +22,8 @@ static const char *TAG = "OPUS_AUDIO_DECODER";
 struct opus_audio_decoder_t {
     OpusDecoder *opus_decoder;              ///< Opus解码器句柄
     opus_audio_decoder_config_t config;     ///< 解码器配置
+    int last_frame_samples;                 ///< 上一包的时长（每声道样本数），PLC/FEC按这个长度合成
+    opus_audio_decoder_stats_t stats;       ///< 解码统计
     bool initialized;                       ///< 是否已初始化
 };
 
@@ -84,6 +86,8 @@ opus_audio_decoder_t *opus_audio_decoder_create(const opus_audio_decoder_config_
         return NULL;
     }
 
+    // 还没解码过任何包时按20ms合成
+    decoder->last_frame_samples = config->sample_rate / 50;
     decoder->initialized = true;
     ESP_LOGI(TAG, "Opus解码器创建成功，采样率: %d, 声道数: %d", 
              config->sample_rate, config->channels);
@@ -151,6 +155,8 @@ esp_err_t opus_audio_decoder_decode(opus_audio_decoder_t *decoder,
     }
 
     *pcm_decoded_samples = decoded_samples * decoder->config.channels;
+    decoder->last_frame_samples = decoded_samples;
+    decoder->stats.frames++;
     
     ESP_LOGD(TAG, "解码成功，输入: %d字节，输出: %d样本", 
              (int)opus_len, (int)*pcm_decoded_samples);
@@ -158,6 +164,116 @@ esp_err_t opus_audio_decoder_decode(opus_audio_decoder_t *decoder,
     return ESP_OK;
 }
 
+/**
+ * @brief 合成一个丢失帧：fec_data非NULL时用它的带内FEC恢复，否则PLC
+ */
+static esp_err_t conceal_frame(opus_audio_decoder_t *decoder, const uint8_t *fec_data, size_t fec_len,
+                               int16_t *pcm_output, size_t pcm_max_samples, size_t *pcm_decoded_samples)
+{
+    int channels = decoder->config.channels;
+    int frame_size = decoder->last_frame_samples;
+    if ((size_t)frame_size * channels > pcm_max_samples) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // 只有SILK/混合模式（TOC配置号小于16）的包才可能带LBRR，纯CELT包带FEC标志解码也只会走PLC
+    bool use_fec = fec_data && fec_len > 0 && (fec_data[0] >> 3) < 16;
+    int decoded_samples = opus_decode(decoder->opus_decoder,
+                                    use_fec ? fec_data : NULL,
+                                    use_fec ? fec_len : 0,
+                                    pcm_output,
+                                    frame_size,
+                                    use_fec ? 1 : 0);
+    if (decoded_samples < 0) {
+        ESP_LOGW(TAG, "丢包隐藏失败，错误码: %d", decoded_samples);
+        *pcm_decoded_samples = 0;
+        return ESP_FAIL;
+    }
+
+    if (use_fec) {
+        decoder->stats.fec_frames++;
+    } else {
+        decoder->stats.plc_frames++;
+    }
+    decoder->stats.concealed_samples += decoded_samples;
+    *pcm_decoded_samples = decoded_samples * channels;
+    return ESP_OK;
+}
+
+esp_err_t opus_audio_decoder_decode_lost(opus_audio_decoder_t *decoder,
+                                        int16_t *pcm_output,
+                                        size_t pcm_max_samples,
+                                        size_t *pcm_decoded_samples)
+{
+    if (!decoder || !decoder->initialized) {
+        ESP_LOGE(TAG, "解码器未初始化");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!pcm_output || !pcm_decoded_samples) {
+        ESP_LOGE(TAG, "参数无效");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = conceal_frame(decoder, NULL, 0, pcm_output, pcm_max_samples, pcm_decoded_samples);
+    return ret == ESP_ERR_INVALID_SIZE ? ESP_ERR_INVALID_ARG : ret;
+}
+
+esp_err_t opus_audio_decoder_decode_with_loss(opus_audio_decoder_t *decoder,
+                                             const uint8_t *opus_data,
+                                             size_t opus_len,
+                                             uint32_t lost_frames,
+                                             int16_t *pcm_output,
+                                             size_t pcm_max_samples,
+                                             size_t *pcm_decoded_samples)
+{
+    if (!decoder || !decoder->initialized) {
+        ESP_LOGE(TAG, "解码器未初始化");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!opus_data || opus_len == 0 || !pcm_output || !pcm_decoded_samples) {
+        ESP_LOGE(TAG, "参数无效");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 给本包至少留出一帧的空间，放不下时只补紧挨着本包的几帧（最后一帧才能用本包的FEC恢复）
+    size_t out = 0;
+    size_t frame = (size_t)decoder->last_frame_samples * decoder->config.channels;
+    size_t fit = pcm_max_samples > frame ? (pcm_max_samples - frame) / frame : 0;
+    if (lost_frames > fit) {
+        ESP_LOGW(TAG, "输出缓冲区不足，只补%u/%u个丢失帧", (unsigned)fit, (unsigned)lost_frames);
+        lost_frames = fit;
+    }
+    for (uint32_t i = 0; i < lost_frames; i++) {
+        bool last = i + 1 == lost_frames;
+        size_t n = 0;
+        if (conceal_frame(decoder, last ? opus_data : NULL, last ? opus_len : 0,
+                          pcm_output + out, pcm_max_samples - out, &n) != ESP_OK) {
+            break;
+        }
+        out += n;
+    }
+
+    size_t n = 0;
+    esp_err_t ret = opus_audio_decoder_decode(decoder, opus_data, opus_len,
+                                              pcm_output + out, pcm_max_samples - out, &n);
+    *pcm_decoded_samples = out + n;
+    return ret;
+}
+
+esp_err_t opus_audio_decoder_get_stats(const opus_audio_decoder_t *decoder,
+                                      opus_audio_decoder_stats_t *stats)
+{
+    if (!decoder || !stats) {
+        ESP_LOGE(TAG, "参数无效");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = decoder->stats;
+    return ESP_OK;
+}
+
 esp_err_t opus_audio_decoder_get_config(const opus_audio_decoder_t *decoder,
                                        opus_audio_decoder_config_t *config)
 {
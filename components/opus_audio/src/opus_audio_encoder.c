@@ -0,0 +1,207 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 18:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 18:00:00
+ * @FilePath: \esp-chunfeng\components\opus_audio\src\opus_audio_encoder.c
+ * @Description: Opus音频编码器实现
+ *
+ */
+#include "opus_audio_encoder.h"
+#include "opus.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "OPUS_AUDIO_ENCODER";
+
+/**
+ * @brief Opus编码器结构体
+ */
+struct opus_audio_encoder_t {
+    OpusEncoder *opus_encoder;              ///< Opus编码器句柄
+    opus_audio_encoder_config_t config;     ///< 编码器配置
+    size_t frame_samples;                   ///< 一帧的样本数（所有声道）
+    bool initialized;                       ///< 是否已初始化
+};
+
+/**
+ * @brief 验证采样率是否支持
+ */
+static bool is_valid_sample_rate(int sample_rate)
+{
+    return (sample_rate == 8000 || sample_rate == 12000 || 
+            sample_rate == 16000 || sample_rate == 24000 || sample_rate == 48000);
+}
+
+/**
+ * @brief 验证声道数是否支持
+ */
+static bool is_valid_channels(int channels)
+{
+    return (channels == 1 || channels == 2);
+}
+
+/**
+ * @brief 验证帧长是否支持
+ */
+static bool is_valid_frame_duration(int frame_duration_ms)
+{
+    return (frame_duration_ms == 10 || frame_duration_ms == 20 ||
+            frame_duration_ms == 40 || frame_duration_ms == 60);
+}
+
+opus_audio_encoder_t *opus_audio_encoder_create(const opus_audio_encoder_config_t *config)
+{
+    if (!config) {
+        ESP_LOGE(TAG, "配置参数不能为空");
+        return NULL;
+    }
+
+    // 验证配置参数
+    if (!is_valid_sample_rate(config->sample_rate)) {
+        ESP_LOGE(TAG, "不支持的采样率: %d", config->sample_rate);
+        return NULL;
+    }
+
+    if (!is_valid_channels(config->channels)) {
+        ESP_LOGE(TAG, "不支持的声道数: %d", config->channels);
+        return NULL;
+    }
+
+    if (!is_valid_frame_duration(config->frame_duration_ms)) {
+        ESP_LOGE(TAG, "不支持的帧长: %d ms", config->frame_duration_ms);
+        return NULL;
+    }
+
+    if (config->bitrate <= 0 || config->complexity < 0 || config->complexity > 10) {
+        ESP_LOGE(TAG, "无效的码率或复杂度: %d, %d", config->bitrate, config->complexity);
+        return NULL;
+    }
+
+    // 分配编码器结构体内存
+    opus_audio_encoder_t *encoder = calloc(1, sizeof(opus_audio_encoder_t));
+    if (!encoder) {
+        ESP_LOGE(TAG, "分配编码器内存失败");
+        return NULL;
+    }
+
+    // 复制配置
+    memcpy(&encoder->config, config, sizeof(opus_audio_encoder_config_t));
+    encoder->frame_samples = (size_t)config->sample_rate * config->frame_duration_ms / 1000 * config->channels;
+
+    // 创建Opus编码器，语音模式
+    int error = 0;
+    encoder->opus_encoder = opus_encoder_create(config->sample_rate, config->channels, OPUS_APPLICATION_VOIP, &error);
+    if (error != OPUS_OK || !encoder->opus_encoder) {
+        ESP_LOGE(TAG, "创建Opus编码器失败，错误码: %d", error);
+        free(encoder);
+        return NULL;
+    }
+
+    opus_encoder_ctl(encoder->opus_encoder, OPUS_SET_BITRATE(config->bitrate));
+    opus_encoder_ctl(encoder->opus_encoder, OPUS_SET_COMPLEXITY(config->complexity));
+    opus_encoder_ctl(encoder->opus_encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+
+    encoder->initialized = true;
+    ESP_LOGI(TAG, "Opus编码器创建成功，采样率: %d, 声道数: %d, 码率: %d, 帧长: %d ms", 
+             config->sample_rate, config->channels, config->bitrate, config->frame_duration_ms);
+
+    return encoder;
+}
+
+void opus_audio_encoder_destroy(opus_audio_encoder_t *encoder)
+{
+    if (!encoder) {
+        return;
+    }
+
+    if (encoder->opus_encoder) {
+        opus_encoder_destroy(encoder->opus_encoder);
+        encoder->opus_encoder = NULL;
+    }
+
+    encoder->initialized = false;
+    free(encoder);
+
+    ESP_LOGI(TAG, "Opus编码器已销毁");
+}
+
+esp_err_t opus_audio_encoder_encode(opus_audio_encoder_t *encoder,
+                                   const int16_t *pcm_input,
+                                   size_t pcm_samples,
+                                   uint8_t *opus_output,
+                                   size_t opus_max_len,
+                                   size_t *opus_encoded_len)
+{
+    if (!encoder || !encoder->initialized) {
+        ESP_LOGE(TAG, "编码器未初始化");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!pcm_input || pcm_samples != encoder->frame_samples) {
+        ESP_LOGE(TAG, "PCM输入无效，需要%d样本，实际%d", (int)encoder->frame_samples, (int)pcm_samples);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!opus_output || opus_max_len == 0 || !opus_encoded_len) {
+        ESP_LOGE(TAG, "Opus输出缓冲区无效");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 调用Opus编码
+    int frame_size = pcm_samples / encoder->config.channels;
+    int encoded = opus_encode(encoder->opus_encoder,
+                              pcm_input,
+                              frame_size,
+                              opus_output,
+                              opus_max_len);
+
+    if (encoded < 0) {
+        ESP_LOGE(TAG, "Opus编码失败，错误码: %d", encoded);
+        *opus_encoded_len = 0;
+        return ESP_FAIL;
+    }
+
+    *opus_encoded_len = encoded;
+
+    ESP_LOGD(TAG, "编码成功，输入: %d样本，输出: %d字节", (int)pcm_samples, encoded);
+
+    return ESP_OK;
+}
+
+size_t opus_audio_encoder_get_frame_samples(const opus_audio_encoder_t *encoder)
+{
+    return encoder ? encoder->frame_samples : 0;
+}
+
+esp_err_t opus_audio_encoder_get_config(const opus_audio_encoder_t *encoder,
+                                       opus_audio_encoder_config_t *config)
+{
+    if (!encoder || !config) {
+        ESP_LOGE(TAG, "参数无效");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(config, &encoder->config, sizeof(opus_audio_encoder_config_t));
+    return ESP_OK;
+}
+
+esp_err_t opus_audio_encoder_reset(opus_audio_encoder_t *encoder)
+{
+    if (!encoder || !encoder->initialized) {
+        ESP_LOGE(TAG, "编码器未初始化");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // 重置Opus编码器状态
+    int ret = opus_encoder_ctl(encoder->opus_encoder, OPUS_RESET_STATE);
+    if (ret != OPUS_OK) {
+        ESP_LOGE(TAG, "重置Opus编码器状态失败，错误码: %d", ret);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGD(TAG, "Opus编码器状态已重置");
+    return ESP_OK;
+}
@@ -0,0 +1,176 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 23:30:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 23:30:00
+ * @FilePath: \esp-chunfeng\host_test\bench_base64.c
+ * @Description: base64解码器与mbedtls的差分测试和基准
+ *
+ * 差分测试：随机长度（0~4100字节原文）和随机起始对齐，由mbedtls编码，
+ * 分别用三种方式解码并与 mbedtls_base64_decode 的结果逐字节比较：
+ * - 输出到独立缓冲区；
+ * - 原地解码，dst == src；
+ * - 与 decode_audio_delta 相同的原地解码，dst = src - (src & 3)，dst_len = src_len。
+ * 另外检查省略'='填充的输入、插入非法字符时两者都拒绝、编码结果与mbedtls一致。
+ *
+ * 基准：旧路径为每个delta malloc + mbedtls_base64_decode + free，新路径为原地解码。
+ */
+#include <string.h>
+#include "host_test.h"
+#include "esp_coze_base64.h"
+
+#if HAVE_MBEDTLS_BASE64_H
+#include "mbedtls/base64.h"
+#else
+// 只有运行库没有开发头文件时按 mbedtls/base64.h 的原型声明
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+int mbedtls_base64_decode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+#endif
+
+#define DIFF_ITERATIONS 10000
+#define DIFF_MAX_RAW    4100
+#define DIFF_BUF_SIZE   (ESP_COZE_BASE64_ENCODED_LEN(DIFF_MAX_RAW) + 16)
+
+static uint8_t s_raw[DIFF_MAX_RAW];
+static uint8_t s_enc[DIFF_BUF_SIZE];
+static uint8_t s_ref[DIFF_BUF_SIZE];
+static uint8_t s_out[DIFF_BUF_SIZE];
+static uint8_t s_work[DIFF_BUF_SIZE + 8];
+
+/**
+ * @brief 把编码结果放到 s_work+offset 处原地解码，dst相对src向前偏移back字节
+ */
+static esp_err_t decode_in_place(size_t offset, size_t back, size_t enc_len, size_t dst_len, uint8_t **dst,
+                                 size_t *out_len)
+{
+    char *src = (char *)s_work + offset;
+    memcpy(src, s_enc, enc_len);
+    *dst = (uint8_t *)src - back;
+    return esp_coze_base64_decode(src, enc_len, *dst, dst_len, out_len);
+}
+
+static void test_differential(void)
+{
+    static const uint8_t invalid_chars[] = {'*', '-', '_', '.', '"', '\\', 0x80, 0xFF};
+    uint32_t seed = 0x12345678;
+    unsigned rejected = 0;
+
+    for (int it = 0; it < DIFF_ITERATIONS; it++) {
+        size_t raw_len = host_rand(&seed) % DIFF_MAX_RAW;
+        for (size_t i = 0; i < raw_len; i++) {
+            s_raw[i] = (uint8_t)host_rand(&seed);
+        }
+
+        size_t enc_len = 0;
+        HOST_CHECK(mbedtls_base64_encode(s_enc, sizeof(s_enc), &enc_len, s_raw, raw_len) == 0);
+        HOST_CHECK(esp_coze_base64_encode(s_raw, raw_len, (char *)s_out) == enc_len);
+        HOST_CHECK(memcmp(s_out, s_enc, enc_len) == 0);
+
+        size_t ref_len = 0;
+        HOST_CHECK(mbedtls_base64_decode(s_ref, sizeof(s_ref), &ref_len, s_enc, enc_len) == 0);
+        HOST_CHECK(ref_len == raw_len && memcmp(s_ref, s_raw, raw_len) == 0);
+
+        // 独立输出缓冲区
+        size_t out_len = 0;
+        HOST_CHECK(esp_coze_base64_decode((const char *)s_enc, enc_len, s_out, sizeof(s_out), &out_len) == ESP_OK);
+        HOST_CHECK(out_len == ref_len && memcmp(s_out, s_ref, ref_len) == 0);
+
+        // 原地解码，src起点取0~7的任意对齐
+        size_t offset = 4 + host_rand(&seed) % 8;
+        uint8_t *dst;
+        HOST_CHECK(decode_in_place(offset, 0, enc_len, enc_len, &dst, &out_len) == ESP_OK);
+        HOST_CHECK(out_len == ref_len && memcmp(dst, s_ref, ref_len) == 0);
+
+        // decode_audio_delta 的用法：起点向前对齐到4字节，输出缓冲区大小取base64长度
+        size_t back = (uintptr_t)(s_work + offset) & 3;
+        HOST_CHECK(decode_in_place(offset, back, enc_len, enc_len, &dst, &out_len) == ESP_OK);
+        HOST_CHECK(((uintptr_t)dst & 3) == 0);
+        HOST_CHECK(out_len == ref_len && memcmp(dst, s_ref, ref_len) == 0);
+
+        // 省略'='填充
+        size_t unpadded = enc_len;
+        while (unpadded > 0 && s_enc[unpadded - 1] == '=') {
+            unpadded--;
+        }
+        HOST_CHECK(esp_coze_base64_decode((const char *)s_enc, unpadded, s_out, sizeof(s_out), &out_len) == ESP_OK);
+        HOST_CHECK(out_len == raw_len && memcmp(s_out, s_raw, raw_len) == 0);
+
+        // 非法字符：两者都必须拒绝
+        if (unpadded > 0) {
+            s_enc[host_rand(&seed) % unpadded] = invalid_chars[host_rand(&seed) % sizeof(invalid_chars)];
+            HOST_CHECK(mbedtls_base64_decode(s_ref, sizeof(s_ref), &ref_len, s_enc, enc_len) != 0);
+            HOST_CHECK(esp_coze_base64_decode((const char *)s_enc, enc_len, s_out, sizeof(s_out), &out_len) == ESP_FAIL);
+            rejected++;
+        }
+    }
+
+    // 输出缓冲区不足、长度不合法
+    size_t out_len;
+    HOST_CHECK(esp_coze_base64_decode("QUJD", 4, s_out, 2, &out_len) == ESP_ERR_INVALID_SIZE);
+    HOST_CHECK(esp_coze_base64_decode("QUJDR", 5, s_out, sizeof(s_out), &out_len) == ESP_FAIL);
+    printf("  差分: %d组随机输入与mbedtls一致（含原地解码），%u组非法输入均被拒绝\n", DIFF_ITERATIONS, rejected);
+}
+
+/**
+ * @brief 一次基准：delta_raw字节的音频编码成base64后反复解码
+ *
+ * @param delta_raw 单个delta的音频字节数
+ * @param label 说明
+ */
+static void bench_size(size_t delta_raw, const char *label)
+{
+    const size_t total = 32u * 1024 * 1024; // 每种方式共解码的base64字节数
+    uint32_t seed = 42;
+    for (size_t i = 0; i < delta_raw; i++) {
+        s_raw[i] = (uint8_t)host_rand(&seed);
+    }
+    size_t enc_len = 0;
+    HOST_CHECK(mbedtls_base64_encode(s_enc, sizeof(s_enc), &enc_len, s_raw, delta_raw) == 0);
+    size_t rounds = total / enc_len;
+
+    // 旧路径：与改动前的 handle_audio_delta 相同
+    double t0 = host_now();
+    for (size_t r = 0; r < rounds; r++) {
+        size_t raw_len = (enc_len * 3) / 4 + 4;
+        uint8_t *raw = malloc(raw_len);
+        size_t out_len = 0;
+        HOST_CHECK(mbedtls_base64_decode(raw, raw_len, &out_len, s_enc, enc_len) == 0);
+        host_keep(raw);
+        free(raw);
+    }
+    double t_old = host_now() - t0;
+
+    // 新路径：每轮把base64重新放回消息缓冲区再原地解码，拷贝时间单独扣除
+    char *src = (char *)s_work + 5;
+    uint8_t *dst = (uint8_t *)src - ((uintptr_t)src & 3);
+    t0 = host_now();
+    for (size_t r = 0; r < rounds; r++) {
+        memcpy(src, s_enc, enc_len);
+        host_keep(src);
+    }
+    double t_copy = host_now() - t0;
+    t0 = host_now();
+    for (size_t r = 0; r < rounds; r++) {
+        size_t out_len = 0;
+        memcpy(src, s_enc, enc_len);
+        HOST_CHECK(esp_coze_base64_decode(src, enc_len, dst, enc_len, &out_len) == ESP_OK);
+        host_keep(dst);
+    }
+    double t_new = host_now() - t0 - t_copy;
+
+    printf("  %5zu字节base64（%s）: mbedtls+malloc %7.1f MB/s, 原地查表 %7.1f MB/s, %.1fx\n", enc_len, label,
+           rounds * enc_len / t_old / 1e6, rounds * enc_len / t_new / 1e6, t_old / t_new);
+}
+
+int main(void)
+{
+    printf("正确性\n");
+    test_differential();
+
+    printf("解码速度\n");
+    bench_size(160, "Opus 20ms 64kbps");
+    bench_size(1920, "PCM 40ms 24kHz");
+    bench_size(3072, "大消息");
+    printf("OK\n");
+    return 0;
+}
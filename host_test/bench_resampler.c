@@ -0,0 +1,220 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-18 00:10:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-18 00:10:00
+ * @FilePath: \esp-chunfeng\host_test\bench_resampler.c
+ * @Description: 多相重采样器与旧线性插值的音质和开销对比
+ *
+ * 旧实现是改动前 coze_chat.c 里的 resample_24k_to_16k（每条消息独立做浮点线性插值，不保存状态），
+ * 新实现是 audio_resampler。24kHz -> 16kHz，按下行每条消息480个样本切块：
+ * - 8kHz以下的正弦：THD+N（最小二乘拟合出正弦后残差与信号的功率比）；
+ * - 8kHz以上的正弦：输出中混叠下来的能量，理想应为0；
+ * - 新实现随机切块与一次处理整段的输出必须逐位一致；
+ * - 主机上的吞吐，以及按每次乘加的指令数估算的ESP32-S3负载。
+ */
+#include <math.h>
+#include <string.h>
+#include "host_test.h"
+#include "audio_resampler.h"
+
+#define IN_RATE         24000
+#define OUT_RATE        16000
+#define SIGNAL_LEN      (IN_RATE * 2)
+#define OUT_CAP         (SIGNAL_LEN * OUT_RATE / IN_RATE + 64)
+#define CHUNK_SAMPLES   480             // 与 coze_chat.c 的 DOWNLINK_CHUNK_SAMPLES 相同
+#define SETTLE_SAMPLES  100             // 跳过滤波器起始的暂态
+#define AMPLITUDE       16000.0
+
+// 估算S3负载：每次乘加约4条指令（两次16位取数、MULL、ADD），每个输出另加约20条的循环和饱和开销
+#define XTENSA_INSNS_PER_MAC    4
+#define XTENSA_INSNS_PER_OUTPUT 20
+
+static int16_t s_in[SIGNAL_LEN];
+static int16_t s_old[OUT_CAP];
+static int16_t s_new[OUT_CAP];
+static int16_t s_whole[OUT_CAP];
+
+/**
+ * @brief 改动前的实现，原样保留
+ */
+static size_t resample_24k_to_16k(const int16_t *input, size_t input_samples,
+                                  int16_t *output, size_t output_capacity)
+{
+    if (!input || !output || input_samples == 0 || output_capacity == 0) {
+        return 0;
+    }
+
+    size_t output_samples = (input_samples * 2) / 3;
+    if (output_samples > output_capacity) {
+        output_samples = output_capacity;
+    }
+
+    for (size_t i = 0; i < output_samples; i++) {
+        float input_pos = (float)i * 3.0f / 2.0f;
+        size_t input_idx = (size_t)input_pos;
+        float fraction = input_pos - input_idx;
+
+        if (input_idx >= input_samples - 1) {
+            output[i] = input[input_samples - 1];
+        } else {
+            int16_t sample1 = input[input_idx];
+            int16_t sample2 = input[input_idx + 1];
+            output[i] = (int16_t)(sample1 + fraction * (sample2 - sample1));
+        }
+    }
+
+    return output_samples;
+}
+
+static size_t run_old(const int16_t *in, size_t n, int16_t *out)
+{
+    size_t total = 0;
+    for (size_t off = 0; off < n; off += CHUNK_SAMPLES) {
+        size_t chunk = n - off < CHUNK_SAMPLES ? n - off : CHUNK_SAMPLES;
+        total += resample_24k_to_16k(in + off, chunk, out + total, OUT_CAP - total);
+    }
+    return total;
+}
+
+static size_t run_new(audio_resampler_t *rs, const int16_t *in, size_t n, int16_t *out, uint32_t *seed)
+{
+    size_t total = 0;
+    for (size_t off = 0; off < n;) {
+        size_t chunk = seed ? 1 + host_rand(seed) % 700 : CHUNK_SAMPLES;
+        if (chunk > n - off) {
+            chunk = n - off;
+        }
+        size_t got = 0;
+        HOST_CHECK(audio_resampler_process(rs, in + off, chunk, out + total, OUT_CAP - total, &got) == ESP_OK);
+        total += got;
+        off += chunk;
+    }
+    return total;
+}
+
+/**
+ * @brief THD+N，单位dB
+ */
+static double thd_n_db(const int16_t *y, size_t n, double freq, double fs)
+{
+    double ss = 0, cc = 0, sc = 0, sy = 0, cy = 0;
+    for (size_t i = SETTLE_SAMPLES; i < n; i++) {
+        double s = sin(2 * M_PI * freq * i / fs), c = cos(2 * M_PI * freq * i / fs);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        sy += s * y[i];
+        cy += c * y[i];
+    }
+    double det = ss * cc - sc * sc;
+    double a = (sy * cc - cy * sc) / det, b = (cy * ss - sy * sc) / det;
+    double err = 0, sig = 0;
+    for (size_t i = SETTLE_SAMPLES; i < n; i++) {
+        double m = a * sin(2 * M_PI * freq * i / fs) + b * cos(2 * M_PI * freq * i / fs);
+        err += (y[i] - m) * (y[i] - m);
+        sig += m * m;
+    }
+    return 10 * log10(err / sig);
+}
+
+/**
+ * @brief 输出总功率相对输入正弦功率，单位dB，用于带外输入的混叠
+ */
+static double alias_db(const int16_t *y, size_t n)
+{
+    double p = 0;
+    for (size_t i = SETTLE_SAMPLES; i < n; i++) {
+        p += (double)y[i] * y[i];
+    }
+    return 10 * log10(p / (n - SETTLE_SAMPLES) / (AMPLITUDE * AMPLITUDE / 2) + 1e-30);
+}
+
+static void gen_sine(double freq)
+{
+    for (size_t i = 0; i < SIGNAL_LEN; i++) {
+        s_in[i] = (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * freq * i / IN_RATE));
+    }
+}
+
+static void check_quality(void)
+{
+    static const double in_band[] = {440, 1000, 3000, 6000};
+    static const double out_band[] = {9000, 10000, 11000};
+    uint32_t seed = 7;
+    audio_resampler_t *rs = audio_resampler_create(IN_RATE, OUT_RATE);
+    HOST_CHECK(rs);
+
+    for (size_t k = 0; k < sizeof(in_band) / sizeof(in_band[0]); k++) {
+        gen_sine(in_band[k]);
+        size_t n_old = run_old(s_in, SIGNAL_LEN, s_old);
+        audio_resampler_reset(rs);
+        size_t n_new = run_new(rs, s_in, SIGNAL_LEN, s_new, &seed);
+        audio_resampler_reset(rs);
+        size_t n_whole = run_new(rs, s_in, SIGNAL_LEN, s_whole, NULL);
+        HOST_CHECK(n_new == n_whole && memcmp(s_new, s_whole, n_new * sizeof(int16_t)) == 0);
+
+        double old_db = thd_n_db(s_old, n_old, in_band[k], OUT_RATE);
+        double new_db = thd_n_db(s_new, n_new, in_band[k], OUT_RATE);
+        printf("  %5.0f Hz THD+N: 旧 %6.1f dB, 新 %6.1f dB\n", in_band[k], old_db, new_db);
+        HOST_CHECK(new_db < -50 && new_db < old_db);
+    }
+    for (size_t k = 0; k < sizeof(out_band) / sizeof(out_band[0]); k++) {
+        gen_sine(out_band[k]);
+        size_t n_old = run_old(s_in, SIGNAL_LEN, s_old);
+        audio_resampler_reset(rs);
+        size_t n_new = run_new(rs, s_in, SIGNAL_LEN, s_new, &seed);
+        double old_db = alias_db(s_old, n_old);
+        double new_db = alias_db(s_new, n_new);
+        printf("  %5.0f Hz 混叠: 旧 %6.1f dB, 新 %6.1f dB\n", out_band[k], old_db, new_db);
+        HOST_CHECK(new_db < -40);
+    }
+    printf("  随机切块与整段处理逐位一致\n");
+    audio_resampler_destroy(rs);
+}
+
+static void bench(void)
+{
+    const int rounds = 200;
+    uint32_t seed = 1;
+    for (size_t i = 0; i < SIGNAL_LEN; i++) {
+        s_in[i] = (int16_t)(host_rand(&seed) >> 17);
+    }
+    audio_resampler_t *rs = audio_resampler_create(IN_RATE, OUT_RATE);
+    HOST_CHECK(rs);
+
+    double t0 = host_now();
+    size_t outputs = 0;
+    for (int r = 0; r < rounds; r++) {
+        outputs += run_old(s_in, SIGNAL_LEN, s_old);
+        host_keep(s_old);
+    }
+    double t_old = host_now() - t0;
+
+    t0 = host_now();
+    for (int r = 0; r < rounds; r++) {
+        run_new(rs, s_in, SIGNAL_LEN, s_new, NULL);
+        host_keep(s_new);
+    }
+    double t_new = host_now() - t0;
+    audio_resampler_destroy(rs);
+
+    double audio_sec = (double)rounds * SIGNAL_LEN / IN_RATE;
+    printf("  主机: 旧 %6.1f ns/输出样本（%.0f倍实时），新 %6.1f ns/输出样本（%.0f倍实时）\n",
+           t_old * 1e9 / outputs, audio_sec / t_old, t_new * 1e9 / outputs, audio_sec / t_new);
+
+    double macs = (double)AUDIO_RESAMPLER_TAPS * OUT_RATE;
+    double mips = (AUDIO_RESAMPLER_TAPS * XTENSA_INSNS_PER_MAC + XTENSA_INSNS_PER_OUTPUT) * (double)OUT_RATE / 1e6;
+    printf("  S3估算: 每个输出%d次乘加，%.2f M乘加/秒，约%.1f MIPS（240MHz下约%.1f%%）\n",
+           AUDIO_RESAMPLER_TAPS, macs / 1e6, mips, mips / 240 * 100);
+}
+
+int main(void)
+{
+    printf("24kHz -> 16kHz 音质\n");
+    check_quality();
+    printf("开销\n");
+    bench();
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,424 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 23:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 23:00:00
+ * @FilePath: \esp-chunfeng\host_test\bench_ring_buffer.c
+ * @Description: 环形缓冲区基准与SPSC正确性测试
+ *
+ * 旧实现（互斥锁 + 逐字节 `% size` 拷贝 + 逐字节扫描花括号分帧）原样保留在本文件中作对照，
+ * 与当前的无锁两段memcpy实现比较：
+ * - 字节流：3000字节一块写入再读出，64KB缓冲区，几乎每次都跨越末尾；
+ * - 消息：4KB音频delta，旧实现为 write + read_json_object，新实现为 msg_begin/append/end +
+ *   peek/linearize/commit（原地解析）以及 read_message（整条拷贝）。
+ * 之后用两个线程验证覆盖最老消息时不会读到半截或错乱的消息，统计数与实际一致。
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "host_test.h"
+#include "esp_coze_ring_buffer.h"
+#include "freertos/semphr.h"
+
+#define BENCH_RING_SIZE     (64 * 1024)
+#define BENCH_TOTAL_BYTES   (64u * 1024 * 1024)
+#define BENCH_CHUNK         3000
+#define BENCH_MSG_LEN       4096
+
+/* ---------------- 旧实现（基线版本，仅去掉日志） ---------------- */
+
+typedef struct {
+    uint8_t *buffer;
+    size_t size;
+    volatile size_t write_pos;
+    volatile size_t read_pos;
+    SemaphoreHandle_t mutex;
+    SemaphoreHandle_t data_sem;
+    uint32_t total_overwrites;
+    uint32_t total_overwritten_bytes;
+} legacy_rb_t;
+
+static void legacy_init(legacy_rb_t *rb, size_t size)
+{
+    memset(rb, 0, sizeof(*rb));
+    rb->buffer = malloc(size);
+    rb->size = size;
+    rb->mutex = xSemaphoreCreateMutex();
+    rb->data_sem = xSemaphoreCreateBinary();
+    HOST_CHECK(rb->buffer && rb->mutex && rb->data_sem);
+}
+
+static void legacy_deinit(legacy_rb_t *rb)
+{
+    vSemaphoreDelete(rb->mutex);
+    vSemaphoreDelete(rb->data_sem);
+    free(rb->buffer);
+}
+
+static esp_err_t legacy_write(legacy_rb_t *rb, const uint8_t *data, size_t len)
+{
+    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    size_t overwritten_bytes = 0;
+    for (size_t i = 0; i < len; i++) {
+        rb->buffer[rb->write_pos] = data[i];
+        rb->write_pos = (rb->write_pos + 1) % rb->size;
+        if (rb->write_pos == rb->read_pos) {
+            rb->read_pos = (rb->read_pos + 1) % rb->size;
+            overwritten_bytes++;
+            rb->total_overwritten_bytes++;
+        }
+    }
+    if (overwritten_bytes > 0) {
+        rb->total_overwrites++;
+    }
+    xSemaphoreGive(rb->mutex);
+    xSemaphoreGive(rb->data_sem);
+    return ESP_OK;
+}
+
+static esp_err_t legacy_read(legacy_rb_t *rb, uint8_t *out, size_t max_len, size_t *out_len)
+{
+    *out_len = 0;
+    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(50)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    size_t available = rb->write_pos >= rb->read_pos ? rb->write_pos - rb->read_pos
+                       : rb->size - rb->read_pos + rb->write_pos;
+    size_t to_read = available < max_len ? available : max_len;
+    for (size_t i = 0; i < to_read; ++i) {
+        out[i] = rb->buffer[rb->read_pos];
+        rb->read_pos = (rb->read_pos + 1) % rb->size;
+    }
+    xSemaphoreGive(rb->mutex);
+    *out_len = to_read;
+    return to_read > 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t legacy_read_json_object(legacy_rb_t *rb, uint8_t *data, size_t max_len, size_t *actual_len)
+{
+    *actual_len = 0;
+    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    size_t temp_read_pos = rb->read_pos;
+    size_t json_len = 0;
+    int brace_count = 0;
+    bool found_start = false;
+    bool in_string = false;
+    bool escape_next = false;
+
+    while (temp_read_pos != rb->write_pos && json_len < max_len - 1) {
+        uint8_t ch = rb->buffer[temp_read_pos];
+        temp_read_pos = (temp_read_pos + 1) % rb->size;
+        json_len++;
+        if (escape_next) {
+            escape_next = false;
+            continue;
+        }
+        if (ch == '\\') {
+            escape_next = true;
+            continue;
+        }
+        if (ch == '"') {
+            in_string = !in_string;
+            continue;
+        }
+        if (!in_string) {
+            if (ch == '{') {
+                brace_count++;
+                found_start = true;
+            } else if (ch == '}' && found_start) {
+                if (--brace_count == 0) {
+                    break;
+                }
+            }
+        }
+    }
+    if (!found_start || brace_count != 0) {
+        xSemaphoreGive(rb->mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (size_t i = 0; i < json_len; i++) {
+        data[i] = rb->buffer[rb->read_pos];
+        rb->read_pos = (rb->read_pos + 1) % rb->size;
+    }
+    data[json_len] = '\0';
+    *actual_len = json_len;
+    xSemaphoreGive(rb->mutex);
+    return ESP_OK;
+}
+
+/* ---------------- 基准 ---------------- */
+
+static uint8_t s_src[BENCH_MSG_LEN + BENCH_CHUNK];
+static uint8_t s_dst[BENCH_MSG_LEN + BENCH_CHUNK];
+
+/**
+ * @brief 构造一条与服务端下发格式相同的音频delta，content为base64字符
+ */
+static void make_audio_delta(uint8_t *msg, size_t len)
+{
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char head[] = "{\"id\":\"7\",\"event_type\":\"conversation.audio.delta\",\"data\":{\"content\":\"";
+    static const char tail[] = "\"}}";
+    uint32_t seed = 1;
+    memcpy(msg, head, sizeof(head) - 1);
+    for (size_t i = sizeof(head) - 1; i < len - (sizeof(tail) - 1); i++) {
+        msg[i] = (uint8_t)b64[host_rand(&seed) & 63];
+    }
+    memcpy(msg + len - (sizeof(tail) - 1), tail, sizeof(tail) - 1);
+}
+
+static void report(const char *name, double seconds, double legacy_seconds)
+{
+    char speedup[16] = "";
+    if (legacy_seconds > 0) {
+        snprintf(speedup, sizeof(speedup), "%.1fx", legacy_seconds / seconds);
+    }
+    printf("  %9.1f MB/s %7s  %s\n", BENCH_TOTAL_BYTES / seconds / 1e6, speedup, name);
+}
+
+static double bench_stream_legacy(void)
+{
+    legacy_rb_t rb;
+    legacy_init(&rb, BENCH_RING_SIZE);
+    double t0 = host_now();
+    for (size_t done = 0; done < BENCH_TOTAL_BYTES; done += BENCH_CHUNK) {
+        size_t n;
+        legacy_write(&rb, s_src, BENCH_CHUNK);
+        legacy_read(&rb, s_dst, BENCH_CHUNK, &n);
+        HOST_CHECK(n == BENCH_CHUNK);
+    }
+    double t = host_now() - t0;
+    host_keep(s_dst);
+    legacy_deinit(&rb);
+    return t;
+}
+
+static double bench_stream_spsc(void)
+{
+    esp_coze_ring_buffer_t rb = {0};
+    HOST_CHECK(esp_coze_ring_buffer_init(&rb, BENCH_RING_SIZE) == ESP_OK);
+    double t0 = host_now();
+    for (size_t done = 0; done < BENCH_TOTAL_BYTES; done += BENCH_CHUNK) {
+        size_t n;
+        esp_coze_ring_buffer_write(&rb, s_src, BENCH_CHUNK);
+        esp_coze_ring_buffer_read(&rb, s_dst, BENCH_CHUNK, &n, 0);
+        HOST_CHECK(n == BENCH_CHUNK);
+    }
+    double t = host_now() - t0;
+    host_keep(s_dst);
+    esp_coze_ring_buffer_deinit(&rb);
+    return t;
+}
+
+static double bench_msg_legacy(void)
+{
+    legacy_rb_t rb;
+    legacy_init(&rb, BENCH_RING_SIZE);
+    double t0 = host_now();
+    for (size_t done = 0; done < BENCH_TOTAL_BYTES; done += BENCH_MSG_LEN) {
+        size_t n;
+        legacy_write(&rb, s_src, BENCH_MSG_LEN);
+        HOST_CHECK(legacy_read_json_object(&rb, s_dst, sizeof(s_dst), &n) == ESP_OK && n == BENCH_MSG_LEN);
+    }
+    double t = host_now() - t0;
+    host_keep(s_dst);
+    legacy_deinit(&rb);
+    return t;
+}
+
+static double bench_msg_peek(void)
+{
+    esp_coze_ring_buffer_t rb = {0};
+    HOST_CHECK(esp_coze_ring_buffer_init(&rb, BENCH_RING_SIZE) == ESP_OK);
+    double t0 = host_now();
+    for (size_t done = 0; done < BENCH_TOTAL_BYTES; done += BENCH_MSG_LEN) {
+        esp_coze_ring_buffer_msg_view_t view;
+        esp_coze_ring_buffer_msg_begin(&rb, BENCH_MSG_LEN);
+        esp_coze_ring_buffer_msg_append(&rb, s_src, BENCH_MSG_LEN);
+        esp_coze_ring_buffer_msg_end(&rb);
+        HOST_CHECK(esp_coze_ring_buffer_peek_message(&rb, &view) == ESP_OK && view.len == BENCH_MSG_LEN);
+        // 解析任务的做法：未回绕的消息直接用，回绕的才拼接
+        const uint8_t *msg = esp_coze_ring_buffer_view_linearize(&view, s_dst, sizeof(s_dst));
+        HOST_CHECK(msg != NULL);
+        host_keep(msg);
+        esp_coze_ring_buffer_commit_message(&rb, &view);
+    }
+    double t = host_now() - t0;
+    esp_coze_ring_buffer_deinit(&rb);
+    return t;
+}
+
+static double bench_msg_copy(void)
+{
+    esp_coze_ring_buffer_t rb = {0};
+    HOST_CHECK(esp_coze_ring_buffer_init(&rb, BENCH_RING_SIZE) == ESP_OK);
+    double t0 = host_now();
+    for (size_t done = 0; done < BENCH_TOTAL_BYTES; done += BENCH_MSG_LEN) {
+        size_t n;
+        esp_coze_ring_buffer_msg_begin(&rb, BENCH_MSG_LEN);
+        esp_coze_ring_buffer_msg_append(&rb, s_src, BENCH_MSG_LEN);
+        esp_coze_ring_buffer_msg_end(&rb);
+        HOST_CHECK(esp_coze_ring_buffer_read_message(&rb, s_dst, sizeof(s_dst), &n) == ESP_OK && n == BENCH_MSG_LEN);
+    }
+    double t = host_now() - t0;
+    host_keep(s_dst);
+    esp_coze_ring_buffer_deinit(&rb);
+    return t;
+}
+
+/* ---------------- 正确性 ---------------- */
+
+/**
+ * @brief 字节流覆盖：写入超过容量后只剩最新的size字节，覆盖统计与丢掉的字节数一致
+ */
+static void test_stream_overwrite(void)
+{
+    const size_t size = 4096;
+    const size_t total = 10000;
+    esp_coze_ring_buffer_t rb = {0};
+    HOST_CHECK(esp_coze_ring_buffer_init(&rb, size) == ESP_OK);
+
+    uint8_t chunk[1000];
+    for (size_t done = 0; done < total; done += sizeof(chunk)) {
+        for (size_t i = 0; i < sizeof(chunk); i++) {
+            chunk[i] = (uint8_t)(done + i);
+        }
+        HOST_CHECK(esp_coze_ring_buffer_write(&rb, chunk, sizeof(chunk)) == ESP_OK);
+    }
+
+    uint32_t overwrites, overwritten_bytes;
+    esp_coze_ring_buffer_get_overwrite_stats(&rb, &overwrites, &overwritten_bytes);
+    size_t available = esp_coze_ring_buffer_available(&rb);
+    HOST_CHECK(available + overwritten_bytes == total);
+    HOST_CHECK(overwrites > 0);
+
+    uint8_t out[4096];
+    size_t n = 0;
+    HOST_CHECK(esp_coze_ring_buffer_read(&rb, out, sizeof(out), &n, 0) == ESP_OK && n == available);
+    for (size_t i = 0; i < n; i++) {
+        HOST_CHECK(out[i] == (uint8_t)(overwritten_bytes + i));
+    }
+    esp_coze_ring_buffer_deinit(&rb);
+    printf("  字节流覆盖: 写入%zu, 保留%zu, 覆盖%u字节/%u次\n", total, available,
+           (unsigned)overwritten_bytes, (unsigned)overwrites);
+}
+
+#define SPSC_RING_SIZE      (16 * 1024)
+#define SPSC_MESSAGES       200000
+#define SPSC_MAX_MSG_LEN    3000
+
+static esp_coze_ring_buffer_t s_spsc_rb;
+static volatile int s_producer_done;
+
+static size_t spsc_msg_len(uint32_t seq)
+{
+    uint32_t s = seq * 2654435761u + 1;
+    return 8 + host_rand(&s) % (SPSC_MAX_MSG_LEN - 8);
+}
+
+static void *spsc_producer(void *arg)
+{
+    uint8_t msg[SPSC_MAX_MSG_LEN];
+    for (uint32_t seq = 0; seq < SPSC_MESSAGES; seq++) {
+        size_t len = spsc_msg_len(seq);
+        memcpy(msg, &seq, sizeof(seq));
+        for (size_t i = sizeof(seq); i < len; i++) {
+            msg[i] = (uint8_t)(seq + i);
+        }
+        // 分两段追加，模拟WebSocket分片
+        size_t half = len / 2;
+        esp_coze_ring_buffer_msg_begin(&s_spsc_rb, len);
+        esp_coze_ring_buffer_msg_append(&s_spsc_rb, msg, half);
+        esp_coze_ring_buffer_msg_append(&s_spsc_rb, msg + half, len - half);
+        esp_coze_ring_buffer_msg_end(&s_spsc_rb);
+        // 时不时让出CPU，单核主机上也能让覆盖和正常读取交替发生
+        if (seq % 8 == 0) {
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&s_producer_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief 两个线程并发读写，缓冲区只有16KB，生产者不停覆盖最老的消息
+ *
+ * 每条收到的消息都必须完整（长度和内容与序号对应）、序号递增；
+ * 收到 + 被覆盖 + 被丢弃 的消息数等于发出的消息数。
+ */
+static void test_spsc_messages(void)
+{
+    HOST_CHECK(esp_coze_ring_buffer_init(&s_spsc_rb, SPSC_RING_SIZE) == ESP_OK);
+    s_producer_done = 0;
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, spsc_producer, NULL);
+
+    static uint8_t scratch[SPSC_MAX_MSG_LEN];
+    uint32_t received = 0, wrapped = 0;
+    int64_t last_seq = -1;
+    for (;;) {
+        // 先读完成标志再查看：生产者结束之后仍然取不到消息，才说明已经全部读完
+        bool done = __atomic_load_n(&s_producer_done, __ATOMIC_ACQUIRE);
+        esp_coze_ring_buffer_msg_view_t view;
+        if (esp_coze_ring_buffer_peek_message(&s_spsc_rb, &view) != ESP_OK) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        const uint8_t *msg = esp_coze_ring_buffer_view_linearize(&view, scratch, sizeof(scratch));
+        HOST_CHECK(msg != NULL);
+        uint32_t seq;
+        memcpy(&seq, msg, sizeof(seq));
+        HOST_CHECK((int64_t)seq > last_seq && seq < SPSC_MESSAGES);
+        HOST_CHECK(view.len == spsc_msg_len(seq));
+        for (size_t i = sizeof(seq); i < view.len; i++) {
+            HOST_CHECK(msg[i] == (uint8_t)(seq + i));
+        }
+        wrapped += view.seg[1] != NULL;
+        last_seq = seq;
+        received++;
+        HOST_CHECK(esp_coze_ring_buffer_commit_message(&s_spsc_rb, &view) == ESP_OK);
+    }
+    pthread_join(producer, NULL);
+
+    esp_coze_ring_buffer_msg_stats_t st;
+    esp_coze_ring_buffer_get_msg_stats(&s_spsc_rb, &st);
+    HOST_CHECK(st.truncated == 0 && st.oversize == 0);
+    HOST_CHECK(st.committed + st.dropped == SPSC_MESSAGES);
+    HOST_CHECK(received + st.overwritten + st.dropped == SPSC_MESSAGES);
+    esp_coze_ring_buffer_deinit(&s_spsc_rb);
+    printf("  SPSC消息: 发出%u, 收到%u（回绕%u）, 覆盖%u, 丢弃%u\n", (unsigned)SPSC_MESSAGES,
+           (unsigned)received, (unsigned)wrapped, (unsigned)st.overwritten, (unsigned)st.dropped);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(s_src); i++) {
+        s_src[i] = (uint8_t)(i * 7);
+    }
+
+    printf("字节流（%d字节一块，%dKB缓冲区）\n", BENCH_CHUNK, BENCH_RING_SIZE / 1024);
+    double legacy = bench_stream_legacy();
+    report("旧: 互斥锁 + 逐字节拷贝", legacy, 0);
+    report("新: 无锁SPSC + 两段memcpy", bench_stream_spsc(), legacy);
+
+    make_audio_delta(s_src, BENCH_MSG_LEN);
+    printf("消息（%d字节音频delta）\n", BENCH_MSG_LEN);
+    legacy = bench_msg_legacy();
+    report("旧: write + read_json_object", legacy, 0);
+    report("新: msg_begin/append/end + peek/commit", bench_msg_peek(), legacy);
+    report("新: msg_begin/append/end + read_message", bench_msg_copy(), legacy);
+
+    printf("正确性\n");
+    test_stream_overwrite();
+    test_spsc_messages();
+    printf("OK\n");
+    return 0;
+}
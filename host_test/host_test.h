@@ -0,0 +1,56 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 23:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 23:00:00
+ * @FilePath: \esp-chunfeng\host_test\host_test.h
+ * @Description: 主机测试公共工具：断言、计时和可复现的伪随机数
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief 条件不成立时打印位置并以失败退出，ctest据此判定用例失败
+ */
+#define HOST_CHECK(cond) do {                                                   \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+/**
+ * @brief 单调时钟，单位秒
+ */
+static inline double host_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief xorshift32伪随机数，固定种子保证每次运行的输入相同
+ */
+static inline uint32_t host_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief 防止编译器把被测调用的结果当作无用计算优化掉
+ */
+static inline void host_keep(const void *p)
+{
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
@@ -0,0 +1,13 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 23:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 23:00:00
+ * @FilePath: \esp-chunfeng\host_test\stubs\esp_attr.h
+ * @Description: 主机测试用的 esp_attr.h 替身
+ *
+ */
+#pragma once
+
+#define IRAM_ATTR
+#define EXT_RAM_BSS_ATTR
@@ -0,0 +1,28 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-18 00:30:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-18 00:30:00
+ * @FilePath: \esp-chunfeng\host_test\stubs\esp_check.h
+ * @Description: 主机测试用的 esp_check.h 替身
+ *
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define ESP_RETURN_ON_ERROR(x, tag, fmt, ...) do {                  \
+        esp_err_t err_rc_ = (x);                                    \
+        if (err_rc_ != ESP_OK) {                                    \
+            ESP_LOGE(tag, "%s(%d): " fmt, __func__, __LINE__, ##__VA_ARGS__); \
+            return err_rc_;                                         \
+        }                                                           \
+    } while (0)
+
+#define ESP_RETURN_ON_FALSE(a, err_code, tag, fmt, ...) do {        \
+        if (!(a)) {                                                 \
+            ESP_LOGE(tag, "%s(%d): " fmt, __func__, __LINE__, ##__VA_ARGS__); \
+            return err_code;                                        \
+        }                                                           \
+    } while (0)
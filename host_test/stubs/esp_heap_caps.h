@@ -0,0 +1,41 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 23:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 23:00:00
+ * @FilePath: \esp-chunfeng\host_test\stubs\esp_heap_caps.h
+ * @Description: 主机测试用的 esp_heap_caps.h 替身，所有内存能力都映射到malloc
+ *
+ */
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+
+static inline void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+static inline void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+static inline bool esp_ptr_external_ram(const void *ptr)
+{
+    (void)ptr;
+    return false;
+}
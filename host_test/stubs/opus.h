@@ -0,0 +1,27 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-18 00:30:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-18 00:30:00
+ * @FilePath: \esp-chunfeng\host_test\stubs\opus.h
+ * @Description: 主机测试用的 opus.h 替身，只声明解码器用到的接口，实现由各测试自己提供
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef int16_t opus_int16;
+typedef int32_t opus_int32;
+typedef struct OpusDecoder OpusDecoder;
+
+#define OPUS_OK             0
+#define OPUS_BAD_ARG        -1
+#define OPUS_INVALID_PACKET -4
+#define OPUS_RESET_STATE    4028
+
+OpusDecoder *opus_decoder_create(opus_int32 fs, int channels, int *error);
+void opus_decoder_destroy(OpusDecoder *st);
+int opus_decode(OpusDecoder *st, const unsigned char *data, opus_int32 len, opus_int16 *pcm, int frame_size,
+                int decode_fec);
+int opus_decoder_ctl(OpusDecoder *st, int request, ...);
@@ -0,0 +1,147 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 23:45:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 23:45:00
+ * @FilePath: \esp-chunfeng\host_test\test_audio_dsp.c
+ * @Description: 麦克风转换内核与参考实现的逐位一致性测试
+ *
+ * 对每组输入和多种增益，audio_dsp_mic_convert 按随机切块（包括奇数长度和不足4个样本的块）
+ * 连续处理，状态跨块保存；audio_dsp_mic_convert_ref 一次处理整段。两者输出和最终状态必须完全相同。
+ * 另外验证原地转换（out与in指向同一块内存）以及隔直滤波确实去掉了直流。
+ */
+#include <string.h>
+#include "host_test.h"
+#include "audio_dsp.h"
+
+#define SIGNAL_LEN 48000
+
+static int32_t s_in[SIGNAL_LEN];
+static int32_t s_inplace[SIGNAL_LEN];
+static int16_t s_out[SIGNAL_LEN];
+static int16_t s_ref[SIGNAL_LEN];
+
+typedef void (*signal_gen_t)(int32_t *x, size_t n, uint32_t *seed);
+
+static void gen_random(int32_t *x, size_t n, uint32_t *seed)
+{
+    // I2S的24位数据左对齐在32位里，低8位为0
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (int32_t)(host_rand(seed) & 0xFFFFFF00u);
+    }
+}
+
+static void gen_full_scale(int32_t *x, size_t n, uint32_t *seed)
+{
+    // ±2^31满幅：交替极值、连续极值和完全随机的32位值混在一起
+    for (size_t i = 0; i < n; i++) {
+        switch ((i / 1000) % 3) {
+        case 0:
+            x[i] = (i & 1) ? INT32_MAX : INT32_MIN;
+            break;
+        case 1:
+            x[i] = ((i / 100) & 1) ? INT32_MAX : INT32_MIN;
+            break;
+        default:
+            x[i] = (int32_t)host_rand(seed);
+            break;
+        }
+    }
+}
+
+static void gen_dc_step(int32_t *x, size_t n, uint32_t *seed)
+{
+    // 静音 -> 正向大直流 -> 负向直流，叠加少量噪声
+    for (size_t i = 0; i < n; i++) {
+        int32_t dc = i < n / 4 ? 0 : i < n / 2 ? (1 << 29) : -(1 << 30);
+        x[i] = dc + (int32_t)(host_rand(seed) & 0xFFFF) - 0x8000;
+    }
+}
+
+static void gen_sine(int32_t *x, size_t n, uint32_t *seed)
+{
+    // 1kHz@16kHz正弦加直流偏置，用整数相位表避免依赖libm的舍入
+    static const int32_t quarter[5] = {0, 382683, 707107, 923880, 1000000};
+    (void)seed;
+    for (size_t i = 0; i < n; i++) {
+        size_t p = i % 16;
+        int32_t v = p <= 4 ? quarter[p] : p <= 8 ? quarter[8 - p] : p <= 12 ? -quarter[p - 8] : -quarter[16 - p];
+        x[i] = v * 1000 + (1 << 27);
+    }
+}
+
+static void check_one(const char *name, signal_gen_t gen, int32_t gain, uint32_t *seed)
+{
+    gen(s_in, SIGNAL_LEN, seed);
+
+    audio_dsp_mic_state_t ref_st, st;
+    audio_dsp_mic_init(&ref_st, gain);
+    audio_dsp_mic_init(&st, gain);
+    audio_dsp_mic_convert_ref(&ref_st, s_in, s_ref, SIGNAL_LEN);
+
+    // 随机切块，块长0~1023，包含大量奇数长度和1~3个样本的尾块
+    memset(s_out, 0x55, sizeof(s_out));
+    size_t pos = 0, chunks = 0;
+    while (pos < SIGNAL_LEN) {
+        size_t n = host_rand(seed) % 1024;
+        if (n > SIGNAL_LEN - pos) {
+            n = SIGNAL_LEN - pos;
+        }
+        audio_dsp_mic_convert(&st, s_in + pos, s_out + pos, n);
+        pos += n;
+        chunks++;
+    }
+    HOST_CHECK(memcmp(s_out, s_ref, sizeof(s_ref)) == 0);
+    HOST_CHECK(st.x1 == ref_st.x1 && st.y1 == ref_st.y1);
+
+    // 原地转换：头文件约定out可以与in指向同一块内存
+    memcpy(s_inplace, s_in, sizeof(s_in));
+    audio_dsp_mic_init(&st, gain);
+    audio_dsp_mic_convert(&st, s_inplace, (int16_t *)s_inplace, SIGNAL_LEN);
+    HOST_CHECK(memcmp(s_inplace, s_ref, sizeof(s_ref)) == 0);
+
+    printf("  %-10s 增益%-5.2f %5zu块 一致\n", name, gain / (double)AUDIO_DSP_GAIN_ONE, chunks);
+}
+
+/**
+ * @brief 隔直：大直流阶跃之后约1秒，输出回到零附近
+ */
+static void check_dc_removed(void)
+{
+    audio_dsp_mic_state_t st;
+    audio_dsp_mic_init(&st, AUDIO_DSP_GAIN_ONE);
+    for (size_t i = 0; i < SIGNAL_LEN; i++) {
+        s_in[i] = 1 << 29;
+    }
+    audio_dsp_mic_convert(&st, s_in, s_out, SIGNAL_LEN);
+    HOST_CHECK(s_out[0] > 8000);
+    for (size_t i = 16000; i < SIGNAL_LEN; i++) {
+        HOST_CHECK(s_out[i] >= -1 && s_out[i] <= 1);
+    }
+    printf("  直流阶跃 1秒后残留 %d\n", s_out[SIGNAL_LEN - 1]);
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        signal_gen_t gen;
+    } signals[] = {
+        {"随机", gen_random},
+        {"满幅", gen_full_scale},
+        {"直流阶跃", gen_dc_step},
+        {"正弦+直流", gen_sine},
+    };
+    static const int32_t gains[] = {AUDIO_DSP_GAIN_ONE, AUDIO_DSP_GAIN_ONE / 4, AUDIO_DSP_GAIN_ONE * 4, 4095};
+
+    uint32_t seed = 2024;
+    printf("优化实现 vs 参考实现\n");
+    for (size_t s = 0; s < sizeof(signals) / sizeof(signals[0]); s++) {
+        for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+            check_one(signals[s].name, signals[s].gen, gains[g], &seed);
+        }
+    }
+    check_dc_removed();
+    printf("OK\n");
+    return 0;
+}
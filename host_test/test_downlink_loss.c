@@ -0,0 +1,344 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-18 00:30:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-18 00:30:00
+ * @FilePath: \esp-chunfeng\host_test\test_downlink_loss.c
+ * @Description: 下行丢包时的补帧测试：环形缓冲区丢消息，统计音频缺口和多补的时长
+ *
+ * 一段60秒的20ms分帧音频按服务端的格式编成音频delta，中间穿插长短不一的文本delta，
+ * 写入一个很小的环形缓冲区；消费者不时卡顿，缓冲区按“覆盖最老消息”丢掉两种消息，
+ * 另有少量音频delta的base64被破坏而解码失败。消费者按 esp_coze_chat.c 的规则补帧：
+ * 两个音频delta之间丢失的帧数 = 解码失败数 + 环形缓冲区丢失数，最多补3帧，
+ * 用 opus_audio_decoder_decode_with_loss 解码。对比两种丢失数的来源：
+ * - 只统计带音频标记的消息（tagged_lost）；
+ * - 统计所有丢失的消息（改动前的做法）。
+ * 按每个delta带的序号算出真实丢了几帧，报告没补上的缺口（断音）和补多了的帧（多出的时长、延迟累积）。
+ *
+ * 主机上没有libopus，这里用一个假的解码器：包里直接是本帧的PCM，后面附上一帧的粗量化副本作为带内FEC，
+ * PLC重复上一帧并减半。
+ */
+#include <math.h>
+#include <string.h>
+#include "host_test.h"
+#include "opus.h"
+#include "opus_audio_decoder.h"
+#include "esp_coze_base64.h"
+#include "esp_coze_json_scan.h"
+#include "esp_coze_ring_buffer.h"
+
+#define SAMPLE_RATE     16000
+#define FRAME_SAMPLES   320                 // 20ms
+#define FRAME_MS        20
+#define AUDIO_FRAMES    3000                // 60秒
+#define MAX_CONCEAL     3                   // 与 esp_coze_chat.c 的 DL_MAX_CONCEAL_FRAMES 相同
+#define RING_SIZE       (16 * 1024)
+#define MSG_MAX         8192
+#define WS_CHUNK        1024                // WebSocket客户端每次回调的数据量
+#define TYPE_SCAN_LEN   256                 // 与 esp_coze_chat.c 的 DL_EVENT_TYPE_SCAN_LEN 相同
+
+// 假包：TOC + 本帧PCM + 上一帧的FEC副本
+#define PKT_TOC         0x08                // 配置号1（SILK），带FEC
+#define PKT_LEN         (1 + 2 * FRAME_SAMPLES * (int)sizeof(int16_t))
+
+/* ---------------- 假libopus ---------------- */
+
+struct OpusDecoder {
+    opus_int16 last[FRAME_SAMPLES];
+};
+
+OpusDecoder *opus_decoder_create(opus_int32 fs, int channels, int *error)
+{
+    *error = OPUS_OK;
+    return calloc(1, sizeof(OpusDecoder));
+}
+
+void opus_decoder_destroy(OpusDecoder *st)
+{
+    free(st);
+}
+
+int opus_decoder_ctl(OpusDecoder *st, int request, ...)
+{
+    if (request == OPUS_RESET_STATE) {
+        memset(st->last, 0, sizeof(st->last));
+    }
+    return OPUS_OK;
+}
+
+int opus_decode(OpusDecoder *st, const unsigned char *data, opus_int32 len, opus_int16 *pcm, int frame_size,
+                int decode_fec)
+{
+    if (frame_size < FRAME_SAMPLES) {
+        return OPUS_BAD_ARG;
+    }
+    if (!data) {
+        for (int i = 0; i < FRAME_SAMPLES; i++) {
+            st->last[i] /= 2;
+        }
+    } else {
+        if (len != PKT_LEN || data[0] != PKT_TOC) {
+            return OPUS_INVALID_PACKET;
+        }
+        const unsigned char *src = data + 1 + (decode_fec ? FRAME_SAMPLES * sizeof(int16_t) : 0);
+        memcpy(st->last, src, sizeof(st->last));
+    }
+    memcpy(pcm, st->last, sizeof(st->last));
+    return FRAME_SAMPLES;
+}
+
+/* ---------------- 下行消息 ---------------- */
+
+static int16_t s_source[(AUDIO_FRAMES + 1) * FRAME_SAMPLES];
+
+/**
+ * @brief 录音替身：基频在120~220Hz之间滑动的浊音，带音节包络
+ */
+static void gen_source(void)
+{
+    double phase = 0;
+    for (size_t i = 0; i < sizeof(s_source) / sizeof(s_source[0]); i++) {
+        double t = (double)i / SAMPLE_RATE;
+        double f0 = 170 + 50 * sin(2 * M_PI * 0.7 * t);
+        phase += 2 * M_PI * f0 / SAMPLE_RATE;
+        double env = 0.5 + 0.5 * sin(2 * M_PI * 4 * t);
+        double v = sin(phase) + 0.5 * sin(2 * phase) + 0.25 * sin(3 * phase);
+        s_source[i] = (int16_t)lrint(8000 * env * v);
+    }
+}
+
+/**
+ * @brief 第seq帧的音频delta；corrupt时在base64中间插一个非法字符
+ */
+static size_t make_audio_msg(char *msg, uint32_t seq, bool corrupt)
+{
+    static uint8_t pkt[PKT_LEN];
+    static char b64[ESP_COZE_BASE64_ENCODED_LEN(PKT_LEN) + 1];
+    pkt[0] = PKT_TOC;
+    memcpy(pkt + 1, &s_source[(seq + 1) * FRAME_SAMPLES], FRAME_SAMPLES * sizeof(int16_t));
+    // FEC副本去掉低4位，模拟LBRR的低码率
+    int16_t *fec = (int16_t *)(pkt + 1 + FRAME_SAMPLES * sizeof(int16_t));
+    for (int i = 0; i < FRAME_SAMPLES; i++) {
+        fec[i] = (int16_t)(s_source[seq * FRAME_SAMPLES + i] & ~0xF);
+    }
+    size_t n = esp_coze_base64_encode(pkt, PKT_LEN, b64);
+    b64[n] = '\0';
+    if (corrupt) {
+        b64[n / 2] = '*';
+    }
+    return (size_t)snprintf(msg, MSG_MAX,
+                            "{\"id\":\"evt_a%u\",\"event_type\":\"conversation.audio.delta\",\"data\":{"
+                            "\"id\":\"msg_1\",\"role\":\"assistant\",\"type\":\"answer\",\"content\":\"%s\","
+                            "\"content_type\":\"audio\",\"chat_id\":\"chat_1\",\"seq\":%u}}",
+                            (unsigned)seq, b64, (unsigned)seq);
+}
+
+static size_t make_text_msg(char *msg, uint32_t n, uint32_t *seed)
+{
+    char text[1600];
+    size_t len = 100 + host_rand(seed) % 1400;
+    for (size_t i = 0; i < len; i++) {
+        text[i] = (char)('a' + host_rand(seed) % 26);
+    }
+    text[len] = '\0';
+    return (size_t)snprintf(msg, MSG_MAX,
+                            "{\"id\":\"evt_t%u\",\"event_type\":\"conversation.message.delta\",\"data\":{"
+                            "\"role\":\"assistant\",\"type\":\"answer\",\"content\":\"%s\",\"content_type\":\"text\"}}",
+                            (unsigned)n, text);
+}
+
+/**
+ * @brief 按WebSocket任务的方式入队：第一块里看到音频delta就打标记，之后分块追加
+ */
+static void ws_enqueue(esp_coze_ring_buffer_t *rb, const char *msg, size_t len)
+{
+    static const char *const keys[] = {"event_type"};
+    esp_coze_json_span_t type;
+    size_t head = len < WS_CHUNK ? len : WS_CHUNK;
+    if (head > TYPE_SCAN_LEN) {
+        head = TYPE_SCAN_LEN;
+    }
+
+    HOST_CHECK(esp_coze_ring_buffer_msg_begin(rb, len) == ESP_OK);
+    if (esp_coze_json_scan_object(msg, head, keys, 1, &type) == ESP_OK &&
+            esp_coze_json_span_equals(&type, "conversation.audio.delta")) {
+        HOST_CHECK(esp_coze_ring_buffer_msg_tag(rb) == ESP_OK);
+    }
+    for (size_t off = 0; off < len; off += WS_CHUNK) {
+        esp_coze_ring_buffer_msg_append(rb, (const uint8_t *)msg + off, len - off < WS_CHUNK ? len - off : WS_CHUNK);
+    }
+    esp_coze_ring_buffer_msg_end(rb);
+}
+
+/* ---------------- 消费者 ---------------- */
+
+typedef struct {
+    bool tagged_only;           ///< true只统计音频丢失，false统计所有丢失
+    opus_audio_decoder_t *dec;
+    uint32_t ring_lost;         ///< 上次统计时的丢失数
+    uint32_t pending;           ///< 解码失败等待补的帧数
+    int64_t last_seq;           ///< 上一个解出的delta序号
+    uint32_t played;            ///< 正常解码的帧数
+    uint32_t corrupt;           ///< base64解码失败的帧数
+    uint32_t truly_lost;        ///< 真实丢失的帧数
+    uint32_t uncovered;         ///< 没补上的帧数（断音）
+    uint32_t spurious;          ///< 补多了的帧数（多出的时长）
+    uint32_t longest_gap;       ///< 最长的断音帧数
+} consumer_t;
+
+static uint32_t ring_lost_now(esp_coze_ring_buffer_t *rb, bool tagged_only)
+{
+    esp_coze_ring_buffer_msg_stats_t st;
+    HOST_CHECK(esp_coze_ring_buffer_get_msg_stats(rb, &st) == ESP_OK);
+    return tagged_only ? st.tagged_lost : st.overwritten + st.truncated + st.oversize + st.dropped;
+}
+
+static void consume_one(consumer_t *c, esp_coze_ring_buffer_t *rb, char *msg, size_t len)
+{
+    static const char *const top_keys[] = {"event_type", "data"};
+    static const char *const data_keys[] = {"content", "seq"};
+    static int16_t pcm[(MAX_CONCEAL + 1) * FRAME_SAMPLES];
+    esp_coze_json_span_t top[2], data[2];
+
+    HOST_CHECK(esp_coze_json_scan_object(msg, len, top_keys, 2, top) == ESP_OK);
+    if (!esp_coze_json_span_equals(&top[0], "conversation.audio.delta")) {
+        return;
+    }
+    HOST_CHECK(esp_coze_json_scan_object(top[1].ptr, top[1].len, data_keys, 2, data) == ESP_OK);
+    int64_t seq;
+    HOST_CHECK(esp_coze_json_span_to_int(&data[1], &seq) == ESP_OK);
+
+    // 与 decode_audio_delta 相同的原地解码
+    char *b64 = (char *)data[0].ptr;
+    uint8_t *raw = (uint8_t *)b64 - ((uintptr_t)b64 & 3);
+    size_t raw_len = 0;
+    if (esp_coze_base64_decode(b64, data[0].len, raw, data[0].len, &raw_len) != ESP_OK) {
+        c->pending++;
+        c->corrupt++;
+        return;
+    }
+
+    // 与 take_lost_frames 相同的规则
+    uint32_t ring_lost = ring_lost_now(rb, c->tagged_only);
+    uint32_t lost = c->pending + (ring_lost - c->ring_lost);
+    c->ring_lost = ring_lost;
+    c->pending = 0;
+    if (lost > MAX_CONCEAL) {
+        lost = MAX_CONCEAL;
+    }
+
+    size_t n = 0;
+    HOST_CHECK(opus_audio_decoder_decode_with_loss(c->dec, raw, raw_len, lost, pcm,
+                                                   sizeof(pcm) / sizeof(pcm[0]), &n) == ESP_OK);
+    HOST_CHECK(n == (lost + 1) * FRAME_SAMPLES);
+    // 本帧解码结果必须就是源音频，补帧没有打乱解码器
+    HOST_CHECK(memcmp(pcm + lost * FRAME_SAMPLES, &s_source[(seq + 1) * FRAME_SAMPLES],
+                      FRAME_SAMPLES * sizeof(int16_t)) == 0);
+
+    uint32_t truly = (uint32_t)(seq - c->last_seq - 1);
+    c->truly_lost += truly;
+    if (truly > lost) {
+        c->uncovered += truly - lost;
+        if (truly - lost > c->longest_gap) {
+            c->longest_gap = truly - lost;
+        }
+    } else {
+        c->spurious += lost - truly;
+    }
+    c->last_seq = seq;
+    c->played++;
+}
+
+/**
+ * @brief 跑一遍完整的下行流，消费者卡顿的时机只由种子决定，两种统计方式看到的丢包完全相同
+ */
+static void run_stream(consumer_t *c, esp_coze_ring_buffer_msg_stats_t *stats)
+{
+    static char msg[MSG_MAX + 1];
+    static esp_coze_ring_buffer_t rb;
+    uint32_t seed = 0xC0FFEE;
+    uint32_t stall = 0;
+    uint32_t texts = 0;
+
+    opus_audio_decoder_config_t cfg = {
+        .sample_rate = SAMPLE_RATE,
+        .channels = 1,
+        .max_frame_size = FRAME_SAMPLES,
+    };
+    c->dec = opus_audio_decoder_create(&cfg);
+    HOST_CHECK(c->dec);
+    c->last_seq = -1;
+    HOST_CHECK(esp_coze_ring_buffer_init(&rb, RING_SIZE) == ESP_OK);
+
+    for (uint32_t seq = 0; seq < AUDIO_FRAMES; seq++) {
+        // 最后一帧不破坏，保证结尾的丢失都能在统计里体现
+        bool corrupt = seq + 1 < AUDIO_FRAMES && host_rand(&seed) % 200 == 0;
+        ws_enqueue(&rb, msg, make_audio_msg(msg, seq, corrupt));
+        uint32_t extra = host_rand(&seed) % 3;
+        for (uint32_t k = 0; k < extra && seq + 1 < AUDIO_FRAMES; k++) {
+            ws_enqueue(&rb, msg, make_text_msg(msg, texts++, &seed));
+        }
+
+        // 解析任务偶尔被抢占：这段时间只入队不取
+        if (stall > 0) {
+            stall--;
+            continue;
+        }
+        if (host_rand(&seed) % 25 == 0) {
+            stall = 1 + host_rand(&seed) % 10;
+            continue;
+        }
+        size_t len;
+        while (esp_coze_ring_buffer_read_message(&rb, (uint8_t *)msg, sizeof(msg), &len) == ESP_OK) {
+            consume_one(c, &rb, msg, len);
+        }
+    }
+    size_t len;
+    while (esp_coze_ring_buffer_read_message(&rb, (uint8_t *)msg, sizeof(msg), &len) == ESP_OK) {
+        consume_one(c, &rb, msg, len);
+    }
+
+    HOST_CHECK(esp_coze_ring_buffer_get_msg_stats(&rb, stats) == ESP_OK);
+    opus_audio_decoder_destroy(c->dec);
+    esp_coze_ring_buffer_deinit(&rb);
+}
+
+static void report(const char *name, const consumer_t *c)
+{
+    printf("  %-12s 真实丢失%4u帧，断音%5u ms（最长%3u ms），多补%5u ms\n", name, (unsigned)c->truly_lost,
+           (unsigned)(c->uncovered * FRAME_MS), (unsigned)(c->longest_gap * FRAME_MS),
+           (unsigned)(c->spurious * FRAME_MS));
+}
+
+int main(void)
+{
+    gen_source();
+
+    consumer_t tagged = {.tagged_only = true};
+    consumer_t all = {.tagged_only = false};
+    esp_coze_ring_buffer_msg_stats_t st_tagged, st_all;
+    run_stream(&tagged, &st_tagged);
+    run_stream(&all, &st_all);
+
+    // 两次运行的丢包完全相同
+    HOST_CHECK(st_tagged.overwritten == st_all.overwritten && st_tagged.tagged_lost == st_all.tagged_lost);
+    HOST_CHECK(tagged.played == all.played && tagged.truly_lost == all.truly_lost);
+
+    // 标记计数正好是环形缓冲区丢掉的音频delta数
+    HOST_CHECK(tagged.last_seq == AUDIO_FRAMES - 1);
+    HOST_CHECK(tagged.played + tagged.truly_lost == AUDIO_FRAMES);
+    HOST_CHECK(st_tagged.tagged_lost + tagged.corrupt == tagged.truly_lost);
+    HOST_CHECK(st_tagged.tagged_lost > 0 && st_tagged.tagged_lost < st_tagged.overwritten);
+
+    printf("环形缓冲区覆盖%u条消息，其中音频delta %u条；base64损坏%u帧\n", (unsigned)st_tagged.overwritten,
+           (unsigned)st_tagged.tagged_lost, (unsigned)tagged.corrupt);
+    report("只计音频", &tagged);
+    report("计所有消息", &all);
+
+    // 只计音频时从不多补，断音只出现在连续丢失超过3帧的地方
+    HOST_CHECK(tagged.spurious == 0);
+    HOST_CHECK(all.spurious > 0);
+    HOST_CHECK(tagged.uncovered <= all.uncovered);
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 20:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 20:00:00
+ * @FilePath: \esp-chunfeng\main\Audio\audio_dsp.c
+ * @Description: 音频定点处理内核实现
+ *
+ */
+#include "audio_dsp.h"
+#include "esp_attr.h"
+
+/**
+ * @brief 饱和到16位，写成比较形式让编译器生成Xtensa的CLAMPS指令
+ */
+static inline int32_t sat16(int32_t v)
+{
+    v = v < -32768 ? -32768 : v;
+    return v > 32767 ? 32767 : v;
+}
+
+/**
+ * @brief 处理一个样本，参考实现和优化实现共用同一个公式保证逐位一致
+ *
+ * x为移位后的输入，y保留8位小数；极点乘积和增益乘积用64位中间值（S3上是一条MULL加一条MULSH）。
+ */
+static inline int32_t mic_step(int32_t x, int32_t *x1, int32_t *y1, int32_t pole, int32_t gain)
+{
+    int32_t y = (x - *x1) * 256 + (int32_t)(((int64_t)pole * *y1) >> 15);
+    *x1 = x;
+    *y1 = y;
+    return sat16((int32_t)(((int64_t)y * gain) >> 16));
+}
+
+void audio_dsp_mic_init(audio_dsp_mic_state_t *st, int32_t gain_q8)
+{
+    st->x1 = 0;
+    st->y1 = 0;
+    st->gain = gain_q8;
+    st->pole = AUDIO_DSP_DC_POLE_Q15;
+}
+
+void IRAM_ATTR audio_dsp_mic_convert(audio_dsp_mic_state_t *st, const int32_t *in, int16_t *out, size_t count)
+{
+    // 滤波器历史放在寄存器里，4样本展开；隔直滤波是一阶递推，样本之间有依赖，无法按通道并行
+    int32_t x1 = st->x1;
+    int32_t y1 = st->y1;
+    const int32_t pole = st->pole;
+    const int32_t gain = st->gain;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32_t a = in[i] >> AUDIO_DSP_MIC_SHIFT;
+        int32_t b = in[i + 1] >> AUDIO_DSP_MIC_SHIFT;
+        int32_t c = in[i + 2] >> AUDIO_DSP_MIC_SHIFT;
+        int32_t d = in[i + 3] >> AUDIO_DSP_MIC_SHIFT;
+        out[i] = (int16_t)mic_step(a, &x1, &y1, pole, gain);
+        out[i + 1] = (int16_t)mic_step(b, &x1, &y1, pole, gain);
+        out[i + 2] = (int16_t)mic_step(c, &x1, &y1, pole, gain);
+        out[i + 3] = (int16_t)mic_step(d, &x1, &y1, pole, gain);
+    }
+    for (; i < count; i++) {
+        out[i] = (int16_t)mic_step(in[i] >> AUDIO_DSP_MIC_SHIFT, &x1, &y1, pole, gain);
+    }
+
+    st->x1 = x1;
+    st->y1 = y1;
+}
+
+void audio_dsp_mic_convert_ref(audio_dsp_mic_state_t *st, const int32_t *in, int16_t *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        int32_t x = in[i] >> AUDIO_DSP_MIC_SHIFT;
+        int32_t y = (x - st->x1) * 256 + (int32_t)(((int64_t)st->pole * st->y1) >> 15);
+        st->x1 = x;
+        st->y1 = y;
+
+        int32_t v = (int32_t)(((int64_t)y * st->gain) >> 16);
+        if (v > 32767) {
+            v = 32767;
+        } else if (v < -32768) {
+            v = -32768;
+        }
+        out[i] = (int16_t)v;
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 20:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 20:00:00
+ * @FilePath: \esp-chunfeng\main\Audio\audio_dsp.h
+ * @Description: 音频定点处理内核
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_DSP_MIC_SHIFT     14      ///< 32位I2S样本右移位数，与原来的 >> 14 电平一致
+#define AUDIO_DSP_GAIN_ONE      256     ///< 增益1.0（Q8）
+#define AUDIO_DSP_DC_POLE_Q15   32604   ///< 隔直滤波器极点0.995（Q15），16kHz下截止频率约13Hz
+
+/**
+ * @brief 麦克风转换状态（隔直滤波器历史和增益）
+ */
+typedef struct {
+    int32_t x1;     ///< 上一个输入样本（移位后）
+    int32_t y1;     ///< 上一个滤波输出（Q8）
+    int32_t gain;   ///< 增益（Q8）
+    int32_t pole;   ///< 隔直滤波器极点（Q15）
+} audio_dsp_mic_state_t;
+
+/**
+ * @brief 初始化麦克风转换状态
+ *
+ * @param st 状态
+ * @param gain_q8 增益（Q8，AUDIO_DSP_GAIN_ONE 为1.0）
+ */
+void audio_dsp_mic_init(audio_dsp_mic_state_t *st, int32_t gain_q8);
+
+/**
+ * @brief 一次完成 32位→16位移位、隔直高通、定点增益和饱和
+ *
+ * y[n] = (x[n] - x[n-1]) + a * y[n-1]，out = sat16(y * gain)。
+ * 展开的优化实现，结果与 audio_dsp_mic_convert_ref 逐位一致；不分配内存，可在中断中调用。
+ *
+ * @param st 状态，跨调用保存滤波器历史
+ * @param in 32位I2S样本
+ * @param out 16位输出，由调用方提供，可以与in指向同一块内存
+ * @param count 样本数
+ */
+void audio_dsp_mic_convert(audio_dsp_mic_state_t *st, const int32_t *in, int16_t *out, size_t count);
+
+/**
+ * @brief audio_dsp_mic_convert 的逐样本参考实现，用于核对优化实现
+ *
+ * 固件中不调用；host_test/test_audio_dsp.c 用随机、满幅、直流阶跃和任意切块的输入核对两者逐位一致。
+ */
+void audio_dsp_mic_convert_ref(audio_dsp_mic_state_t *st, const int32_t *in, int16_t *out, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,7 @@
  *
  */
 #include "audio_hal.h"
+#include "audio_dsp.h"
 #include <string.h>
 #include <stdlib.h>
 #include "esp_log.h"
@@ -15,12 +16,16 @@
 #include "driver/i2s_std.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "AUDIO_HAL";
 static i2s_chan_handle_t s_tx = NULL; // 扬声器通道句柄
 static i2s_chan_handle_t s_rx = NULL; // 麦克风通道句柄
 static bool s_inited = false;         // HAL 是否已初始化
 static uint8_t s_volume = 95;         // 软件音量（0~100）
+static uint32_t s_spk_rate = AUDIO_SAMPLE_RATE_HZ; // 扬声器当前采样率
+// 功放从BCLK恢复时钟，只支持标准采样率（升序）
+static const uint32_t s_spk_rates[] = {8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000};
 static TaskHandle_t s_loop_task = NULL;
 
 // 音频环回任务栈 - 放在PSRAM
@@ -30,6 +35,62 @@ static StaticTask_t audio_loop_task_buffer; // 环回任务句柄
 static size_t s_loop_frame = 0;         // 环回每帧采样数
 static bool s_loop_running = false;     // 环回是否运行中
 
+// 麦克风双缓冲：中断往一块里写，上层处理另一块。中断里要访问，放在内部RAM
+static int16_t s_mic_frames[2][AUDIO_MIC_FRAME_SAMPLES];
+static int s_mic_fill_idx = 0;          // 中断正在写的缓冲
+static size_t s_mic_fill_len = 0;       // 已写入的样本数
+static volatile int s_mic_ready_idx = -1; // 交给上层、尚未释放的缓冲，-1表示没有
+static SemaphoreHandle_t s_mic_sem = NULL;
+static StaticSemaphore_t s_mic_sem_buffer;
+static portMUX_TYPE s_mic_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_hal_mic_stats_t s_mic_stats;
+static audio_dsp_mic_state_t s_mic_dsp;  // 隔直滤波器状态和麦克风增益
+
+// audio_hal_read 用：当前帧和读到的位置
+static const int16_t *s_read_frame = NULL;
+static size_t s_read_pos = 0;
+
+/**
+ * @brief I2S接收完成中断回调：把DMA缓冲转换为16位写入双缓冲，满一帧交给上层
+ */
+static bool IRAM_ATTR mic_on_recv(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    const int32_t *src = (const int32_t *)event->dma_buf;
+    size_t count = event->size / sizeof(int32_t);
+    BaseType_t woken = pdFALSE;
+
+    // 正在写的缓冲只有中断访问，只有交接帧时需要加锁
+    while (count > 0) {
+        int16_t *dst = s_mic_frames[s_mic_fill_idx] + s_mic_fill_len;
+        size_t n = AUDIO_MIC_FRAME_SAMPLES - s_mic_fill_len;
+        if (n > count) {
+            n = count;
+        }
+        // 数据转换：32位右移14位、隔直、增益、饱和一次完成
+        audio_dsp_mic_convert(&s_mic_dsp, src, dst, n);
+        src += n;
+        count -= n;
+        s_mic_fill_len += n;
+
+        if (s_mic_fill_len == AUDIO_MIC_FRAME_SAMPLES) {
+            s_mic_fill_len = 0;
+            portENTER_CRITICAL_ISR(&s_mic_lock);
+            if (s_mic_ready_idx >= 0) {
+                // 上一帧还没释放，丢弃这一帧，继续写同一块缓冲
+                s_mic_stats.overruns++;
+            } else {
+                s_mic_ready_idx = s_mic_fill_idx;
+                s_mic_fill_idx ^= 1;
+                s_mic_stats.frames++;
+                xSemaphoreGiveFromISR(s_mic_sem, &woken);
+            }
+            portEXIT_CRITICAL_ISR(&s_mic_lock);
+        }
+    }
+
+    return woken == pdTRUE;
+}
+
 /**
  * @brief 创建扬声器（TX）通道
  * @return ESP_OK 成功，否则返回错误码
@@ -39,6 +100,8 @@ static esp_err_t create_tx_channel(void)
     // 配置 I2S 通道参数
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(AUDIO_SPK_PORT, I2S_ROLE_MASTER);
     chan_cfg.auto_clear = true;
+    chan_cfg.dma_desc_num = AUDIO_SPK_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = AUDIO_SPK_DMA_FRAME_NUM;
     // 创建 TX 通道
     ESP_RETURN_ON_ERROR(i2s_new_channel(&chan_cfg, &s_tx, NULL), TAG, "new tx channel failed");
     // 配置 I2S 标准模式参数
@@ -68,8 +131,10 @@ static esp_err_t create_tx_channel(void)
  */
 static esp_err_t create_rx_channel(void)
 {
-    // 配置 I2S 通道参数
+    // 配置 I2S 通道参数，DMA缓冲区大小取帧大小的整数分之一，中断里按样本拼帧
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(AUDIO_MIC_PORT, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = AUDIO_MIC_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = AUDIO_MIC_DMA_FRAME_NUM;
     // 创建 RX 通道
     ESP_RETURN_ON_ERROR(i2s_new_channel(&chan_cfg, NULL, &s_rx), TAG, "new rx channel failed");
     // 配置 I2S 标准模式参数
@@ -88,6 +153,13 @@ static esp_err_t create_rx_channel(void)
     std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_RIGHT; // 仅取一路（右声道）
     // 初始化 RX 通道为标准模式
     ESP_RETURN_ON_ERROR(i2s_channel_init_std_mode(s_rx, &std_cfg), TAG, "init rx std mode failed");
+    // 注册接收完成回调，必须在使能之前
+    audio_dsp_mic_init(&s_mic_dsp, AUDIO_DSP_GAIN_ONE);
+    s_mic_sem = xSemaphoreCreateBinaryStatic(&s_mic_sem_buffer);
+    i2s_event_callbacks_t cbs = {
+        .on_recv = mic_on_recv,
+    };
+    ESP_RETURN_ON_ERROR(i2s_channel_register_event_callback(s_rx, &cbs, NULL), TAG, "register rx callback failed");
     // 使能 RX 通道
     ESP_RETURN_ON_ERROR(i2s_channel_enable(s_rx), TAG, "enable rx failed");
     return ESP_OK;
@@ -107,6 +179,79 @@ esp_err_t audio_hal_init(void)
     return ESP_OK;
 }
 
+/**
+ * @brief 扬声器能否直接以该采样率播放
+ * @param rate_hz 采样率
+ * @return true 支持
+ */
+bool audio_hal_spk_rate_supported(uint32_t rate_hz)
+{
+    for (size_t i = 0; i < sizeof(s_spk_rates) / sizeof(s_spk_rates[0]); i++) {
+        if (s_spk_rates[i] == rate_hz) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 扬声器支持的采样率列表（升序）
+ * @param count 输出列表长度
+ * @return 采样率列表
+ */
+const uint32_t *audio_hal_spk_supported_rates(size_t *count)
+{
+    if (count) *count = sizeof(s_spk_rates) / sizeof(s_spk_rates[0]);
+    return s_spk_rates;
+}
+
+/**
+ * @brief 切换扬声器采样率
+ * @param rate_hz 采样率
+ * @return ESP_OK 成功，否则返回错误码
+ */
+esp_err_t audio_hal_set_spk_sample_rate(uint32_t rate_hz)
+{
+    if (!s_inited || !s_tx) return ESP_ERR_INVALID_STATE;
+    if (!audio_hal_spk_rate_supported(rate_hz)) return ESP_ERR_NOT_SUPPORTED;
+    if (rate_hz == s_spk_rate) return ESP_OK;
+
+    // 写满一整个DMA深度的静音：之前写入的音频全部播完，DMA里只剩0，停止时输出不会跳变
+    static const int16_t silence[AUDIO_SPK_DMA_FRAME_NUM] = {0};
+    for (int i = 0; i < AUDIO_SPK_DMA_DESC_NUM; i++) {
+        audio_hal_write(silence, AUDIO_SPK_DMA_FRAME_NUM, 200);
+    }
+
+    ESP_RETURN_ON_ERROR(i2s_channel_disable(s_tx), TAG, "disable tx failed");
+    i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(rate_hz);
+    esp_err_t ret = i2s_channel_reconfig_std_clock(s_tx, &clk_cfg);
+    if (ret != ESP_OK) {
+        // 改不了就按原采样率恢复通道，s_spk_rate不变，由调用方退回原采样率投递
+        ESP_LOGE(TAG, "reconfig tx clock %lu failed: %s", (unsigned long)rate_hz, esp_err_to_name(ret));
+        esp_err_t en = i2s_channel_enable(s_tx);
+        if (en != ESP_OK) {
+            ESP_LOGE(TAG, "re-enable tx failed: %s, speaker stopped", esp_err_to_name(en));
+            return ESP_ERR_INVALID_STATE;
+        }
+        return ret;
+    }
+    ESP_LOGI(TAG, "spk sr %lu -> %lu", (unsigned long)s_spk_rate, (unsigned long)rate_hz);
+    s_spk_rate = rate_hz;
+    ret = i2s_channel_enable(s_tx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "enable tx failed: %s, speaker stopped", esp_err_to_name(ret));
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 获取扬声器当前采样率
+ * @return 采样率（Hz）
+ */
+uint32_t audio_hal_get_spk_sample_rate(void)
+{
+    return s_spk_rate;
+}
+
 /**
  * @brief 设置音量（0~AUDIO_VOLUME_MAX）
  * @param vol 音量值
@@ -117,6 +262,16 @@ void audio_hal_set_volume(uint8_t vol)
     s_volume = vol;
 }
 
+/**
+ * @brief 设置麦克风增益
+ * @param gain_q8 增益（Q8）
+ */
+void audio_hal_set_mic_gain(uint16_t gain_q8)
+{
+    // 单个32位字写入，中断里读到的要么是旧值要么是新值
+    s_mic_dsp.gain = gain_q8;
+}
+
 /**
  * @brief 获取当前音量
  * @return 当前音量值
@@ -155,6 +310,45 @@ esp_err_t audio_hal_write(const int16_t *samples, size_t sample_count, uint32_t
     return ret;
 }
 
+/**
+ * @brief 等待麦克风的下一帧
+ * @param frame 输出帧指针
+ * @param timeout_ms 超时时间（毫秒）
+ * @return ESP_OK 成功，否则返回错误码
+ */
+esp_err_t audio_hal_mic_wait_frame(const int16_t **frame, uint32_t timeout_ms)
+{
+    if (!s_inited || !s_mic_sem) return ESP_ERR_INVALID_STATE;
+    if (!frame) return ESP_ERR_INVALID_ARG;
+    if (xSemaphoreTake(s_mic_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *frame = s_mic_frames[s_mic_ready_idx];
+    return ESP_OK;
+}
+
+/**
+ * @brief 释放取到的帧，中断可以再交新帧
+ */
+void audio_hal_mic_release_frame(void)
+{
+    portENTER_CRITICAL(&s_mic_lock);
+    s_mic_ready_idx = -1;
+    portEXIT_CRITICAL(&s_mic_lock);
+}
+
+/**
+ * @brief 获取麦克风采集统计
+ * @param stats 输出统计
+ */
+void audio_hal_mic_get_stats(audio_hal_mic_stats_t *stats)
+{
+    if (!stats) return;
+    portENTER_CRITICAL(&s_mic_lock);
+    *stats = s_mic_stats;
+    portEXIT_CRITICAL(&s_mic_lock);
+}
+
 /**
  * @brief 从麦克风读取音频数据
  * @param out_samples 输出采样缓冲区
@@ -167,16 +361,28 @@ esp_err_t audio_hal_read(int16_t *out_samples, size_t sample_count, size_t *out_
 {
     if (!s_inited || !s_rx) return ESP_ERR_INVALID_STATE;
     if (!out_samples || sample_count == 0) return ESP_ERR_INVALID_ARG;
-    size_t bytes32 = sample_count * sizeof(int32_t);
-    int32_t *temp = (int32_t *)malloc(bytes32); // 临时缓冲区
-    if (!temp) return ESP_ERR_NO_MEM;
-    size_t bytes_read = 0;
-    esp_err_t ret = i2s_channel_read(s_rx, temp, bytes32, &bytes_read, timeout_ms);
-    size_t got = bytes_read / sizeof(int32_t);
-    // 数据转换：32位右移14位转为16位
-    for (size_t i = 0; i < got; ++i)
-        out_samples[i] = (int16_t)(temp[i] >> 14);
-    free(temp);
+    esp_err_t ret = ESP_OK;
+    size_t got = 0;
+    // 从双缓冲按帧拷贝，不再每次分配32位临时缓冲区
+    while (got < sample_count) {
+        if (!s_read_frame) {
+            ret = audio_hal_mic_wait_frame(&s_read_frame, timeout_ms);
+            if (ret != ESP_OK) {
+                s_read_frame = NULL;
+                break;
+            }
+            s_read_pos = 0;
+        }
+        size_t n = AUDIO_MIC_FRAME_SAMPLES - s_read_pos;
+        if (n > sample_count - got) n = sample_count - got;
+        memcpy(out_samples + got, s_read_frame + s_read_pos, n * sizeof(int16_t));
+        got += n;
+        s_read_pos += n;
+        if (s_read_pos == AUDIO_MIC_FRAME_SAMPLES) {
+            s_read_frame = NULL;
+            audio_hal_mic_release_frame();
+        }
+    }
     if (out_got) *out_got = got;
     return ret;
 }
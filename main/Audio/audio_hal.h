@@ -45,6 +45,21 @@ extern "C" {
 
 #define AUDIO_VOLUME_MAX            100                 ///< 最大音量值
 
+#define AUDIO_MIC_FRAME_SAMPLES     512                 ///< 麦克风一帧的样本数（32ms）
+#define AUDIO_MIC_DMA_FRAME_NUM     256                 ///< 每个DMA缓冲区的样本数，帧大小的整数分之一
+#define AUDIO_MIC_DMA_DESC_NUM      4                   ///< DMA缓冲区个数
+
+#define AUDIO_SPK_DMA_FRAME_NUM     240                 ///< 扬声器每个DMA缓冲区的帧数
+#define AUDIO_SPK_DMA_DESC_NUM      6                   ///< 扬声器DMA缓冲区个数
+
+/**
+ * @brief 麦克风采集统计
+ */
+typedef struct {
+    uint32_t frames;        ///< 交给上层的帧数
+    uint32_t overruns;      ///< 上层来不及取走而丢弃的帧数
+} audio_hal_mic_stats_t;
+
 /**
  * @brief 初始化音频HAL
  *
@@ -72,6 +87,8 @@ esp_err_t audio_hal_write(const int16_t *samples, size_t sample_count, uint32_t
 /**
  * @brief 从麦克风读取音频数据
  *
+ * 基于 audio_hal_mic_wait_frame 实现，不能与其同时使用。
+ *
  * @param out_samples 输出缓冲区，存储16位PCM音频样本
  * @param sample_count 请求读取的样本数量
  * @param out_got 实际读取到的样本数量
@@ -83,6 +100,78 @@ esp_err_t audio_hal_write(const int16_t *samples, size_t sample_count, uint32_t
  */
 esp_err_t audio_hal_read(int16_t *out_samples, size_t sample_count, size_t *out_got, uint32_t timeout_ms);
 
+/**
+ * @brief 等待麦克风的下一帧
+ *
+ * 麦克风由I2S接收完成中断驱动：每个DMA缓冲区在中断里转换为16位写入预分配的双缓冲，
+ * 凑满 AUDIO_MIC_FRAME_SAMPLES 个样本就交给上层，帧边界精确到样本，不依赖任务调度时机。
+ * 取到的帧在调用 audio_hal_mic_release_frame 之前一直有效；上层在下一帧填满前
+ * 没有释放时，新帧被丢弃并计入overruns。只支持一个消费者。
+ *
+ * @param frame 输出帧指针，样本数为 AUDIO_MIC_FRAME_SAMPLES
+ * @param timeout_ms 超时时间（毫秒）
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_TIMEOUT: 超时
+ *         - ESP_ERR_INVALID_STATE: 未初始化
+ */
+esp_err_t audio_hal_mic_wait_frame(const int16_t **frame, uint32_t timeout_ms);
+
+/**
+ * @brief 释放 audio_hal_mic_wait_frame 取到的帧
+ */
+void audio_hal_mic_release_frame(void);
+
+/**
+ * @brief 获取麦克风采集统计
+ *
+ * @param stats 输出统计
+ */
+void audio_hal_mic_get_stats(audio_hal_mic_stats_t *stats);
+
+/**
+ * @brief 扬声器能否直接以该采样率播放
+ *
+ * 功放没有接MCLK，从BCLK恢复时钟，只支持标准采样率（8k/11.025k/12k/16k/22.05k/24k/32k/44.1k/48k）。
+ *
+ * @param rate_hz 采样率
+ * @return true 支持
+ */
+bool audio_hal_spk_rate_supported(uint32_t rate_hz);
+
+/**
+ * @brief 扬声器支持的采样率列表
+ *
+ * 升序排列，供下行格式协商使用；列表是常量，audio_hal_init 之前也可以调用。
+ *
+ * @param count 输出列表长度
+ * @return const uint32_t* 采样率列表
+ */
+const uint32_t *audio_hal_spk_supported_rates(size_t *count);
+
+/**
+ * @brief 切换扬声器（TX）采样率，麦克风不受影响
+ *
+ * 先写入一整个DMA深度的静音把DMA里剩下的音频推出去，停止通道、改时钟再启动，
+ * 切换前后输出都是0，不会有爆音。会阻塞到已写入的音频播完（16kHz下约90ms），
+ * 必须在调用 audio_hal_write 的同一个任务里调用（通常由播放器在两段音频之间调用）。
+ *
+ * @param rate_hz 采样率
+ * @return esp_err_t
+ *         - ESP_OK: 成功（采样率没变时直接返回）
+ *         - ESP_ERR_INVALID_STATE: 未初始化，或停止通道后没能重新启动，扬声器已不再输出
+ *         - ESP_ERR_NOT_SUPPORTED: 扬声器不支持该采样率
+ *         - 其他: I2S驱动返回的错误码，通道仍按原采样率运行
+ */
+esp_err_t audio_hal_set_spk_sample_rate(uint32_t rate_hz);
+
+/**
+ * @brief 获取扬声器当前采样率
+ *
+ * @return uint32_t 采样率（Hz）
+ */
+uint32_t audio_hal_get_spk_sample_rate(void);
+
 /**
  * @brief 设置扬声器音量
  *
@@ -90,6 +179,15 @@ esp_err_t audio_hal_read(int16_t *out_samples, size_t sample_count, size_t *out_
  */
 void audio_hal_set_volume(uint8_t vol);
 
+/**
+ * @brief 设置麦克风数字增益
+ *
+ * 增益与隔直滤波、饱和在I2S接收中断里一次完成。
+ *
+ * @param gain_q8 增益（Q8，256为1.0，默认1.0）
+ */
+void audio_hal_set_mic_gain(uint16_t gain_q8);
+
 /**
  * @brief 获取当前扬声器音量
  *
@@ -10,9 +10,41 @@
 #include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 #include <string.h>
 #include <stdlib.h>
 
+#define JB_MARGIN_MS        20      // 播放延迟在测得的抖动之上再留的余量
+#define JB_DECAY_SHIFT      5       // 抖动峰值每收到一包衰减1/32，网络变好后延迟慢慢降回来
+#define JB_DRAIN_POLLS      5       // 连续这么多次（每次200ms）没数据就把不足预缓冲的尾巴播掉，本轮不结束
+#define JB_EOS_POLLS        50      // 10秒没数据也没收到结束事件，按本轮结束处理，免得speak动画一直不停
+
+typedef enum {
+    JB_BUFFERING = 0,   // 攒数据，够目标延迟才开始播
+    JB_PLAYING,         // 播放中，读空算一次欠载
+} jb_state_t;
+
+/**
+ * @brief 抖动缓冲：按到达时间和已收到的音频时长估计网络抖动，自适应调整开播前的缓冲量
+ *
+ * 一轮回复内，第i包的相对时延 d = 到达时刻 - 已收音频时长；取最小值作基准（之后缓慢上移），
+ * d 超出基准的部分就是这包的迟到量。抖动取迟到量的衰减峰值，播放延迟 = 抖动 + 余量，
+ * 不低于初始预缓冲、不高于最大延迟。服务端比实时快地下发时 d 一直变小，迟到量为0。
+ */
+typedef struct {
+    jb_state_t state;
+    bool eos;                   // 本轮音频已全部收到，剩余数据直接播完，读空不算欠载
+    bool drain;                 // 长时间没来数据，先把缓冲里的播掉；数据恢复后照常按迟到量估计抖动
+    bool turn_started;          // 本轮是否已收到过数据
+    int64_t base_ms;            // 本轮相对时延的最小值
+    uint64_t media_samples;     // 本轮已收到的样本数
+    uint32_t jitter_ms;         // 抖动估计（迟到量的衰减峰值）
+    uint32_t target_ms;         // 当前播放延迟
+    uint32_t prebuffer_ms;      // 初始预缓冲，也是播放延迟的下限
+    audio_player_jitter_stats_t stats;
+} jitter_buffer_t;
+
 typedef struct {
     uint8_t *buffer;
     size_t   size;
@@ -28,6 +60,25 @@ static TaskHandle_t s_task = NULL;
 static size_t s_frame_samples = 1024;
 static bool s_running = false;
 static bool s_speak_anim_active = false;
+static jitter_buffer_t s_jb = {
+    .target_ms = CONFIG_COZE_PLAYER_PREBUFFER_MS,
+    .prebuffer_ms = CONFIG_COZE_PLAYER_PREBUFFER_MS,
+};
+static portMUX_TYPE s_jb_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 投递进来的PCM的采样率，I2S时钟由播放任务在两段音频之间切换过去
+static uint32_t s_feed_rate = AUDIO_SAMPLE_RATE_HZ;
+
+/**
+ * @brief 等待播放任务执行的扬声器采样率切换，由s_jb_lock保护
+ *
+ * 切换前投递的数据要按原采样率播完，记下当时缓冲里的字节数，播放任务读完这些字节再改I2S时钟。
+ */
+static struct {
+    uint32_t rate;          // 目标采样率，0表示没有待切换
+    size_t old_bytes;       // 切换之前投递、还没播放的字节数
+    uint32_t failed_rate;   // 改I2S时钟失败过的采样率，之后按不支持处理，0表示没有
+} s_rate_switch;
 
 static esp_err_t rb_init(pcm_ring_t *rb, size_t bytes)
 {
@@ -124,6 +175,214 @@ static size_t rb_read(pcm_ring_t *rb, uint8_t *out, size_t max_len, uint32_t tim
     return max_len;
 }
 
+static size_t rb_available(pcm_ring_t *rb)
+{
+    if (xSemaphoreTake(rb->mutex, pdMS_TO_TICKS(10)) != pdTRUE) return 0;
+    size_t avail = (rb->write_pos >= rb->read_pos)
+                   ? (rb->write_pos - rb->read_pos)
+                   : (rb->size - rb->read_pos + rb->write_pos);
+    xSemaphoreGive(rb->mutex);
+    return avail;
+}
+
+/**
+ * @brief 缓冲字节数与毫秒数互换，按当前投递的采样率计算，调用方持有s_jb_lock
+ */
+static size_t jb_ms_to_bytes(uint32_t ms)
+{
+    return (size_t)((uint64_t)ms * s_feed_rate / 1000) * sizeof(int16_t);
+}
+
+static uint32_t jb_bytes_to_ms(size_t bytes)
+{
+    return (uint32_t)((uint64_t)bytes / sizeof(int16_t) * 1000 / s_feed_rate);
+}
+
+/**
+ * @brief 根据抖动估计更新播放延迟，调用方持有s_jb_lock
+ */
+static void jb_update_target(void)
+{
+    uint32_t target = s_jb.jitter_ms + JB_MARGIN_MS;
+    if (target < s_jb.prebuffer_ms) target = s_jb.prebuffer_ms;
+    if (target > CONFIG_COZE_PLAYER_MAX_DELAY_MS) target = CONFIG_COZE_PLAYER_MAX_DELAY_MS;
+    s_jb.target_ms = target;
+    s_jb.stats.target_ms = target;
+    s_jb.stats.jitter_ms = s_jb.jitter_ms;
+}
+
+/**
+ * @brief 开始新一轮：清除时延基准和抖动估计，重新预缓冲，调用方持有s_jb_lock
+ */
+static void jb_reset_locked(void)
+{
+    s_jb.state = JB_BUFFERING;
+    s_jb.eos = false;
+    s_jb.drain = false;
+    s_jb.turn_started = false;
+    s_jb.media_samples = 0;
+    s_jb.jitter_ms = 0;
+    jb_update_target();
+}
+
+/**
+ * @brief 记录一包的到达时刻，估计迟到量
+ */
+static void jb_on_arrival(size_t samples)
+{
+    int64_t now_ms = esp_timer_get_time() / 1000;
+
+    portENTER_CRITICAL(&s_jb_lock);
+    // 只有 audio_player_jitter_reset 开始新一轮，卡顿很久之后到达的数据照样计入迟到量，把播放延迟抬上去
+    s_jb.drain = false;
+    int64_t d = now_ms - (int64_t)(s_jb.media_samples * 1000 / s_feed_rate);
+    if (!s_jb.turn_started || d < s_jb.base_ms) {
+        s_jb.base_ms = d;
+        s_jb.turn_started = true;
+    }
+    uint32_t late = (uint32_t)(d - s_jb.base_ms);
+    // 基准缓慢跟上：一次卡顿之后整体推迟的数据流不会一直被当成迟到
+    s_jb.base_ms += (d - s_jb.base_ms) >> JB_DECAY_SHIFT;
+    if (late > s_jb.target_ms) {
+        s_jb.stats.late_packets++;
+    }
+    if (late > s_jb.jitter_ms) {
+        s_jb.jitter_ms = late;
+    } else {
+        s_jb.jitter_ms -= s_jb.jitter_ms >> JB_DECAY_SHIFT;
+    }
+    s_jb.media_samples += samples;
+    s_jb.stats.packets++;
+    jb_update_target();
+    portEXIT_CRITICAL(&s_jb_lock);
+}
+
+/**
+ * @brief 本轮音频已全部收到
+ */
+static void jb_mark_eos(void)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    s_jb.eos = true;
+    portEXIT_CRITICAL(&s_jb_lock);
+}
+
+/**
+ * @brief 长时间没有数据：不足预缓冲的尾巴直接播掉，但不结束本轮
+ */
+static void jb_mark_drain(void)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    s_jb.drain = true;
+    portEXIT_CRITICAL(&s_jb_lock);
+}
+
+/**
+ * @brief 本轮是否已结束
+ */
+static bool jb_is_eos(void)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    bool eos = s_jb.eos;
+    portEXIT_CRITICAL(&s_jb_lock);
+    return eos;
+}
+
+/**
+ * @brief 是否可以读下一帧：正在播放，或者缓冲的数据够了播放延迟（本轮已结束或正在排空时有数据就播）
+ */
+static bool jb_ready(size_t avail_bytes)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    size_t need = (s_jb.eos || s_jb.drain) ? sizeof(int16_t) : jb_ms_to_bytes(s_jb.target_ms);
+    bool ready = s_jb.state == JB_PLAYING || (avail_bytes > 0 && avail_bytes >= need);
+    if (ready) {
+        s_jb.state = JB_PLAYING;
+    }
+    s_jb.stats.buffered_ms = jb_bytes_to_ms(avail_bytes);
+    portEXIT_CRITICAL(&s_jb_lock);
+    return ready;
+}
+
+/**
+ * @brief 播放中读空：本轮还没结束就算一次欠载，回到预缓冲
+ */
+static void jb_on_empty(void)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    if (s_jb.state == JB_PLAYING && !s_jb.eos) {
+        s_jb.stats.underruns++;
+    }
+    s_jb.state = JB_BUFFERING;
+    s_jb.stats.buffered_ms = 0;
+    portEXIT_CRITICAL(&s_jb_lock);
+}
+
+/**
+ * @brief 查询待切换的采样率
+ *
+ * @param old_bytes 输出：切换前还要按原采样率播放的字节数
+ * @return uint32_t 目标采样率，0表示没有待切换
+ */
+static uint32_t rate_switch_pending(size_t *old_bytes)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    uint32_t rate = s_rate_switch.rate;
+    *old_bytes = s_rate_switch.old_bytes;
+    portEXIT_CRITICAL(&s_jb_lock);
+    return rate;
+}
+
+/**
+ * @brief 记录按原采样率播掉的字节数；读不到数据说明旧数据已被清空
+ */
+static void rate_switch_consume(size_t bytes)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    if (bytes == 0 || bytes >= s_rate_switch.old_bytes) {
+        s_rate_switch.old_bytes = 0;
+    } else {
+        s_rate_switch.old_bytes -= bytes;
+    }
+    portEXIT_CRITICAL(&s_jb_lock);
+}
+
+/**
+ * @brief 旧数据播完，改I2S时钟；会阻塞到DMA里的音频播完
+ *
+ * 改时钟失败时投递采样率退回扬声器实际的采样率，调用方通过 audio_player_get_sample_rate 发现后改为重采样；
+ * 已经按新采样率投递的数据按旧时钟播会变调，直接丢弃。
+ */
+static void rate_switch_apply(uint32_t rate)
+{
+    esp_err_t ret = audio_hal_set_spk_sample_rate(rate);
+    bool drop = false;
+    portENTER_CRITICAL(&s_jb_lock);
+    // 等待期间又请求了别的采样率时保留新的请求
+    if (s_rate_switch.rate == rate && s_rate_switch.old_bytes == 0) {
+        s_rate_switch.rate = 0;
+        if (ret != ESP_OK) {
+            s_feed_rate = audio_hal_get_spk_sample_rate();
+            drop = true;
+        }
+    }
+    if (ret != ESP_OK) {
+        s_rate_switch.failed_rate = rate;
+    }
+    portEXIT_CRITICAL(&s_jb_lock);
+
+    if (ret == ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "扬声器切换到%lu Hz时通道没能恢复，已停止输出", (unsigned long)rate);
+    } else if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "扬声器切换到%lu Hz失败: %s，按%lu Hz播放", (unsigned long)rate, esp_err_to_name(ret),
+                 (unsigned long)audio_hal_get_spk_sample_rate());
+    }
+    if (drop && xSemaphoreTake(s_rb.mutex, portMAX_DELAY) == pdTRUE) {
+        s_rb.read_pos = s_rb.write_pos;
+        xSemaphoreGive(s_rb.mutex);
+    }
+}
+
 static void player_task(void *arg)
 {
     const size_t bytes_per_sample = sizeof(int16_t);
@@ -136,13 +395,39 @@ static void player_task(void *arg)
     }
     
     int no_data_count = 0;
-    const int max_no_data_count = 5; // 200ms * 25 = 5秒无数据后停止动画
+    bool write_failing = false;     // 连续写入失败只打印第一次
     
     while (s_running) {
-        size_t got = rb_read(&s_rb, (uint8_t *)frame, frame_bytes, 200);
+        size_t got = 0;
+        size_t old_bytes = 0;
+        uint32_t new_rate = rate_switch_pending(&old_bytes);
+        if (new_rate && old_bytes == 0) {
+            rate_switch_apply(new_rate);
+            continue;
+        }
+
+        if (new_rate) {
+            // 切换采样率之前投递的数据按原采样率直接播完，不再等预缓冲
+            got = rb_read(&s_rb, (uint8_t *)frame, frame_bytes < old_bytes ? frame_bytes : old_bytes, 0);
+            rate_switch_consume(got);
+        } else if (jb_ready(rb_available(&s_rb))) {
+            got = rb_read(&s_rb, (uint8_t *)frame, frame_bytes, 0);
+            if (got < bytes_per_sample) {
+                jb_on_empty();
+                continue;
+            }
+        } else if (xSemaphoreTake(s_rb.data_sem, pdMS_TO_TICKS(200)) == pdTRUE) {
+            // 预缓冲中来了新数据，重新检查是否够开播
+            continue;
+        }
+
         if (got >= bytes_per_sample) {
             size_t samples = got / bytes_per_sample;
-            audio_hal_write(frame, samples, 100);
+            esp_err_t wret = audio_hal_write(frame, samples, 100);
+            if (wret != ESP_OK && !write_failing) {
+                ESP_LOGE(TAG, "扬声器写入失败: %s", esp_err_to_name(wret));
+            }
+            write_failing = wret != ESP_OK;
             
             // 有音频数据，启动speak动画
             if (!s_speak_anim_active) {
@@ -155,12 +440,19 @@ static void player_task(void *arg)
         } else {
             // 没有音频数据
             no_data_count++;
-            if (s_speak_anim_active && no_data_count >= max_no_data_count) {
+            if (no_data_count == JB_DRAIN_POLLS) {
+                // 1秒没有新数据：把不足预缓冲的尾巴播掉，回复中途的网络卡顿照样计入抖动估计
+                jb_mark_drain();
+            } else if (no_data_count == JB_EOS_POLLS) {
+                // 一直没收到结束事件（例如连接断开），不再等了
+                jb_mark_eos();
+            }
+            // speak动画一直保持到本轮结束，卡顿期间不闪烁
+            if (s_speak_anim_active && jb_is_eos()) {
                 s_speak_anim_active = false;
                 ESP_LOGI(TAG, "停止speak动画");
                 lottie_manager_stop_anim(LOTTIE_ANIM_SPEAK);
                 lottie_manager_play_anim_at_pos(LOTTIE_ANIM_THINK,0,-110);
-                no_data_count = 0;
             }
         }
     }
@@ -236,10 +528,89 @@ bool audio_player_running(void)
 esp_err_t audio_player_feed_pcm(const int16_t *pcm, size_t sample_count)
 {
     if (!pcm || sample_count == 0) return ESP_ERR_INVALID_ARG;
+    jb_on_arrival(sample_count);
     size_t bytes = sample_count * sizeof(int16_t);
     size_t w = rb_write(&s_rb, (const uint8_t *)pcm, bytes);
     // 环形缓冲区现在永远写入成功
     return (w == bytes) ? ESP_OK : ESP_ERR_TIMEOUT;
 }
 
+void audio_player_flush(void)
+{
+    if (!s_rb.mutex) return;
+    if (xSemaphoreTake(s_rb.mutex, pdMS_TO_TICKS(10)) != pdTRUE) return;
+    s_rb.read_pos = s_rb.write_pos;
+    xSemaphoreGive(s_rb.mutex);
+    portENTER_CRITICAL(&s_jb_lock);
+    s_rate_switch.old_bytes = 0;
+    portEXIT_CRITICAL(&s_jb_lock);
+    // 被打断的这一轮到此结束，speak动画随之停下；下一轮由 audio_player_jitter_reset 开始
+    audio_player_jitter_reset();
+    jb_mark_eos();
+}
+
+esp_err_t audio_player_set_sample_rate(uint32_t rate_hz)
+{
+    if (!audio_hal_spk_rate_supported(rate_hz)) return ESP_ERR_NOT_SUPPORTED;
+    if (!s_rb.mutex) return ESP_ERR_INVALID_STATE;
+
+    // 投递方和本函数在同一个任务里调用，拿到的缓冲字节数正好是切换之前投递的数据
+    size_t old_bytes = rb_available(&s_rb);
+    portENTER_CRITICAL(&s_jb_lock);
+    if (rate_hz == s_rate_switch.failed_rate) {
+        portEXIT_CRITICAL(&s_jb_lock);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (rate_hz != s_feed_rate) {
+        s_feed_rate = rate_hz;
+        s_rate_switch.rate = rate_hz;
+        s_rate_switch.old_bytes = old_bytes;
+    }
+    portEXIT_CRITICAL(&s_jb_lock);
+    // 唤醒正在等数据的播放任务去切换时钟
+    xSemaphoreGive(s_rb.data_sem);
+    return ESP_OK;
+}
+
+uint32_t audio_player_get_sample_rate(void)
+{
+    return s_feed_rate;
+}
+
+bool audio_player_is_playing(void)
+{
+    return s_speak_anim_active;
+}
 
+
+
+void audio_player_jitter_reset(void)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    jb_reset_locked();
+    portEXIT_CRITICAL(&s_jb_lock);
+}
+
+void audio_player_jitter_end_of_stream(void)
+{
+    jb_mark_eos();
+    // 唤醒正在预缓冲的播放任务，不足预缓冲的尾巴也马上播出
+    if (s_rb.data_sem) xSemaphoreGive(s_rb.data_sem);
+}
+
+void audio_player_set_prebuffer_ms(uint32_t ms)
+{
+    portENTER_CRITICAL(&s_jb_lock);
+    s_jb.prebuffer_ms = ms;
+    jb_update_target();
+    portEXIT_CRITICAL(&s_jb_lock);
+}
+
+esp_err_t audio_player_get_jitter_stats(audio_player_jitter_stats_t *stats)
+{
+    if (!stats) return ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&s_jb_lock);
+    *stats = s_jb.stats;
+    portEXIT_CRITICAL(&s_jb_lock);
+    return ESP_OK;
+}
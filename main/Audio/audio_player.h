@@ -13,6 +13,16 @@
 extern "C" {
 #endif
 
+// 抖动缓冲统计
+typedef struct {
+    uint32_t packets;       // 收到的PCM包数
+    uint32_t underruns;     // 一轮回复还没结束就读空的次数
+    uint32_t late_packets;  // 迟到量超过当时播放延迟的包数
+    uint32_t jitter_ms;     // 当前抖动估计
+    uint32_t target_ms;     // 当前播放延迟（开播前要攒够的音频时长）
+    uint32_t buffered_ms;   // 缓冲中的音频时长
+} audio_player_jitter_stats_t;
+
 esp_err_t audio_player_init(size_t ring_bytes, size_t frame_samples);
 void      audio_player_deinit(void);
 esp_err_t audio_player_start(void);
@@ -22,6 +32,33 @@ bool      audio_player_running(void);
 // 投递PCM到播放器（16位单声道，sample_count为样本数）
 esp_err_t audio_player_feed_pcm(const int16_t *pcm, size_t sample_count);
 
+// 丢弃缓冲中还没播放的PCM（用户打断时调用）
+void      audio_player_flush(void);
+
+// 设置之后投递的PCM的采样率：扬声器支持时，播放任务播完之前投递的数据后切换I2S时钟，
+// 不支持（或之前切换失败过）时返回ESP_ERR_NOT_SUPPORTED，由调用方重采样到 audio_player_get_sample_rate 的采样率
+esp_err_t audio_player_set_sample_rate(uint32_t rate_hz);
+
+// 获取投递PCM应使用的采样率（默认 AUDIO_SAMPLE_RATE_HZ）；
+// 播放任务切换I2S时钟失败后退回扬声器实际的采样率，与设置的不同说明要改为重采样
+uint32_t  audio_player_get_sample_rate(void);
+
+// 扬声器是否正在出声：从本轮第一包播出到本轮结束（audio_player_jitter_end_of_stream 或打断）后播完为止，中途卡顿也算
+bool      audio_player_is_playing(void);
+
+// 开始新一轮回复：清除抖动估计，按初始预缓冲重新攒数据（不丢弃已缓冲的数据）；
+// 只有这里会清除抖动估计，回复中途长时间没数据只会先把缓冲播空
+void      audio_player_jitter_reset(void);
+
+// 本轮回复的音频已全部收到：不足预缓冲的尾巴直接播完，读空不算欠载
+void      audio_player_jitter_end_of_stream(void);
+
+// 设置初始预缓冲（毫秒），也是自适应播放延迟的下限；默认 CONFIG_COZE_PLAYER_PREBUFFER_MS
+void      audio_player_set_prebuffer_ms(uint32_t ms);
+
+// 获取抖动缓冲统计
+esp_err_t audio_player_get_jitter_stats(audio_player_jitter_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
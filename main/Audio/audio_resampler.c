@@ -0,0 +1,270 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 22:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 22:00:00
+ * @FilePath: \esp-chunfeng\main\Audio\audio_resampler.c
+ * @Description: 流式多相定点重采样器实现
+ *
+ */
+#include "audio_resampler.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "RESAMPLER";
+
+#define TAPS            AUDIO_RESAMPLER_TAPS
+#define CUTOFF_RATIO    0.9         // 截止频率占较低采样率奈奎斯特频率的比例
+#define KAISER_BETA     6.0         // 阻带约-60dB，过渡带约为较低采样率的10%
+
+/**
+ * @brief 重采样器状态
+ *
+ * 把 out/in 看成先插L-1个零（上采样到 in*L）再每M个取一个。phase是下一个输出在上采样域中
+ * 相对最新输入样本的位置，小于L时用第phase组系数算出一个输出；大于等于L时需要更多输入。
+ */
+struct audio_resampler_t {
+    uint32_t up;                    ///< 插值倍数L
+    uint32_t down;                  ///< 抽取倍数M
+    uint32_t phase;                 ///< 下一个输出的相位
+    uint32_t pos;                   ///< 延迟线中最老样本的位置
+    uint32_t shift;                 ///< 系数的小数位数，通常为15，系数绝对值之和超过2.0时降为14
+    int16_t *coefs;                 ///< L组系数，每组TAPS个，组内按时间从老到新排列
+    int16_t hist[TAPS * 2];         ///< 延迟线，每个样本写两份，任意位置起都有连续的TAPS个样本
+};
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief 零阶修正贝塞尔函数，Kaiser窗用
+ */
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        double t = x / (2.0 * k);
+        term *= t * t;
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief 按 rs->shift 设计原型低通并拆成多相定点系数
+ *
+ * 每组系数单独归一化到直流增益正好 1<<shift，量化误差集中到最大抽头上，
+ * 避免各相位增益不一致在输出里调制出 in_rate/L 的单音。
+ *
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 某组系数绝对值之和超过65535，满幅输入时32位累加可能溢出
+ */
+static esp_err_t design_filter(audio_resampler_t *rs, uint32_t in_rate, uint32_t out_rate)
+{
+    const uint32_t L = rs->up;
+    const uint32_t n_total = L * TAPS;
+    const double center = (n_total - 1) / 2.0;
+    // 上采样域（in_rate*L）中的归一化截止频率
+    const double fc = CUTOFF_RATIO * (double)(in_rate < out_rate ? in_rate : out_rate) / (2.0 * in_rate * L);
+    const double i0_beta = bessel_i0(KAISER_BETA);
+    const int32_t one = 1 << rs->shift;
+
+    for (uint32_t p = 0; p < L; p++) {
+        int16_t *c = rs->coefs + p * TAPS;
+        double taps[TAPS];
+        double sum = 0.0;
+        for (uint32_t k = 0; k < TAPS; k++) {
+            // 第k个抽头作用于往前数第k个输入，放到组内倒数第k个位置
+            double t = (p + k * L) - center;
+            double x = 2.0 * fc * t;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = t / (center + 0.5);
+            double win = bessel_i0(KAISER_BETA * sqrt(r * r < 1.0 ? 1.0 - r * r : 0.0)) / i0_beta;
+            taps[TAPS - 1 - k] = sinc * win;
+            sum += taps[TAPS - 1 - k];
+        }
+
+        int32_t qsum = 0;
+        uint32_t peak = 0;
+        for (uint32_t j = 0; j < TAPS; j++) {
+            double q = taps[j] / sum * one;
+            c[j] = (int16_t)lrint(q > 32767.0 ? 32767.0 : q);
+            qsum += c[j];
+            if (abs(c[j]) > abs(c[peak])) {
+                peak = j;
+            }
+        }
+        int32_t fixed = c[peak] + (one - qsum);
+        c[peak] = (int16_t)(fixed > 32767 ? 32767 : fixed);
+
+        uint32_t abs_sum = 0;
+        for (uint32_t j = 0; j < TAPS; j++) {
+            abs_sum += (uint32_t)abs(c[j]);
+        }
+        if (abs_sum > 65535) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 一个输出样本的定点内积
+ *
+ * 四路独立累加器打破乘加依赖链，S3上每路编译成MULL+ADD可以在流水线中交错执行；
+ * 每组系数绝对值之和不超过65535（创建时检查），32位累加不会溢出。
+ */
+static inline int16_t fir_dot(const int16_t *x, const int16_t *h, uint32_t shift)
+{
+    int32_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    for (int j = 0; j < TAPS; j += 4) {
+        a0 += (int32_t)x[j] * h[j];
+        a1 += (int32_t)x[j + 1] * h[j + 1];
+        a2 += (int32_t)x[j + 2] * h[j + 2];
+        a3 += (int32_t)x[j + 3] * h[j + 3];
+    }
+    int32_t y = (a0 + a1 + a2 + a3 + (1 << (shift - 1))) >> shift;
+    y = y < -32768 ? -32768 : y;
+    return (int16_t)(y > 32767 ? 32767 : y);
+}
+
+audio_resampler_t *audio_resampler_create(uint32_t in_rate, uint32_t out_rate)
+{
+    if (in_rate == 0 || out_rate == 0) {
+        return NULL;
+    }
+    uint32_t g = gcd_u32(in_rate, out_rate);
+    uint32_t up = out_rate / g;
+    uint32_t down = in_rate / g;
+    if (up > AUDIO_RESAMPLER_MAX_PHASES) {
+        ESP_LOGE(TAG, "不支持的采样率比例 %lu -> %lu", (unsigned long)in_rate, (unsigned long)out_rate);
+        return NULL;
+    }
+
+    audio_resampler_t *rs = heap_caps_calloc(1, sizeof(*rs), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!rs) {
+        return NULL;
+    }
+    rs->up = up;
+    rs->down = down;
+
+    if (up != down) {
+        // 24k->16k只有两组共128字节；22050之类的比例系数表较大，放PSRAM
+        size_t coef_size = (size_t)up * TAPS * sizeof(int16_t);
+        if (coef_size <= 1024) {
+            rs->coefs = heap_caps_malloc(coef_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        } else {
+            rs->coefs = heap_caps_malloc(coef_size, MALLOC_CAP_SPIRAM);
+        }
+        if (!rs->coefs) {
+            rs->coefs = malloc(coef_size);
+        }
+        // 上采样时中间相位的旁瓣较大，系数绝对值之和可能略超2.0，此时改用Q14
+        rs->shift = 15;
+        esp_err_t ret = rs->coefs ? design_filter(rs, in_rate, out_rate) : ESP_ERR_NO_MEM;
+        if (ret == ESP_ERR_INVALID_STATE) {
+            rs->shift = 14;
+            ret = design_filter(rs, in_rate, out_rate);
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "滤波器创建失败 %lu -> %lu", (unsigned long)in_rate, (unsigned long)out_rate);
+            audio_resampler_destroy(rs);
+            return NULL;
+        }
+        ESP_LOGI(TAG, "重采样 %lu -> %lu Hz（L=%lu M=%lu，%d抽头/相位，Q%lu）", (unsigned long)in_rate,
+                 (unsigned long)out_rate, (unsigned long)up, (unsigned long)down, TAPS, (unsigned long)rs->shift);
+    }
+    return rs;
+}
+
+void audio_resampler_destroy(audio_resampler_t *rs)
+{
+    if (!rs) {
+        return;
+    }
+    free(rs->coefs);
+    free(rs);
+}
+
+void audio_resampler_reset(audio_resampler_t *rs)
+{
+    if (!rs) {
+        return;
+    }
+    rs->phase = 0;
+    rs->pos = 0;
+    memset(rs->hist, 0, sizeof(rs->hist));
+}
+
+size_t audio_resampler_max_output(const audio_resampler_t *rs, size_t in_samples)
+{
+    if (!rs) {
+        return 0;
+    }
+    if (rs->up == rs->down) {
+        return in_samples;
+    }
+    // 本次输入覆盖上采样域的 [0, n*L)，输出落在 phase, phase+M, ...
+    uint64_t span = (uint64_t)in_samples * rs->up;
+    if (span <= rs->phase) {
+        return 0;
+    }
+    return (size_t)((span - rs->phase + rs->down - 1) / rs->down);
+}
+
+esp_err_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_samples,
+                                  int16_t *out, size_t out_capacity, size_t *out_samples)
+{
+    if (!rs || !out_samples || (in_samples && (!in || !out))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (audio_resampler_max_output(rs, in_samples) > out_capacity) {
+        *out_samples = 0;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (rs->up == rs->down) {
+        memcpy(out, in, in_samples * sizeof(int16_t));
+        *out_samples = in_samples;
+        return ESP_OK;
+    }
+
+    const uint32_t up = rs->up;
+    const uint32_t down = rs->down;
+    const uint32_t shift = rs->shift;
+    uint32_t phase = rs->phase;
+    uint32_t pos = rs->pos;
+    size_t n = 0;
+
+    for (size_t i = 0; i < in_samples; i++) {
+        rs->hist[pos] = in[i];
+        rs->hist[pos + TAPS] = in[i];
+        pos = pos + 1 == TAPS ? 0 : pos + 1;
+
+        while (phase < up) {
+            out[n++] = fir_dot(&rs->hist[pos], rs->coefs + phase * TAPS, shift);
+            phase += down;
+        }
+        phase -= up;
+    }
+
+    rs->phase = phase;
+    rs->pos = pos;
+    *out_samples = n;
+    return ESP_OK;
+}
@@ -0,0 +1,86 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 22:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 22:00:00
+ * @FilePath: \esp-chunfeng\main\Audio\audio_resampler.h
+ * @Description: 流式多相定点重采样器
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_RESAMPLER_TAPS        32      ///< 每个相位的抽头数
+#define AUDIO_RESAMPLER_MAX_PHASES  640     ///< 化简后插值倍数的上限（例如 22050→16000 为320）
+
+/**
+ * @brief 重采样器句柄
+ */
+typedef struct audio_resampler_t audio_resampler_t;
+
+/**
+ * @brief 创建重采样器
+ *
+ * 按 out_rate/in_rate 化简成 L/M，设计一个 L*AUDIO_RESAMPLER_TAPS 阶的Kaiser窗低通
+ * （截止在两个采样率中较低者奈奎斯特频率的90%），量化成Q15（系数绝对值之和超过2.0时Q14）多相系数表。
+ * 系数只在创建时计算一次，处理过程全部是定点运算。
+ *
+ * @param in_rate 输入采样率
+ * @param out_rate 输出采样率
+ * @return audio_resampler_t* 重采样器句柄，失败（参数无效、比例过于复杂或内存不足）返回NULL
+ */
+audio_resampler_t *audio_resampler_create(uint32_t in_rate, uint32_t out_rate);
+
+/**
+ * @brief 销毁重采样器
+ *
+ * @param rs 重采样器句柄
+ */
+void audio_resampler_destroy(audio_resampler_t *rs);
+
+/**
+ * @brief 清空滤波器历史和相位，开始新的一段音频
+ *
+ * @param rs 重采样器句柄
+ */
+void audio_resampler_reset(audio_resampler_t *rs);
+
+/**
+ * @brief 处理in_samples个输入最多产生的输出样本数
+ *
+ * @param rs 重采样器句柄
+ * @param in_samples 输入样本数
+ * @return size_t 输出缓冲区至少需要的样本数
+ */
+size_t audio_resampler_max_output(const audio_resampler_t *rs, size_t in_samples);
+
+/**
+ * @brief 重采样一段16位单声道PCM
+ *
+ * 滤波器历史和相位跨调用保存，输入可以任意切块，块边界不会产生咔哒声。
+ * 输入输出采样率相同时直接拷贝。
+ *
+ * @param rs 重采样器句柄
+ * @param in 输入PCM
+ * @param in_samples 输入样本数
+ * @param out 输出PCM
+ * @param out_capacity 输出缓冲区容量（样本数），不小于 audio_resampler_max_output
+ * @param out_samples 实际输出的样本数（输出参数）
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_ARG: 参数无效
+ *         - ESP_ERR_INVALID_SIZE: 输出缓冲区不够，没有处理任何输入
+ */
+esp_err_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_samples,
+                                  int16_t *out, size_t out_capacity, size_t *out_samples);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,97 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 21:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 21:00:00
+ * @FilePath: \esp-chunfeng\main\Audio\audio_vad.c
+ * @Description: 轻量定点语音活动检测实现
+ *
+ */
+#include "audio_vad.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define NOISE_FLOOR_INIT_Q4     (16 * 16)   // 上电时的噪声底，几帧静音后收敛到实际值
+#define NOISE_TRACK_SHIFT       3           // 静音帧跟踪噪声底的速度（1/8）
+#define NOISE_CREEP_SHIFT       10          // 活动帧让噪声底缓慢上升的速度，持续不断的新噪声约30秒后被吸收
+
+void audio_vad_init(audio_vad_t *vad, const audio_vad_config_t *cfg)
+{
+    static const audio_vad_config_t default_cfg = AUDIO_VAD_DEFAULT_CONFIG();
+
+    memset(vad, 0, sizeof(*vad));
+    vad->cfg = cfg ? *cfg : default_cfg;
+    if (vad->cfg.onset_frames == 0) {
+        vad->cfg.onset_frames = 1;
+    }
+    vad->noise_floor_q4 = NOISE_FLOOR_INIT_Q4;
+}
+
+void audio_vad_reset(audio_vad_t *vad)
+{
+    vad->state = AUDIO_VAD_SILENCE;
+    vad->active_run = 0;
+    vad->hang = 0;
+    vad->silent_frames = 0;
+}
+
+audio_vad_event_t audio_vad_process(audio_vad_t *vad, const int16_t *frame, size_t count)
+{
+    if (count == 0) {
+        return AUDIO_VAD_EVENT_NONE;
+    }
+
+    // 平均幅度代替均方能量：不需要乘法，512个样本的和也不会溢出
+    uint32_t sum = 0;
+    uint32_t crossings = 0;
+    int32_t prev = frame[0];
+    for (size_t i = 0; i < count; i++) {
+        int32_t x = frame[i];
+        sum += (uint32_t)(x < 0 ? -x : x);
+        crossings += (uint32_t)((x ^ prev) < 0);
+        prev = x;
+    }
+    vad->level = sum / count;
+    vad->zcr_q8 = (uint16_t)((crossings << 8) / count);
+
+    // 活动门限：噪声底的若干倍，且不低于绝对下限；过零率高的帧（摩擦音或宽带噪声）要求两倍能量
+    uint32_t threshold = (uint32_t)(((uint64_t)vad->noise_floor_q4 * vad->cfg.level_ratio_q4) >> 8);
+    if (threshold < vad->cfg.min_level) {
+        threshold = vad->cfg.min_level;
+    }
+    bool active = vad->level >= threshold &&
+                  (vad->zcr_q8 <= vad->cfg.zcr_max_q8 || vad->level >= threshold * 2);
+
+    // 噪声底：静音帧快速跟踪，活动帧只允许缓慢上升
+    int32_t diff = (int32_t)(vad->level << 4) - (int32_t)vad->noise_floor_q4;
+    int32_t floor_q4 = (int32_t)vad->noise_floor_q4 + (diff >> (active ? NOISE_CREEP_SHIFT : NOISE_TRACK_SHIFT));
+    vad->noise_floor_q4 = floor_q4 < 16 ? 16 : (uint32_t)floor_q4;
+
+    if (active) {
+        vad->silent_frames = 0;
+    } else {
+        vad->silent_frames++;
+    }
+
+    if (vad->state == AUDIO_VAD_SILENCE) {
+        vad->active_run = active ? vad->active_run + 1 : 0;
+        if (vad->active_run >= vad->cfg.onset_frames) {
+            vad->state = AUDIO_VAD_SPEECH;
+            vad->hang = vad->cfg.hangover_frames;
+            return AUDIO_VAD_EVENT_SPEECH_START;
+        }
+        return AUDIO_VAD_EVENT_NONE;
+    }
+
+    if (active) {
+        vad->hang = vad->cfg.hangover_frames;
+    } else if (vad->hang > 0) {
+        vad->hang--;
+    }
+    if (vad->hang == 0) {
+        vad->state = AUDIO_VAD_SILENCE;
+        vad->active_run = 0;
+        return AUDIO_VAD_EVENT_SPEECH_END;
+    }
+    return AUDIO_VAD_EVENT_NONE;
+}
@@ -0,0 +1,101 @@
+/*
+ * @Author: xingnian j_xingnian@163.com
+ * @Date: 2026-10-17 21:00:00
+ * @LastEditors: xingnian j_xingnian@163.com
+ * @LastEditTime: 2026-10-17 21:00:00
+ * @FilePath: \esp-chunfeng\main\Audio\audio_vad.h
+ * @Description: 轻量定点语音活动检测（能量 + 过零率 + 拖尾保持）
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 默认配置，帧数按 AUDIO_MIC_FRAME_SAMPLES（16kHz下32ms）一帧计算
+ */
+#define AUDIO_VAD_DEFAULT_CONFIG() {    \
+    .min_level = 60,                    \
+    .level_ratio_q4 = 48,               \
+    .zcr_max_q8 = 90,                   \
+    .onset_frames = 2,                  \
+    .hangover_frames = 10,              \
+}
+
+/**
+ * @brief 检测状态
+ */
+typedef enum {
+    AUDIO_VAD_SILENCE = 0,      ///< 静音
+    AUDIO_VAD_SPEECH,           ///< 语音（包括最后一帧语音之后的拖尾保持）
+} audio_vad_state_t;
+
+/**
+ * @brief 状态切换事件
+ */
+typedef enum {
+    AUDIO_VAD_EVENT_NONE = 0,       ///< 状态没有变化
+    AUDIO_VAD_EVENT_SPEECH_START,   ///< 静音 → 语音
+    AUDIO_VAD_EVENT_SPEECH_END,     ///< 语音 → 静音（拖尾结束）
+} audio_vad_event_t;
+
+/**
+ * @brief 检测参数
+ */
+typedef struct {
+    uint32_t min_level;         ///< 平均幅度下限，低于此值的帧一律视为静音
+    uint16_t level_ratio_q4;    ///< 活动门限为噪声底的多少倍（Q4，48为3倍）
+    uint16_t zcr_max_q8;        ///< 浊音的最大过零率（每样本过零次数，Q8）；超过时要求两倍能量，滤掉风扇声等宽带噪声
+    uint16_t onset_frames;      ///< 连续多少帧活动才判为语音开始，滤掉按键声等短脉冲
+    uint16_t hangover_frames;   ///< 最后一帧活动之后保持语音状态的帧数，避免字间停顿被切断
+} audio_vad_config_t;
+
+/**
+ * @brief 检测器状态
+ */
+typedef struct {
+    audio_vad_config_t cfg;     ///< 检测参数
+    audio_vad_state_t state;    ///< 当前状态
+    uint32_t noise_floor_q4;    ///< 噪声底（平均幅度，Q4），静音时快速跟踪，语音时缓慢上升
+    uint32_t level;             ///< 最近一帧的平均幅度
+    uint16_t zcr_q8;            ///< 最近一帧的过零率（Q8）
+    uint16_t active_run;        ///< 连续活动帧数
+    uint16_t hang;              ///< 剩余拖尾帧数
+    uint32_t silent_frames;     ///< 距离最后一帧活动的帧数
+} audio_vad_t;
+
+/**
+ * @brief 初始化检测器
+ *
+ * @param vad 检测器
+ * @param cfg 检测参数，NULL使用 AUDIO_VAD_DEFAULT_CONFIG
+ */
+void audio_vad_init(audio_vad_t *vad, const audio_vad_config_t *cfg);
+
+/**
+ * @brief 清除语音状态，保留已经学到的噪声底
+ *
+ * @param vad 检测器
+ */
+void audio_vad_reset(audio_vad_t *vad);
+
+/**
+ * @brief 处理一帧
+ *
+ * 每帧只需一次遍历和两次除法，不分配内存。
+ *
+ * @param vad 检测器
+ * @param frame 16位PCM
+ * @param count 样本数
+ * @return audio_vad_event_t 本帧引起的状态切换
+ */
+audio_vad_event_t audio_vad_process(audio_vad_t *vad, const int16_t *frame, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,14 +4,20 @@
  */
 #include "button_voice.h"
 #include "audio_hal.h"
+#include "audio_player.h"
+#include "audio_vad.h"
 #include "esp_coze_events.h"
+#include "sdkconfig.h"
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+#include "opus_audio_encoder.h"
+#endif
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
 #include "esp_timer.h"
-#include "mbedtls/base64.h"
+#include "esp_heap_caps.h"
 #include "lottie_manager.h"
 #include <string.h>
 #include <stdlib.h>
@@ -20,20 +26,62 @@
 
 static const char *TAG = "BUTTON_VOICE";
 
-#define RECORDING_FRAME_SIZE    512    // 每次录音的样本数
 #define MAX_RECORDING_DURATION  30000  // 最大录音时长（毫秒）
 #define DEBOUNCE_TIME_MS        50     // 按键防抖时间
+#define PREROLL_MS              300    // 按下之前保留的录音时长，避免第一个字被截掉
+#define PREROLL_SAMPLES         (AUDIO_SAMPLE_RATE_HZ * PREROLL_MS / 1000)
+
+// 录音任务通知位
+#define CAPTURE_NOTIFY_START    (1 << 0)  // 按下：发送预录音并开始上行
+#define CAPTURE_NOTIFY_STOP     (1 << 1)  // 松开：提交剩余音频和complete
+#define CAPTURE_NOTIFY_EXIT     (1 << 2)  // 反初始化：退出任务
+#define CAPTURE_NOTIFY_MODE     (1 << 3)  // 切换免提模式：按 s_ctx.hands_free 开始/结束连续上行
+
+#if CONFIG_COZE_HANDS_FREE
+// 免提模式下VAD判为静音后继续上行的时长，比服务端的静音判定略长，让服务端看到说话结束
+#define HANDS_FREE_TAIL_MS      (CONFIG_COZE_HANDS_FREE_SILENCE_MS + 300)
+#endif
 
 typedef struct {
     QueueHandle_t gpio_queue;
     TaskHandle_t button_task;
     TaskHandle_t record_task;
     bool recording;
+    bool hands_free;
     bool initialized;
     int64_t last_press_time;
     char current_event_id[64];
 } button_voice_ctx_t;
 
+/**
+ * @brief 预录音环形缓冲：没按键时录音任务也一直在读麦克风，只保留最近PREROLL_MS的音频
+ */
+static EXT_RAM_BSS_ATTR int16_t s_preroll[PREROLL_SAMPLES];
+static size_t s_preroll_pos = 0;    // 下一个写入位置
+static size_t s_preroll_fill = 0;   // 有效样本数
+
+// 正在上行的事件ID，开始时从current_event_id拷贝，松开后马上再按也不会串到上一段
+static char s_stream_event_id[64];
+
+#if CONFIG_COZE_UPLINK_VAD
+#define VAD_FRAME_MS (AUDIO_MIC_FRAME_SAMPLES * 1000 / AUDIO_SAMPLE_RATE_HZ)
+
+/**
+ * @brief 静音抑制状态：录音任务一直跑VAD，上行期间只有语音段（连同前面的预录音）会发出
+ */
+static struct {
+    audio_vad_t vad;
+    bool gate_open;             // 当前帧是否上行
+    bool speech_seen;           // 本次按键是否检测到过语音
+    uint32_t captured_frames;   // 本次按键录到的帧数
+    uint32_t sent_samples;      // 本次按键实际上行的样本数
+} s_sil;
+#endif
+
+// 语音活动回调（UI用），在录音任务中调用
+static button_voice_vad_cb_t s_vad_cb = NULL;
+static void *s_vad_cb_ctx = NULL;
+
 static button_voice_ctx_t s_ctx = {0};
 
 // 按键处理任务栈 - 放在PSRAM
@@ -41,69 +89,477 @@ static button_voice_ctx_t s_ctx = {0};
 static EXT_RAM_BSS_ATTR StackType_t button_task_stack[BUTTON_TASK_STACK_SIZE];
 static StaticTask_t button_task_buffer;
 
-// 录音任务栈 - 放在PSRAM  
+// 录音任务栈 - 放在PSRAM，Opus编码需要较大的栈
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+#define RECORD_TASK_STACK_SIZE (24576 / sizeof(StackType_t))
+#else
 #define RECORD_TASK_STACK_SIZE (4096 / sizeof(StackType_t))
+#endif
 static EXT_RAM_BSS_ATTR StackType_t record_task_stack[RECORD_TASK_STACK_SIZE];
 static StaticTask_t record_task_buffer;
 
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+#define OPUS_MAX_PACKET_SIZE 1276   // 单个Opus包的最大字节数
+
+/**
+ * @brief Opus上行状态：录音帧凑满一个Opus帧就编码，每个Opus包单独作为一条append发送
+ */
+static struct {
+    opus_audio_encoder_t *encoder;
+    int16_t *pcm;           // 未凑满一帧的PCM
+    size_t pcm_len;         // pcm中的样本数
+    size_t frame_samples;   // 一个Opus帧的样本数
+    uint8_t *packet;        // 编码输出
+} s_opus;
+
+/**
+ * @brief 创建Opus编码器和缓冲区，整个运行期间复用
+ */
+static esp_err_t uplink_opus_init(void)
+{
+    opus_audio_encoder_config_t config = {
+        .sample_rate = AUDIO_SAMPLE_RATE_HZ,
+        .channels = 1,
+        .bitrate = CONFIG_COZE_UPLINK_OPUS_BITRATE,
+        .frame_duration_ms = CONFIG_COZE_UPLINK_OPUS_FRAME_MS,
+        .complexity = CONFIG_COZE_UPLINK_OPUS_COMPLEXITY,
+    };
+    s_opus.encoder = opus_audio_encoder_create(&config);
+    if (!s_opus.encoder) {
+        return ESP_FAIL;
+    }
+
+    s_opus.frame_samples = opus_audio_encoder_get_frame_samples(s_opus.encoder);
+    s_opus.pcm = heap_caps_malloc(s_opus.frame_samples * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (!s_opus.pcm) {
+        s_opus.pcm = malloc(s_opus.frame_samples * sizeof(int16_t));
+    }
+    s_opus.packet = malloc(OPUS_MAX_PACKET_SIZE);
+    if (!s_opus.pcm || !s_opus.packet) {
+        ESP_LOGE(TAG, "Opus缓冲区分配失败");
+        free(s_opus.pcm);
+        free(s_opus.packet);
+        opus_audio_encoder_destroy(s_opus.encoder);
+        memset(&s_opus, 0, sizeof(s_opus));
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void uplink_opus_deinit(void)
+{
+    if (s_opus.encoder) {
+        opus_audio_encoder_destroy(s_opus.encoder);
+    }
+    free(s_opus.pcm);
+    free(s_opus.packet);
+    memset(&s_opus, 0, sizeof(s_opus));
+}
+
+/**
+ * @brief 编码缓冲中的一帧并发送
+ */
+static void uplink_opus_send_frame(void)
+{
+    size_t len = 0;
+    if (opus_audio_encoder_encode(s_opus.encoder, s_opus.pcm, s_opus.frame_samples,
+                                  s_opus.packet, OPUS_MAX_PACKET_SIZE, &len) == ESP_OK && len > 0) {
+        esp_coze_send_input_audio_buffer_append_raw_event(s_stream_event_id, s_opus.packet, len);
+    }
+    s_opus.pcm_len = 0;
+}
+#endif
+
+/**
+ * @brief 开始上行一段语音
+ */
+static void uplink_begin(void)
+{
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+    opus_audio_encoder_reset(s_opus.encoder);
+    s_opus.pcm_len = 0;
+#else
+    // 逐帧合并成60~120ms一批再发送，减少消息和TLS记录的固定开销
+    esp_coze_audio_batch_begin(s_stream_event_id, AUDIO_SAMPLE_RATE_HZ * sizeof(int16_t));
+#endif
+}
+
+/**
+ * @brief 上行一段录音
+ */
+static void uplink_write(const int16_t *samples, size_t count)
+{
+#if CONFIG_COZE_UPLINK_VAD
+    s_sil.sent_samples += count;
+#endif
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+    while (count > 0) {
+        size_t n = s_opus.frame_samples - s_opus.pcm_len;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(s_opus.pcm + s_opus.pcm_len, samples, n * sizeof(int16_t));
+        s_opus.pcm_len += n;
+        samples += n;
+        count -= n;
+        if (s_opus.pcm_len == s_opus.frame_samples) {
+            uplink_opus_send_frame();
+        }
+    }
+#else
+    // PCM直接base64编码进正在填充的append消息，凑够一批时提交
+    esp_coze_audio_batch_write(samples, count * sizeof(int16_t));
+#endif
+}
+
+/**
+ * @brief 结束一段语音，提交剩余音频，之后按键任务才发送complete
+ */
+static void uplink_end(void)
+{
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+    // 最后不满一帧的部分补静音后发出
+    if (s_opus.pcm_len > 0) {
+        memset(s_opus.pcm + s_opus.pcm_len, 0, (s_opus.frame_samples - s_opus.pcm_len) * sizeof(int16_t));
+        uplink_opus_send_frame();
+    }
+#else
+    esp_coze_audio_batch_end();
+#endif
+}
+
 static void IRAM_ATTR gpio_isr_handler(void *arg)
 {
     uint32_t gpio_num = (uint32_t)arg;
     xQueueSendFromISR(s_ctx.gpio_queue, &gpio_num, NULL);
 }
 
-static void recording_task(void *arg)
+/**
+ * @brief 把一帧写入预录音环形缓冲，满了覆盖最老的样本
+ */
+static void preroll_push(const int16_t *samples, size_t count)
 {
-    int16_t *frame_buffer = (int16_t *)malloc(RECORDING_FRAME_SIZE * sizeof(int16_t));
-    if (!frame_buffer) {
-        ESP_LOGE(TAG, "录音缓冲区分配失败");
-        s_ctx.recording = false;
-        vTaskDelete(NULL);
+    if (count >= PREROLL_SAMPLES) {
+        memcpy(s_preroll, samples + count - PREROLL_SAMPLES, sizeof(s_preroll));
+        s_preroll_pos = 0;
+        s_preroll_fill = PREROLL_SAMPLES;
         return;
     }
 
-    ESP_LOGI(TAG, "开始录音");
+    size_t first = PREROLL_SAMPLES - s_preroll_pos;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(s_preroll + s_preroll_pos, samples, first * sizeof(int16_t));
+    memcpy(s_preroll, samples + first, (count - first) * sizeof(int16_t));
+    s_preroll_pos = (s_preroll_pos + count) % PREROLL_SAMPLES;
+    s_preroll_fill = s_preroll_fill + count > PREROLL_SAMPLES ? PREROLL_SAMPLES : s_preroll_fill + count;
+}
+
+/**
+ * @brief 按时间顺序上行预录音并清空
+ */
+static void preroll_flush(void)
+{
+    size_t start = (s_preroll_pos + PREROLL_SAMPLES - s_preroll_fill) % PREROLL_SAMPLES;
+    size_t first = PREROLL_SAMPLES - start;
+    if (first > s_preroll_fill) {
+        first = s_preroll_fill;
+    }
+    if (first > 0) {
+        uplink_write(s_preroll + start, first);
+    }
+    if (s_preroll_fill > first) {
+        uplink_write(s_preroll, s_preroll_fill - first);
+    }
+    s_preroll_pos = 0;
+    s_preroll_fill = 0;
+}
 
-    int64_t start_time = esp_timer_get_time() / 1000;
+#if CONFIG_COZE_UPLINK_VAD
+/**
+ * @brief 通知UI语音活动变化
+ */
+static void vad_notify(button_voice_vad_event_t event)
+{
+    button_voice_vad_cb_t cb = s_vad_cb;
+    if (cb) {
+        cb(event, s_vad_cb_ctx);
+    }
+}
+#endif
 
-    while (s_ctx.recording) {
-        // 检查录音时长
-        int64_t current_time = esp_timer_get_time() / 1000;
-        if (current_time - start_time > MAX_RECORDING_DURATION) {
+/**
+ * @brief 结束本次上行：提交剩余音频后紧接着发送complete，保证顺序且不需要按键任务等待
+ */
+static void capture_finish(void)
+{
+    uplink_end();
+
+#if CONFIG_COZE_UPLINK_VAD
+    // 整段都是静音时什么都没上行，不提交，省掉一次空的识别
+    if (!s_sil.speech_seen) {
+        ESP_LOGI(TAG, "未检测到语音，不提交");
+    } else {
+        esp_coze_send_input_audio_buffer_complete_event(s_stream_event_id);
+    }
+    uint32_t captured_ms = s_sil.captured_frames * VAD_FRAME_MS;
+    uint32_t sent_ms = (uint32_t)((uint64_t)s_sil.sent_samples * 1000 / AUDIO_SAMPLE_RATE_HZ);
+    ESP_LOGI(TAG, "静音抑制：录音%u ms，上行%u ms", (unsigned)captured_ms, (unsigned)sent_ms);
+#else
+    esp_coze_send_input_audio_buffer_complete_event(s_stream_event_id);
+#endif
+
+    audio_hal_mic_stats_t stats;
+    audio_hal_mic_get_stats(&stats);
+    ESP_LOGI(TAG, "录音结束，累计%u帧，丢帧%u", (unsigned)stats.frames, (unsigned)stats.overruns);
+}
+
+#if CONFIG_COZE_UPLINK_VAD
+/**
+ * @brief 初始化静音抑制，帧数按Kconfig里的毫秒数换算
+ */
+static void silence_init(void)
+{
+    audio_vad_config_t cfg = AUDIO_VAD_DEFAULT_CONFIG();
+    cfg.min_level = CONFIG_COZE_UPLINK_VAD_MIN_LEVEL;
+    cfg.hangover_frames = CONFIG_COZE_UPLINK_VAD_HANGOVER_MS / VAD_FRAME_MS;
+    audio_vad_init(&s_sil.vad, &cfg);
+}
+
+/**
+ * @brief 开始上行：按下之前已经在说话就直接带上预录音，否则等VAD判到语音再发
+ */
+static void silence_begin(void)
+{
+    s_sil.speech_seen = s_sil.vad.state == AUDIO_VAD_SPEECH;
+    s_sil.gate_open = s_sil.speech_seen;
+    s_sil.captured_frames = 0;
+    s_sil.sent_samples = 0;
+    if (s_sil.gate_open) {
+        preroll_flush();
+        vad_notify(BUTTON_VOICE_VAD_SPEECH_START);
+    }
+}
+
+/**
+ * @brief 上行期间处理一帧
+ *
+ * 静音帧只进预录音缓冲：说话重新开始时最多补发PREROLL_MS的停顿和起音，
+ * 更长的停顿被压缩掉。免提模式下说话结束后还要再上行HANDS_FREE_TAIL_MS的静音，
+ * 服务端靠这段静音判断一轮结束。
+ *
+ * @param hands_free 是否免提连续上行
+ * @return true 静音已经持续足够久，本次上行应自动结束（免提模式总是false）
+ */
+static bool silence_stream_frame(const int16_t *frame, audio_vad_event_t event, bool hands_free)
+{
+    s_sil.captured_frames++;
+
+    if (event == AUDIO_VAD_EVENT_SPEECH_START) {
+        s_sil.speech_seen = true;
+        s_sil.gate_open = true;
+        preroll_flush();
+        vad_notify(BUTTON_VOICE_VAD_SPEECH_START);
+    } else if (event == AUDIO_VAD_EVENT_SPEECH_END) {
+        if (!hands_free) {
+            s_sil.gate_open = false;
+        }
+        vad_notify(BUTTON_VOICE_VAD_SPEECH_END);
+    }
+
+#if CONFIG_COZE_HANDS_FREE
+    if (hands_free) {
+        if (s_sil.gate_open && s_sil.vad.state == AUDIO_VAD_SILENCE &&
+            s_sil.vad.silent_frames * VAD_FRAME_MS >= HANDS_FREE_TAIL_MS) {
+            s_sil.gate_open = false;
+        }
+        if (s_sil.gate_open) {
+            uplink_write(frame, AUDIO_MIC_FRAME_SAMPLES);
+        } else {
+            preroll_push(frame, AUDIO_MIC_FRAME_SAMPLES);
+        }
+        return false;
+    }
+#endif
+
+    if (s_sil.gate_open) {
+        uplink_write(frame, AUDIO_MIC_FRAME_SAMPLES);
+    } else {
+        preroll_push(frame, AUDIO_MIC_FRAME_SAMPLES);
+    }
+
+#if CONFIG_COZE_UPLINK_VAD_END_SILENCE_MS > 0
+    return s_sil.speech_seen && s_sil.vad.silent_frames * VAD_FRAME_MS >= CONFIG_COZE_UPLINK_VAD_END_SILENCE_MS;
+#else
+    return false;
+#endif
+}
+#endif
+
+#if CONFIG_COZE_HANDS_FREE
+/**
+ * @brief 免提模式下是否因为扬声器在播放而暂停上行
+ */
+static bool echo_guard_active(void)
+{
+#if CONFIG_COZE_HANDS_FREE_ECHO_GUARD
+    return audio_player_is_playing();
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief 扬声器播放期间：不上行、不跑VAD，清掉预录音里的回声，免得播放结束后被当成用户说话补发
+ */
+static void echo_guard_mute(void)
+{
+#if CONFIG_COZE_UPLINK_VAD
+    if (s_sil.vad.state == AUDIO_VAD_SPEECH) {
+        vad_notify(BUTTON_VOICE_VAD_SPEECH_END);
+    }
+    audio_vad_reset(&s_sil.vad);
+    s_sil.gate_open = false;
+#endif
+    s_preroll_pos = 0;
+    s_preroll_fill = 0;
+}
+
+/**
+ * @brief 开始免提连续上行，不发送complete，由服务端按静音判断每一轮
+ */
+static void hands_free_begin(void)
+{
+    snprintf(s_stream_event_id, sizeof(s_stream_event_id), "hands_free_%lld", esp_timer_get_time());
+    uplink_begin();
+#if CONFIG_COZE_UPLINK_VAD
+    silence_begin();
+#endif
+    ESP_LOGI(TAG, "免提模式开始连续上行");
+}
+#endif
+
+/**
+ * @brief 结束当前上行：按键录音提交complete，免提模式只提交剩余音频
+ */
+static void capture_stop(bool hands_free)
+{
+    if (hands_free) {
+        uplink_end();
+        ESP_LOGI(TAG, "免提模式停止上行");
+    } else {
+        capture_finish();
+    }
+}
+
+/**
+ * @brief 常驻录音任务
+ *
+ * 一直读麦克风：没按键时写进预录音缓冲，按下后先发预录音再发实时音频，
+ * 松开后立即提交尾部。开始/停止由按键任务通过任务通知触发。
+ * 开启VAD时只上行语音段，说完后静音超时自动提交。
+ */
+static void recording_task(void *arg)
+{
+    bool streaming = false;
+    bool hands_free = false;    // 当前这段上行是不是免提连续上行
+    int64_t start_time = 0;
+
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, 0);
+        if (bits & CAPTURE_NOTIFY_EXIT) {
+            break;
+        }
+#if CONFIG_COZE_HANDS_FREE
+        // 切换模式：先结束正在进行的上行（按着按键时开启免提会先提交这段录音）
+        if ((bits & CAPTURE_NOTIFY_MODE) && s_ctx.hands_free != hands_free) {
+            if (streaming) {
+                capture_stop(hands_free);
+                streaming = false;
+            }
+            hands_free = s_ctx.hands_free;
+            if (hands_free) {
+                hands_free_begin();
+                streaming = true;
+            }
+        }
+        if (hands_free) {
+            bits &= ~(CAPTURE_NOTIFY_START | CAPTURE_NOTIFY_STOP);
+        }
+#endif
+        // 一帧内可能同时收到停止和开始：松开后马上又按下时先结束上一段，
+        // 按下后马上松开时开始后立即结束
+        if ((bits & CAPTURE_NOTIFY_STOP) && streaming) {
+            capture_finish();
+            streaming = false;
+        }
+        if ((bits & CAPTURE_NOTIFY_START) && !streaming) {
+            ESP_LOGI(TAG, "开始录音，预录音%d ms", (int)(s_preroll_fill * 1000 / AUDIO_SAMPLE_RATE_HZ));
+            memcpy(s_stream_event_id, s_ctx.current_event_id, sizeof(s_stream_event_id));
+            uplink_begin();
+#if CONFIG_COZE_UPLINK_VAD
+            silence_begin();
+#else
+            preroll_flush();
+#endif
+            streaming = true;
+            start_time = esp_timer_get_time() / 1000;
+        }
+        if ((bits & CAPTURE_NOTIFY_STOP) && streaming && !s_ctx.recording) {
+            capture_finish();
+            streaming = false;
+        }
+
+        // 检查录音时长，免提模式不限时长
+        if (streaming && !hands_free && esp_timer_get_time() / 1000 - start_time > MAX_RECORDING_DURATION) {
             ESP_LOGW(TAG, "录音时长超过限制，自动停止");
             s_ctx.recording = false;
-            break;
+            capture_finish();
+            streaming = false;
         }
 
-        size_t samples_read = 0;
-        esp_err_t ret = audio_hal_read(frame_buffer, RECORDING_FRAME_SIZE, &samples_read, 100);
-
-        if (ret == ESP_OK && samples_read > 0) {
-            // 将PCM转换为base64并发送
-            size_t pcm_bytes = samples_read * sizeof(int16_t);
-            size_t b64_len = ((pcm_bytes + 2) / 3) * 4 + 1;
-            char *b64_buffer = (char *)malloc(b64_len);
-
-            if (b64_buffer) {
-                size_t out_len = 0;
-                int b64_ret = mbedtls_base64_encode((unsigned char *)b64_buffer, b64_len, &out_len,
-                                                    (const unsigned char *)frame_buffer, pcm_bytes);
-
-                if (b64_ret == 0) {
-                    b64_buffer[out_len] = '\0';
-                    // 发送音频片段
-                    esp_coze_send_input_audio_buffer_append_event(s_ctx.current_event_id,
-                                                                  (const uint8_t *)b64_buffer, strlen(b64_buffer));
-                }
-                free(b64_buffer);
-            }
+        // 等I2S接收中断交来下一帧，帧节奏由DMA决定
+        const int16_t *frame = NULL;
+        if (audio_hal_mic_wait_frame(&frame, 100) != ESP_OK) {
+            continue;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(10));
+#if CONFIG_COZE_HANDS_FREE
+        if (hands_free && echo_guard_active()) {
+            echo_guard_mute();
+            audio_hal_mic_release_frame();
+            continue;
+        }
+#endif
+
+#if CONFIG_COZE_UPLINK_VAD
+        // 没按键时也跑VAD，噪声底一直在跟踪，按下时已经知道是否正在说话
+        audio_vad_event_t event = audio_vad_process(&s_sil.vad, frame, AUDIO_MIC_FRAME_SAMPLES);
+        if (!streaming) {
+            preroll_push(frame, AUDIO_MIC_FRAME_SAMPLES);
+        } else if (silence_stream_frame(frame, event, hands_free)) {
+            ESP_LOGI(TAG, "检测到说话结束，自动提交");
+            s_ctx.recording = false;
+            capture_finish();
+            streaming = false;
+            vad_notify(BUTTON_VOICE_VAD_UTTERANCE_END);
+        }
+#else
+        if (streaming) {
+            uplink_write(frame, AUDIO_MIC_FRAME_SAMPLES);
+        } else {
+            preroll_push(frame, AUDIO_MIC_FRAME_SAMPLES);
+        }
+#endif
+        audio_hal_mic_release_frame();
     }
 
-    free(frame_buffer);
-    ESP_LOGI(TAG, "录音结束");
+    if (streaming) {
+        capture_stop(hands_free);
+    }
+    s_ctx.record_task = NULL;
     vTaskDelete(NULL);
 }
 
@@ -123,6 +579,16 @@ static void button_task(void *arg)
 
             int level = gpio_get_level(BUTTON_GPIO_NUM);
 
+            // 免提模式下一直在上行，按键只用来打断当前回复
+            if (s_ctx.hands_free) {
+                if (level == 0) {
+                    ESP_LOGI(TAG, "按键按下，打断回复");
+                    esp_coze_send_conversation_cancel_event(NULL);
+                    audio_player_flush();
+                }
+                continue;
+            }
+
             if (level == 0 && !s_ctx.recording) {  // 按下（GPIO0在boot0按下时为低电平）
                 ESP_LOGI(TAG, "按键按下，开始录音");
 
@@ -144,27 +610,9 @@ static void button_task(void *arg)
                 // 发送打断事件
                 esp_coze_send_conversation_cancel_event(NULL);
 
-                // 开始录音
+                // 开始录音：录音任务常驻，只需通知它开始上行
                 s_ctx.recording = true;
-                // 使用静态任务创建录音任务，栈在PSRAM
-                s_ctx.record_task = xTaskCreateStatic(
-                    recording_task,         // 任务函数
-                    "record_task",          // 任务名称
-                    RECORD_TASK_STACK_SIZE, // 栈大小
-                    NULL,                   // 任务参数
-                    6,                      // 优先级
-                    record_task_stack,      // 栈数组(PSRAM)
-                    &record_task_buffer     // 任务控制块(内部RAM)
-                );
-                
-                if (s_ctx.record_task == NULL) {
-                    ESP_LOGE(TAG, "创建录音任务失败");
-                    s_ctx.recording = false;
-                    // 录音任务创建失败时，停止动画
-                    lottie_manager_stop_anim(LOTTIE_ANIM_MIC);
-                    // lottie_manager_stop_anim(LOTTIE_ANIM_THINK);
-                    ESP_LOGI(TAG, "录音失败，麦克风动画已停止");
-                }
+                xTaskNotify(s_ctx.record_task, CAPTURE_NOTIFY_START, eSetBits);
 
             } else if (level == 1 && s_ctx.recording) {  // 松开
                 ESP_LOGI(TAG, "按键松开，停止录音");
@@ -173,20 +621,9 @@ static void button_task(void *arg)
                 lottie_manager_stop_anim(LOTTIE_ANIM_MIC);
                 ESP_LOGI(TAG, "麦克风动画已停止");
 
-                // 停止录音
+                // 停止录音：录音任务收到通知后立即提交尾部音频和complete
                 s_ctx.recording = false;
-
-                // 等待录音任务结束
-                if (s_ctx.record_task) {
-                    int retry = 100;
-                    while (s_ctx.record_task && retry-- > 0) {
-                        vTaskDelay(pdMS_TO_TICKS(10));
-                    }
-                    s_ctx.record_task = NULL;
-                }
-
-                // 发送提交事件
-                esp_coze_send_input_audio_buffer_complete_event(s_ctx.current_event_id);
+                xTaskNotify(s_ctx.record_task, CAPTURE_NOTIFY_STOP, eSetBits);
             }
         }
     }
@@ -201,6 +638,15 @@ esp_err_t button_voice_init(void)
     // 初始化音频HAL
     ESP_ERROR_CHECK(audio_hal_init());
 
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+    // 创建上行Opus编码器
+    esp_err_t ret = uplink_opus_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Opus编码器初始化失败");
+        return ret;
+    }
+#endif
+
     // 配置GPIO
     gpio_config_t io_conf = {
         .intr_type = GPIO_INTR_ANYEDGE,
@@ -221,6 +667,32 @@ esp_err_t button_voice_init(void)
     ESP_ERROR_CHECK(gpio_install_isr_service(0));
     ESP_ERROR_CHECK(gpio_isr_handler_add(BUTTON_GPIO_NUM, gpio_isr_handler, (void *)BUTTON_GPIO_NUM));
 
+#if CONFIG_COZE_UPLINK_VAD
+    silence_init();
+#endif
+
+    // 创建常驻录音任务 - 使用静态任务，栈在PSRAM，启动后立即开始填充预录音
+    s_ctx.record_task = xTaskCreateStatic(
+        recording_task,             // 任务函数
+        "record_task",              // 任务名称
+        RECORD_TASK_STACK_SIZE,     // 栈大小
+        NULL,                       // 任务参数
+        6,                          // 优先级
+        record_task_stack,          // 栈数组(PSRAM)
+        &record_task_buffer         // 任务控制块(内部RAM)
+    );
+
+    if (s_ctx.record_task == NULL) {
+        ESP_LOGE(TAG, "创建录音任务失败");
+        gpio_isr_handler_remove(BUTTON_GPIO_NUM);
+        gpio_uninstall_isr_service();
+        vQueueDelete(s_ctx.gpio_queue);
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+        uplink_opus_deinit();
+#endif
+        return ESP_ERR_NO_MEM;
+    }
+
     // 创建按键处理任务 - 使用静态任务，栈在PSRAM
     s_ctx.button_task = xTaskCreateStatic(
         button_task,                // 任务函数
@@ -233,9 +705,13 @@ esp_err_t button_voice_init(void)
     );
     
     if (s_ctx.button_task == NULL) {
+        xTaskNotify(s_ctx.record_task, CAPTURE_NOTIFY_EXIT, eSetBits);
         gpio_isr_handler_remove(BUTTON_GPIO_NUM);
         gpio_uninstall_isr_service();
         vQueueDelete(s_ctx.gpio_queue);
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+        uplink_opus_deinit();
+#endif
         return ESP_ERR_NO_MEM;
     }
 
@@ -260,9 +736,13 @@ void button_voice_deinit(void)
         s_ctx.button_task = NULL;
     }
 
+    // 通知录音任务退出（正在录音时会先提交已录的音频），等它结束
     if (s_ctx.record_task) {
-        vTaskDelete(s_ctx.record_task);
-        s_ctx.record_task = NULL;
+        xTaskNotify(s_ctx.record_task, CAPTURE_NOTIFY_EXIT, eSetBits);
+        int retry = 50;
+        while (s_ctx.record_task && retry-- > 0) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
     }
 
     gpio_isr_handler_remove(BUTTON_GPIO_NUM);
@@ -273,6 +753,10 @@ void button_voice_deinit(void)
         s_ctx.gpio_queue = NULL;
     }
 
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+    uplink_opus_deinit();
+#endif
+
     s_ctx.initialized = false;
     ESP_LOGI(TAG, "按键语音输入模块已销毁");
 }
@@ -281,3 +765,43 @@ bool button_voice_is_recording(void)
 {
     return s_ctx.recording;
 }
+
+esp_err_t button_voice_set_hands_free(bool enable)
+{
+#if CONFIG_COZE_HANDS_FREE
+    if (!s_ctx.initialized || !s_ctx.record_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_ctx.hands_free == enable) {
+        return ESP_OK;
+    }
+    s_ctx.hands_free = enable;
+    if (enable) {
+        s_ctx.recording = false;
+    }
+    xTaskNotify(s_ctx.record_task, CAPTURE_NOTIFY_MODE, eSetBits);
+    return ESP_OK;
+#else
+    return enable ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+#endif
+}
+
+bool button_voice_is_hands_free(void)
+{
+    return s_ctx.hands_free;
+}
+
+void button_voice_set_vad_callback(button_voice_vad_cb_t cb, void *user_ctx)
+{
+    s_vad_cb_ctx = user_ctx;
+    s_vad_cb = cb;
+}
+
+bool button_voice_is_speaking(void)
+{
+#if CONFIG_COZE_UPLINK_VAD
+    return s_sil.vad.state == AUDIO_VAD_SPEECH;
+#else
+    return false;
+#endif
+}
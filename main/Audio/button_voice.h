@@ -14,6 +14,23 @@ extern "C" {
 
 #define BUTTON_GPIO_NUM GPIO_NUM_0  ///< boot0引脚作为按键
 
+/**
+ * @brief 语音活动事件（CONFIG_COZE_UPLINK_VAD 开启时上报）
+ */
+typedef enum {
+    BUTTON_VOICE_VAD_SPEECH_START = 0,  ///< 检测到开始说话，开始上行
+    BUTTON_VOICE_VAD_SPEECH_END,        ///< 说话停顿，暂停上行
+    BUTTON_VOICE_VAD_UTTERANCE_END,     ///< 静音超时，已自动发送complete并结束录音
+} button_voice_vad_event_t;
+
+/**
+ * @brief 语音活动回调，在录音任务中调用，不要阻塞
+ *
+ * @param event 事件
+ * @param user_ctx 注册时传入的用户参数
+ */
+typedef void (*button_voice_vad_cb_t)(button_voice_vad_event_t event, void *user_ctx);
+
 /**
  * @brief 初始化按键语音输入模块
  * @return esp_err_t
@@ -31,6 +48,41 @@ void button_voice_deinit(void);
  */
 bool button_voice_is_recording(void);
 
+/**
+ * @brief 开启或关闭免提连续对话（需要 CONFIG_COZE_HANDS_FREE）
+ *
+ * 开启后录音任务连续上行、不再发送complete，由服务端的server_vad判断每一轮何时结束，
+ * 调用方需要先通过chat.update协商好turn_detection；按键改为打断当前回复。
+ * 按着按键时开启会先提交这段录音。
+ *
+ * @param enable true开启，false回到按键说话
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_INVALID_STATE: 模块未初始化
+ *         - ESP_ERR_NOT_SUPPORTED: 未开启 CONFIG_COZE_HANDS_FREE
+ */
+esp_err_t button_voice_set_hands_free(bool enable);
+
+/**
+ * @brief 检查是否处于免提模式
+ * @return true 免提连续对话，false 按键说话
+ */
+bool button_voice_is_hands_free(void);
+
+/**
+ * @brief 注册语音活动回调，供UI显示说话状态
+ *
+ * @param cb 回调，NULL取消注册
+ * @param user_ctx 用户参数
+ */
+void button_voice_set_vad_callback(button_voice_vad_cb_t cb, void *user_ctx);
+
+/**
+ * @brief 检查VAD当前是否判定为正在说话
+ * @return true 正在说话；未开启VAD时总是false
+ */
+bool button_voice_is_speaking(void);
+
 #ifdef __cplusplus
 }
 #endif
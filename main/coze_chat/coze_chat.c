@@ -22,12 +22,40 @@
 #include "esp_coze_chat_config.h"
 #include "audio_hal.h"
 #include "audio_player.h"
+#include "audio_resampler.h"
 #include "button_voice.h"
 #include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#if CONFIG_COZE_HANDS_FREE || CONFIG_COZE_UPLINK_VAD
+#include "lottie_manager.h"
+#endif
 
 // 日志标签
 static const char *TAG = "COZE_CHAT_APP";
 
+#define DOWNLINK_CHUNK_SAMPLES      480     // 每次送入重采样器的输入样本数，输出不超过960
+
+// 协商得到的下行格式，同时用于请求output_audio、配置解码器和切换扬声器采样率
+static esp_coze_downlink_format_t s_downlink_format = ESP_COZE_DOWNLINK_FORMAT_DEFAULT();
+
+// 以下只在解析任务中使用
+static uint32_t s_downlink_rate = 0;                    // 当前下行PCM采样率
+static audio_resampler_t *s_downlink_resampler = NULL;  // 扬声器不支持下行采样率时才创建，否则为NULL直接播放
+
+static void on_audio_delta(esp_coze_dl_event_t *event, void *user_ctx);
+static void on_reply_created(esp_coze_dl_event_t *event, void *user_ctx);
+static void on_audio_completed(esp_coze_dl_event_t *event, void *user_ctx);
+#if CONFIG_COZE_UPLINK_CODEC_OPUS || CONFIG_COZE_HANDS_FREE
+static void on_chat_created(esp_coze_dl_event_t *event, void *user_ctx);
+#endif
+#if CONFIG_COZE_HANDS_FREE
+static void on_speech_started(esp_coze_dl_event_t *event, void *user_ctx);
+static void on_speech_stopped(esp_coze_dl_event_t *event, void *user_ctx);
+#endif
+#if CONFIG_COZE_UPLINK_VAD
+static void on_local_vad(button_voice_vad_event_t event, void *user_ctx);
+#endif
+
 // /**
 //  * @brief 示例3：发送语音合成事件
 //  */
@@ -47,6 +75,62 @@ static const char *TAG = "COZE_CHAT_APP";
 // }
 
 
+/**
+ * @brief 切换下行PCM采样率
+ *
+ * 扬声器能直接以该采样率播放时由播放器切换I2S时钟，不做重采样；
+ * 不能（包括之前切换失败过）时重采样到播放器当前的采样率。重采样器滤波器历史跨消息保存，消息边界不会有咔哒声。
+ *
+ * @param rate_hz 下行PCM采样率
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - ESP_ERR_NO_MEM: 重采样器创建失败
+ */
+static esp_err_t downlink_set_rate(uint32_t rate_hz)
+{
+    audio_resampler_t *rs = NULL;
+    if (audio_player_set_sample_rate(rate_hz) != ESP_OK) {
+        rs = audio_resampler_create(rate_hz, audio_player_get_sample_rate());
+        if (!rs) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    audio_resampler_destroy(s_downlink_resampler);
+    s_downlink_resampler = rs;
+    s_downlink_rate = rate_hz;
+    ESP_LOGI(TAG, "下行音频 %lu Hz，%s", (unsigned long)rate_hz,
+             rs ? "重采样后播放" : "扬声器直接播放");
+    return ESP_OK;
+}
+
+/**
+ * @brief 按扬声器能力和Kconfig中的设备配置协商下行音频格式
+ *
+ * @return esp_err_t
+ *         - ESP_OK: 成功
+ *         - 其他: 协商失败的错误码
+ */
+static esp_err_t negotiate_downlink_format(void)
+{
+    esp_coze_playback_caps_t caps = {
+        .default_rate = AUDIO_SAMPLE_RATE_HZ,
+    };
+    caps.native_rates = audio_hal_spk_supported_rates(&caps.native_rate_count);
+
+    esp_coze_downlink_profile_t profile = {
+#if CONFIG_COZE_DOWNLINK_CODEC_OPUS
+        .codec = ESP_COZE_AUDIO_CODEC_OPUS,
+        .bitrate = CONFIG_COZE_DOWNLINK_OPUS_BITRATE,
+        .frame_ms = CONFIG_COZE_DOWNLINK_OPUS_FRAME_MS,
+#else
+        .codec = ESP_COZE_AUDIO_CODEC_PCM,
+        .frame_ms = 20,
+#endif
+        .max_sample_rate = CONFIG_COZE_DOWNLINK_MAX_SAMPLE_RATE,
+    };
+    return esp_coze_negotiate_downlink_format(&caps, &profile, &s_downlink_format);
+}
+
 /**
  * @brief 初始化并启动Coze聊天服务
  *
@@ -61,12 +145,19 @@ static esp_err_t init_and_start_coze(void)
 {
     esp_err_t ret;
 
+    ret = negotiate_downlink_format();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "下行音频格式协商失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
     esp_coze_chat_config_t default_config = {
         .ws_base_url = ESP_COZE_DEFAULT_WS_BASE_URL,
         .access_token = ESP_COZE_DEFAULT_ACCESS_TOKEN,
         .bot_id = ESP_COZE_DEFAULT_BOT_ID,
         .device_id = ESP_COZE_DEFAULT_DEVICE_ID,
-        .conversation_id = ESP_COZE_DEFAULT_CONVERSATION_ID
+        .conversation_id = ESP_COZE_DEFAULT_CONVERSATION_ID,
+        .downlink_format = &s_downlink_format,
     };
     ret = esp_coze_chat_init_with_config(&default_config);
 
@@ -100,12 +191,63 @@ static esp_err_t init_and_start_coze(void)
     // ESP_LOGI(TAG, "  内部RAM: %d KB 可用", (int)(internal_free / 1024));
     // ESP_LOGI(TAG, "  PSRAM: %d KB 可用", (int)(psram_free / 1024));
 
+    // 第一段回复之前就把扬声器切到协商好的下行采样率，此时没有在播放，切换没有代价
+    ret = downlink_set_rate(s_downlink_format.sample_rate);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "下行重采样器创建失败");
+        return ret;
+    }
+
     // 初始化按键语音输入
     ret = button_voice_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "按键语音输入初始化失败: %s", esp_err_to_name(ret));
         return ret;
     }
+#if CONFIG_COZE_UPLINK_VAD
+    // 本地VAD的说话状态驱动麦克风/思考动画，按键说话模式下没有服务端VAD事件
+    button_voice_set_vad_callback(on_local_vad, NULL);
+#endif
+
+    // 注册音频事件处理函数，没有处理函数时组件会跳过音频解码
+    ret = esp_coze_register_event_handler(ESP_COZE_DL_EVENT_CONVERSATION_AUDIO_DELTA, on_audio_delta, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "注册音频事件处理函数失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // 每轮回复开始/音频结束时通知播放器的抖动缓冲
+    ret = esp_coze_register_event_handler(ESP_COZE_DL_EVENT_CONVERSATION_CHAT_CREATED, on_reply_created, NULL);
+    if (ret == ESP_OK) {
+        ret = esp_coze_register_event_handler(ESP_COZE_DL_EVENT_CONVERSATION_AUDIO_COMPLETED, on_audio_completed,
+                                              NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "注册回复事件处理函数失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+#if CONFIG_COZE_UPLINK_CODEC_OPUS || CONFIG_COZE_HANDS_FREE
+    // 会话建立后通过chat.update告诉服务端上行音频格式和轮次检测方式
+    ret = esp_coze_register_event_handler(ESP_COZE_DL_EVENT_CHAT_CREATED, on_chat_created, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "注册会话创建处理函数失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+#endif
+
+#if CONFIG_COZE_HANDS_FREE
+    // 免提模式下由服务端判断用户开始/停止说话
+    ret = esp_coze_register_event_handler(ESP_COZE_DL_EVENT_INPUT_AUDIO_BUFFER_SPEECH_STARTED, on_speech_started, NULL);
+    if (ret == ESP_OK) {
+        ret = esp_coze_register_event_handler(ESP_COZE_DL_EVENT_INPUT_AUDIO_BUFFER_SPEECH_STOPPED, on_speech_stopped,
+                                              NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "注册语音检测处理函数失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+#endif
 
     ESP_ERROR_CHECK(esp_coze_chat_start());
 
@@ -127,60 +269,140 @@ esp_err_t coze_chat_app_init(void)
     return ESP_OK;
 }
 
-/**
- * @brief 简单的线性插值采样率转换：24kHz -> 16kHz
- * @param input 输入24kHz PCM数据
- * @param input_samples 输入样本数
- * @param output 输出16kHz PCM数据缓冲区
- * @param output_capacity 输出缓冲区容量
- * @return 实际输出的样本数
- */
-static size_t resample_24k_to_16k(const int16_t *input, size_t input_samples, 
-                                  int16_t *output, size_t output_capacity)
+// 音频增量事件处理：收到PCM投递到播放器，扬声器不支持下行采样率时先重采样
+static void on_audio_delta(esp_coze_dl_event_t *event, void *user_ctx)
 {
-    if (!input || !output || input_samples == 0 || output_capacity == 0) {
-        return 0;
-    }
-    
-    // 24kHz -> 16kHz 转换比例是 2:3
-    // 每3个24kHz样本对应2个16kHz样本
-    size_t output_samples = (input_samples * 2) / 3;
-    if (output_samples > output_capacity) {
-        output_samples = output_capacity;
-    }
-    
-    // 线性插值
-    for (size_t i = 0; i < output_samples; i++) {
-        // 计算在输入中的位置 (浮点)
-        float input_pos = (float)i * 3.0f / 2.0f;
-        size_t input_idx = (size_t)input_pos;
-        float fraction = input_pos - input_idx;
-        
-        if (input_idx >= input_samples - 1) {
-            // 超出范围，使用最后一个样本
-            output[i] = input[input_samples - 1];
-        } else {
-            // 线性插值
-            int16_t sample1 = input[input_idx];
-            int16_t sample2 = input[input_idx + 1];
-            output[i] = (int16_t)(sample1 + fraction * (sample2 - sample1));
+    const int16_t *pcm = event->pcm;
+    size_t sample_count = event->pcm_samples;
+
+    if (!audio_player_running() || !pcm || sample_count == 0) return;
+
+    uint32_t rate = event->pcm_sample_rate ? event->pcm_sample_rate : s_downlink_rate;
+    // 直接播放时播放器的采样率和下行不一致，说明扬声器切换时钟失败，重新走一遍改为重采样
+    bool switch_failed = !s_downlink_resampler && audio_player_get_sample_rate() != s_downlink_rate;
+    if ((rate != s_downlink_rate || switch_failed) && downlink_set_rate(rate) != ESP_OK) {
+        return;
+    }
+    if (!s_downlink_resampler) {
+        audio_player_feed_pcm(pcm, sample_count);
+        return;
+    }
+
+    // 分块送入重采样器，静态输出缓冲区与解码后的消息长度无关
+    static int16_t resampled_buffer[960];
+    for (size_t offset = 0; offset < sample_count; offset += DOWNLINK_CHUNK_SAMPLES) {
+        size_t chunk = sample_count - offset;
+        if (chunk > DOWNLINK_CHUNK_SAMPLES) {
+            chunk = DOWNLINK_CHUNK_SAMPLES;
+        }
+        size_t resampled_count = 0;
+        if (audio_resampler_process(s_downlink_resampler, pcm + offset, chunk, resampled_buffer,
+                                    sizeof(resampled_buffer) / sizeof(resampled_buffer[0]),
+                                    &resampled_count) != ESP_OK) {
+            return;
+        }
+        if (resampled_count > 0) {
+            audio_player_feed_pcm(resampled_buffer, resampled_count);
         }
     }
-    
-    return output_samples;
 }
 
-// 实现音频回调：收到PCM投递到播放器（24kHz -> 16kHz转换）
-void esp_coze_on_pcm_audio(const int16_t *pcm, size_t sample_count)
+// 新一轮回复开始：抖动估计和预缓冲从头开始，上一轮残留的滤波器历史也清掉
+static void on_reply_created(esp_coze_dl_event_t *event, void *user_ctx)
 {
-    if (!audio_player_running() || !pcm || sample_count == 0) return;
-    
-    // 静态缓冲区用于采样率转换
-    static int16_t resampled_buffer[960]; // 16kHz缓冲区，足够大
-    size_t resampled_count = resample_24k_to_16k(pcm, sample_count, 
-                                                resampled_buffer, 
-                                                sizeof(resampled_buffer)/sizeof(resampled_buffer[0]));
-    if (resampled_count > 0) {
-        audio_player_feed_pcm(resampled_buffer, resampled_count);
+    audio_resampler_reset(s_downlink_resampler);
+    audio_player_jitter_reset();
+}
+
+// 本轮回复的音频已全部收到：让播放器播完剩余部分，并打印本轮的抖动统计
+static void on_audio_completed(esp_coze_dl_event_t *event, void *user_ctx)
+{
+    audio_player_jitter_end_of_stream();
+
+    audio_player_jitter_stats_t stats;
+    if (audio_player_get_jitter_stats(&stats) == ESP_OK) {
+        ESP_LOGI(TAG, "下行抖动%u ms，播放延迟%u ms，欠载%u次，迟到%u包",
+                 (unsigned)stats.jitter_ms, (unsigned)stats.target_ms,
+                 (unsigned)stats.underruns, (unsigned)stats.late_packets);
+    }
+}
+
+#if CONFIG_COZE_UPLINK_CODEC_OPUS || CONFIG_COZE_HANDS_FREE
+// 会话创建事件处理：声明上行音频为16kHz单声道Opus、开启服务端轮次检测，其余配置保持服务端默认
+static void on_chat_created(esp_coze_dl_event_t *event, void *user_ctx)
+{
+    esp_coze_session_config_t session = {0};
+
+#if CONFIG_COZE_UPLINK_CODEC_OPUS
+    esp_coze_input_audio_config_t input_audio = {
+        .format = ESP_COZE_AUDIO_FORMAT_PCM,
+        .codec = ESP_COZE_AUDIO_CODEC_OPUS,
+        .sample_rate = AUDIO_SAMPLE_RATE_HZ,
+        .channel = 1,
+        .bit_depth = 16,
+    };
+    session.input_audio = &input_audio;
+#endif
+
+#if CONFIG_COZE_HANDS_FREE
+    esp_coze_turn_detection_config_t turn_detection = {
+        .type = ESP_COZE_TURN_DETECTION_SERVER_VAD,
+        .prefix_padding_ms = CONFIG_COZE_HANDS_FREE_PREFIX_PADDING_MS,
+        .silence_duration_ms = CONFIG_COZE_HANDS_FREE_SILENCE_MS,
+    };
+    session.turn_detection = &turn_detection;
+#endif
+
+    esp_err_t ret = esp_coze_send_chat_update_event(&session);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "发送会话配置失败: %s", esp_err_to_name(ret));
+        return;
+    }
+
+#if CONFIG_COZE_HANDS_FREE
+    // chat.update已排在所有音频之前，可以开始连续上行；重连后再次收到时不会重复开启
+    ret = button_voice_set_hands_free(true);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "开启免提模式失败: %s", esp_err_to_name(ret));
+    }
+#endif
+}
+#endif
+
+#if CONFIG_COZE_HANDS_FREE
+// 服务端检测到用户开始说话：停掉本地还没播完的回复（服务端会自行打断生成），显示麦克风动画
+static void on_speech_started(esp_coze_dl_event_t *event, void *user_ctx)
+{
+    audio_player_flush();
+    lottie_manager_stop_anim(LOTTIE_ANIM_THINK);
+    lottie_manager_play_anim(LOTTIE_ANIM_MIC);
+}
+
+// 服务端检测到用户说完：这一轮已提交，等待回复
+static void on_speech_stopped(esp_coze_dl_event_t *event, void *user_ctx)
+{
+    lottie_manager_stop_anim(LOTTIE_ANIM_MIC);
+}
+#endif
+
+#if CONFIG_COZE_UPLINK_VAD
+// 本地VAD：说话时显示麦克风动画，停顿时收起，静音超时自动提交后显示思考动画等待回复
+static void on_local_vad(button_voice_vad_event_t event, void *user_ctx)
+{
+    switch (event) {
+    case BUTTON_VOICE_VAD_SPEECH_START:
+        lottie_manager_stop_anim(LOTTIE_ANIM_THINK);
+        lottie_manager_play_anim(LOTTIE_ANIM_MIC);
+        break;
+    case BUTTON_VOICE_VAD_SPEECH_END:
+        lottie_manager_stop_anim(LOTTIE_ANIM_MIC);
+        break;
+    case BUTTON_VOICE_VAD_UTTERANCE_END:
+        lottie_manager_stop_anim(LOTTIE_ANIM_MIC);
+        lottie_manager_play_anim(LOTTIE_ANIM_THINK);
+        break;
+    default:
+        break;
     }
 }
+#endif
@@ -21,7 +21,7 @@
 #include "wifi_manager.h"
 #include "audio_hal.h"
 #include "coze_chat.h"          // Coze 聊天组件核心头文件
-#include "esp_coze_chat.h"      // Coze 聊天回调函数
+#include "esp_coze_chat.h"      // Coze 聊天事件注册
 
 #include "Display_SPD2010_Official.h"
 #include "LVGL_Driver.h"
@@ -43,6 +43,8 @@ static esp_timer_handle_t subtitle_timer = NULL;
 static SemaphoreHandle_t subtitle_mutex = NULL;
 static bool subtitle_update_pending = false;
 
+static void on_sentence_start_event(esp_coze_dl_event_t *event, void *user_ctx);
+
 /**
  * @brief 字幕定时器回调函数 - 批量更新UI
  */
@@ -107,6 +109,10 @@ static esp_err_t init_subtitle_system(void)
         return ret;
     }
     
+    // 注册字幕事件处理函数
+    esp_coze_register_event_handler(ESP_COZE_DL_EVENT_CONVERSATION_AUDIO_SENTENCE_START,
+                                    on_sentence_start_event, NULL);
+
     ESP_LOGI(TAG, "字幕系统初始化成功，更新间隔: %dms", SUBTITLE_UPDATE_INTERVAL_MS);
     return ESP_OK;
 }
@@ -116,6 +122,9 @@ static esp_err_t init_subtitle_system(void)
  */
 static void deinit_subtitle_system(void)
 {
+    esp_coze_unregister_event_handler(ESP_COZE_DL_EVENT_CONVERSATION_AUDIO_SENTENCE_START,
+                                      on_sentence_start_event);
+
     if (subtitle_timer) {
         esp_timer_stop(subtitle_timer);
         esp_timer_delete(subtitle_timer);
@@ -131,7 +140,7 @@ static void deinit_subtitle_system(void)
 }
 
 /**
- * @brief 字幕文本处理回调函数（覆盖弱实现）
+ * @brief 字幕文本处理
  * 
  * 这个函数会在收到 conversation.audio.sentence_start 事件时被调用
  * 高效实现：将字幕添加到缓冲区，由定时器批量更新UI
@@ -139,7 +148,7 @@ static void deinit_subtitle_system(void)
  * @param subtitle_text 字幕文本字符串
  * @param event_id 事件ID，可用于跟踪和去重
  */
-void esp_coze_on_subtitle_text(const char *subtitle_text, const char *event_id)
+static void on_subtitle_text(const char *subtitle_text, const char *event_id)
 {
     if (!subtitle_text || !event_id || !subtitle_mutex) {
         return;
@@ -172,6 +181,26 @@ void esp_coze_on_subtitle_text(const char *subtitle_text, const char *event_id)
     }
 }
 
+/**
+ * @brief conversation.audio.sentence_start 事件处理函数：取出字幕文本
+ *
+ * @param event 下行事件
+ * @param user_ctx 未使用
+ */
+static void on_sentence_start_event(esp_coze_dl_event_t *event, void *user_ctx)
+{
+    esp_coze_dl_sentence_t sentence;
+    char event_id[64] = "unknown";
+
+    if (esp_coze_dl_decode_sentence(&event->data, &sentence) != ESP_OK ||
+            !(sentence.present & ESP_COZE_DL_SENTENCE_HAS_TEXT)) {
+        return;
+    }
+    esp_coze_json_span_to_str(&event->event_id, event_id, sizeof(event_id));
+
+    on_subtitle_text(sentence.text, event_id);
+}
+
 /**
  * @brief WiFi获得IP后的回调函数
  * @param ip_info IP信息结构体指针